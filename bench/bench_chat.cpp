@@ -0,0 +1,662 @@
+/**
+ * @file bench_chat.cpp
+ * @brief Нагрузочный клиент для chat_server
+ *
+ * Режимы:
+ * - idle: открыть N подключений и держать их, затем измерить доставку одного сообщения
+ * - throughput: S отправителей шлют по M сообщений, все клиенты считают доставки;
+ *   клиенты распределяются по T потокам, чтобы генератор не упирался в одно ядро
+ * - ramp: серия замеров throughput с ростом числа подключений до насыщения сервера
+ *
+ * Текстовое сообщение завершается маркером "#\n", доставки считаются по маркеру.
+ * В бинарном протоколе (--protocol binary) клиенты шлют байт рукопожатия
+ * и кадры с префиксом длины, доставки считаются по кадрам.
+ *
+ * Тело сообщения начинается с отметки времени отправки ("T" и 16 hex-цифр
+ * steady_clock в наносекундах); получатель считает задержку доставки и
+ * выдает квантили p50/p99/p999. Без --rate отправители пишут все сообщения
+ * подряд (в одном пакете приходят сотни сообщений — это проверяет разбор
+ * потока), и задержка включает ожидание в очереди отправителя. С --rate
+ * каждый отправитель шлет R сообщений в секунду, задержка — чистое время
+ * доставки при заданной нагрузке.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include "../include/metrics/histogram.h"
+#include "../include/net/connection/protocol.h"
+#include "../include/net/socket.h"
+
+namespace
+{
+  using Clock = std::chrono::steady_clock;
+
+  constexpr size_t kStampDigits = 16;                ///< Hex-цифр в отметке времени
+  constexpr size_t kStampSize = kStampDigits + 1;    ///< Отметка вместе с префиксом 'T'
+
+  struct Options
+  {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    std::string mode = "throughput";
+    int connections = 100;
+    int senders = 10;
+    int messages = 1000;
+    int size = 64;
+    int hold = 5;
+    int timeout = 60;
+    int threads = 1;
+    bool binary = false;
+    double rate = 0;         ///< Сообщений в секунду на отправителя; 0 — все сразу
+    int ramp_step = 0;       ///< Шаг числа подключений в режиме ramp (0 — равен --connections)
+    int max_connections = 0; ///< Предел числа подключений в режиме ramp
+    double slo_ms = 50;      ///< Порог p99 в режиме ramp
+  };
+
+  struct Client
+  {
+    std::unique_ptr<Socket> socket;
+    std::string out;
+    size_t out_offset = 0;
+    uint64_t delivered = 0;
+    uint64_t queued = 0; ///< Сообщений поставлено в out (для отправителей)
+    bool welcomed = false;
+    char tail = 0; ///< Последний принятый байт (маркер может разрезаться между recv)
+    // Разбор бинарных кадров, которые могут разрезаться между recv
+    uint32_t frame_left = 0; ///< Сколько байт текущего кадра осталось принять
+    uint32_t frame_size = 0; ///< Длина текущего кадра (вместе с байтом типа)
+    uint32_t length = 0;     ///< Накопленная длина из varint
+    int shift = 0;           ///< Сдвиг следующей группы varint
+    // Отметка времени в начале текущего сообщения
+    uint32_t pos = 0;      ///< Позиция в теле текущего сообщения
+    uint64_t stamp = 0;    ///< Накопленная отметка
+    bool stamped = false;  ///< Сообщение начинается с корректной отметки
+  };
+
+  void usage()
+  {
+    std::cerr << "usage: bench_chat [--host H] [--port P] [--mode idle|throughput|ramp]\n"
+                 "                  [--connections N] [--senders S] [--messages M]\n"
+                 "                  [--size BYTES] [--rate MSG_PER_SEC] [--hold SEC] [--timeout SEC]\n"
+                 "                  [--threads T] [--protocol text|binary]\n"
+                 "                  [--ramp-step N] [--max-connections N] [--slo-ms MS]\n";
+  }
+
+  bool parse(int argc, char **argv, Options &opt)
+  {
+    for (int i = 1; i < argc; ++i)
+    {
+      std::string key = argv[i];
+      if (i + 1 >= argc)
+        return false;
+      std::string value = argv[++i];
+      if (key == "--host")
+        opt.host = value;
+      else if (key == "--port")
+        opt.port = std::stoi(value);
+      else if (key == "--mode")
+        opt.mode = value;
+      else if (key == "--connections")
+        opt.connections = std::stoi(value);
+      else if (key == "--senders")
+        opt.senders = std::stoi(value);
+      else if (key == "--messages")
+        opt.messages = std::stoi(value);
+      else if (key == "--size")
+        opt.size = std::stoi(value);
+      else if (key == "--rate")
+        opt.rate = std::stod(value);
+      else if (key == "--hold")
+        opt.hold = std::stoi(value);
+      else if (key == "--timeout")
+        opt.timeout = std::stoi(value);
+      else if (key == "--threads")
+        opt.threads = std::stoi(value);
+      else if (key == "--protocol" && (value == "text" || value == "binary"))
+        opt.binary = value == "binary";
+      else if (key == "--ramp-step")
+        opt.ramp_step = std::stoi(value);
+      else if (key == "--max-connections")
+        opt.max_connections = std::stoi(value);
+      else if (key == "--slo-ms")
+        opt.slo_ms = std::stod(value);
+      else
+        return false;
+    }
+    return (opt.mode == "idle" || opt.mode == "throughput" || opt.mode == "ramp") && opt.threads > 0 && opt.rate >= 0;
+  }
+
+  void raise_fd_limit()
+  {
+    rlimit rl{};
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max)
+    {
+      rl.rlim_cur = rl.rlim_max;
+      setrlimit(RLIMIT_NOFILE, &rl);
+    }
+  }
+
+  double seconds_since(Clock::time_point start)
+  {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  }
+
+  uint64_t now_ns()
+  {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     Clock::now().time_since_epoch())
+                                     .count());
+  }
+
+  /// Разбор отметки времени: byte — символ тела сообщения в позиции client.pos
+  void stamp_byte(Client &client, char byte)
+  {
+    if (client.pos == 0)
+    {
+      client.stamped = byte == 'T';
+      client.stamp = 0;
+    }
+    else if (client.stamped && client.pos < kStampSize)
+    {
+      int digit = byte >= '0' && byte <= '9' ? byte - '0' : byte >= 'a' && byte <= 'f' ? byte - 'a' + 10 : -1;
+      if (digit < 0)
+        client.stamped = false;
+      else
+        client.stamp = client.stamp << 4 | static_cast<uint64_t>(digit);
+    }
+    ++client.pos;
+  }
+
+  /// Засчитать доставку и задержку, если у сообщения была отметка
+  void delivered(Client &client, Histogram &latency, uint64_t now)
+  {
+    ++client.delivered;
+    if (client.stamped && client.pos >= kStampSize && now >= client.stamp)
+      latency.record(now - client.stamp);
+    client.pos = 0;
+    client.stamped = false;
+  }
+
+  /// Считает бинарные кадры после строки приветствия
+  void consume_binary(Client &client, const char *data, ssize_t len, Histogram &latency, uint64_t now)
+  {
+    for (ssize_t i = 0; i < len; ++i)
+    {
+      if (!client.welcomed)
+      {
+        client.welcomed = data[i] == '\n';
+        continue;
+      }
+      if (client.frame_left > 0)
+      {
+        uint32_t offset = client.frame_size - client.frame_left; // 0 — байт типа
+        if (offset <= kStampSize)
+        {
+          // Байт типа и отметка разбираются по одному
+          if (offset > 0)
+            stamp_byte(client, data[i]);
+          --client.frame_left;
+        }
+        else
+        {
+          // Остаток тела пропускаем целиком
+          uint32_t skip = std::min<uint32_t>(client.frame_left, static_cast<uint32_t>(len - i));
+          client.frame_left -= skip;
+          i += skip - 1;
+        }
+        if (client.frame_left == 0)
+          delivered(client, latency, now);
+        continue;
+      }
+      auto byte = static_cast<unsigned char>(data[i]);
+      client.length |= static_cast<uint32_t>(byte & 0x7F) << client.shift;
+      client.shift += 7;
+      if (!(byte & 0x80))
+      {
+        client.frame_left = client.frame_size = client.length;
+        client.length = 0;
+        client.shift = 0;
+        client.pos = 0;
+      }
+    }
+  }
+
+  /// Считает маркеры "#\n" и строку приветствия
+  void consume(Client &client, const char *data, ssize_t len, bool binary, Histogram &latency, uint64_t now)
+  {
+    if (binary)
+    {
+      consume_binary(client, data, len, latency, now);
+      return;
+    }
+    for (ssize_t i = 0; i < len; ++i)
+    {
+      if (data[i] == '\n')
+      {
+        if (!client.welcomed)
+          client.welcomed = true;
+        else if (client.tail == '#')
+          delivered(client, latency, now);
+        client.pos = 0;
+        client.stamped = false;
+      }
+      else if (client.pos < kStampSize)
+      {
+        stamp_byte(client, data[i]);
+      }
+      client.tail = data[i];
+    }
+  }
+
+  /// Вычитывает сокет до EAGAIN; false — соединение закрыто сервером
+  bool drain(Client &client, bool binary, Histogram &latency)
+  {
+    char buf[16384];
+    for (;;)
+    {
+      ssize_t n = ::recv(client.socket->fd(), buf, sizeof(buf), 0);
+      if (n > 0)
+      {
+        consume(client, buf, n, binary, latency, now_ns());
+        continue;
+      }
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return true;
+      if (n < 0 && errno == EINTR)
+        continue;
+      return false;
+    }
+  }
+
+  void pump(Client &client)
+  {
+    while (client.out_offset < client.out.size())
+    {
+      ssize_t n = ::send(client.socket->fd(), client.out.data() + client.out_offset,
+                         client.out.size() - client.out_offset, MSG_NOSIGNAL);
+      if (n <= 0)
+        return;
+      client.out_offset += static_cast<size_t>(n);
+    }
+    // Все отправлено: буфер переиспользуется для следующих сообщений
+    client.out.clear();
+    client.out_offset = 0;
+  }
+
+  /// Клиенты, обслуживаемые одним потоком генератора нагрузки
+  struct Worker
+  {
+    int epfd = -1;
+    std::vector<Client> clients;
+    Histogram latency; ///< Задержки доставки, замеренные этим потоком
+
+    Worker()
+    {
+      epfd = epoll_create1(EPOLL_CLOEXEC);
+      if (epfd < 0)
+        throw std::runtime_error(std::string("epoll_create1 failed: ") + strerror(errno));
+    }
+    ~Worker() { close(epfd); }
+    Worker(const Worker &) = delete;
+    Worker &operator=(const Worker &) = delete;
+  };
+
+  /// Подключает клиентов и раскладывает их по потокам (клиент i -> поток i % threads)
+  std::vector<std::unique_ptr<Worker>> connect_all(const Options &opt)
+  {
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (int t = 0; t < opt.threads; ++t)
+      workers.push_back(std::make_unique<Worker>());
+
+    auto start = Clock::now();
+    for (int i = 0; i < opt.connections; ++i)
+    {
+      auto socket = std::make_unique<Socket>(AF_INET, SOCK_STREAM, 0);
+      socket->universal_struct_parameters(opt.host, opt.port);
+      socket->connect_socket();
+      if (opt.binary)
+      {
+        const char handshake = static_cast<char>(kBinaryHandshake);
+        if (socket->send(std::string(1, handshake)) != 1)
+          throw std::runtime_error("handshake failed");
+      }
+      socket->set_nonblocking();
+
+      Worker &worker = *workers[i % opt.threads];
+      epoll_event ev{};
+      ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+      ev.data.u32 = static_cast<uint32_t>(worker.clients.size());
+      if (epoll_ctl(worker.epfd, EPOLL_CTL_ADD, socket->fd(), &ev) < 0)
+        throw std::runtime_error(std::string("epoll_ctl failed: ") + strerror(errno));
+      worker.clients.emplace_back();
+      worker.clients.back().socket = std::move(socket);
+    }
+    std::cout << "connected " << opt.connections << " clients in "
+              << seconds_since(start) << " s\n";
+    return workers;
+  }
+
+  /// Крутит epoll, пока predicate() не вернет true или не истечет таймаут
+  template <typename Predicate>
+  bool run_until(Worker &worker, const Options &opt, double timeout, Predicate predicate, int wait_ms = 100)
+  {
+    std::vector<epoll_event> events(1024);
+    auto start = Clock::now();
+    while (!predicate())
+    {
+      if (seconds_since(start) > timeout)
+        return false;
+      int n = epoll_wait(worker.epfd, events.data(), static_cast<int>(events.size()), wait_ms);
+      for (int i = 0; i < n; ++i)
+      {
+        Client &client = worker.clients[events[i].data.u32];
+        if (!client.socket->is_valid())
+          continue;
+        if (events[i].events & EPOLLOUT)
+          pump(client);
+        if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+        {
+          if (!drain(client, opt.binary, worker.latency))
+          {
+            epoll_ctl(worker.epfd, EPOLL_CTL_DEL, client.socket->fd(), nullptr);
+            client.socket->close_socket();
+          }
+        }
+      }
+    }
+    return true;
+  }
+
+  bool all_welcomed(const Worker &worker)
+  {
+    for (auto &c : worker.clients)
+      if (!c.welcomed && c.socket->is_valid())
+        return false;
+    return true;
+  }
+
+  /// Текст: size байт вместе с "#\n"; бинарный кадр: тело из size байт.
+  /// Тело начинается с отметки времени stamp
+  void append_message(std::string &out, const Options &opt, uint64_t stamp)
+  {
+    char head[kStampSize + 1];
+    std::snprintf(head, sizeof(head), "T%016llx", static_cast<unsigned long long>(stamp));
+    if (opt.binary)
+    {
+      size_t body = std::max<size_t>(static_cast<size_t>(std::max(opt.size, 0)), kStampSize);
+      unsigned char header[kMaxVarintSize + 1];
+      size_t len = encode_varint(static_cast<uint32_t>(body + 1), header);
+      header[len++] = static_cast<unsigned char>(FrameType::Message);
+      out.append(reinterpret_cast<const char *>(header), len);
+      out.append(head, kStampSize);
+      out.append(body - kStampSize, 'x');
+      return;
+    }
+    size_t size = std::max<size_t>(static_cast<size_t>(std::max(opt.size, 0)), kStampSize + 2);
+    out.append(head, kStampSize);
+    out.append(size - kStampSize - 2, 'x');
+    out += "#\n";
+  }
+
+  int run_idle(Options opt)
+  {
+    opt.threads = 1;
+    auto workers = connect_all(opt);
+    Worker &worker = *workers.front();
+    auto &clients = worker.clients;
+    if (!run_until(worker, opt, opt.timeout, [&]
+                   { return all_welcomed(worker); }))
+    {
+      std::cerr << "not all clients were welcomed\n";
+      return 1;
+    }
+
+    std::cout << "holding " << opt.connections << " idle connections for " << opt.hold << " s\n";
+    run_until(worker, opt, opt.hold, []
+              { return false; });
+
+    size_t alive = 0;
+    for (auto &c : clients)
+      alive += c.socket->is_valid() ? 1 : 0;
+    std::cout << "alive after hold: " << alive << "/" << opt.connections << '\n';
+    if (clients.size() < 2)
+      return 0;
+
+    // Одно сообщение с первого клиента должно дойти до всех остальных
+    auto start = Clock::now();
+    append_message(clients[0].out, opt, now_ns());
+    pump(clients[0]);
+    bool ok = run_until(worker, opt, opt.timeout, [&]
+                        {
+      for (size_t i = 1; i < clients.size(); ++i)
+        if (clients[i].delivered == 0 && clients[i].socket->is_valid())
+          return false;
+      return true; });
+    std::cout << "broadcast to " << clients.size() - 1 << " idle clients: "
+              << (ok ? "" : "TIMEOUT after ") << seconds_since(start) * 1e3 << " ms\n";
+    return ok ? 0 : 1;
+  }
+
+  /// Итог одного замера throughput
+  struct Result
+  {
+    bool ok = true;              ///< Все доставки получены до таймаута
+    double elapsed = 0;          ///< Время до последней доставки, с
+    uint64_t sent = 0;           ///< Отправлено сообщений
+    uint64_t delivered = 0;      ///< Получено доставок
+    uint64_t expected = 0;       ///< Ожидалось доставок
+    Histogram::Snapshot latency; ///< Задержки доставки, нс
+  };
+
+  double ms(uint64_t ns)
+  {
+    return static_cast<double>(ns) / 1e6;
+  }
+
+  Result measure(const Options &opt)
+  {
+    auto workers = connect_all(opt);
+
+    // Отправители — первые S клиентов; свои сообщения сервер им не возвращает
+    std::vector<uint64_t> expected(workers.size(), 0);
+    for (int i = 0; i < opt.connections; ++i)
+    {
+      int others = i < opt.senders ? opt.senders - 1 : opt.senders;
+      expected[i % opt.threads] += static_cast<uint64_t>(others) * opt.messages;
+    }
+
+    std::atomic<int> ready{0};
+    std::atomic<bool> go{false};
+    std::atomic<bool> all_ok{true};
+    std::atomic<uint64_t> delivered_total{0};
+    std::vector<double> finished(workers.size(), 0.0);
+    Clock::time_point start;
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < workers.size(); ++t)
+    {
+      threads.emplace_back([&, t]
+                           {
+        Worker &worker = *workers[t];
+        run_until(worker, opt, opt.timeout, [&]
+                  { return all_welcomed(worker); });
+        ready.fetch_add(1);
+        while (!go.load())
+          std::this_thread::yield();
+
+        std::vector<Client *> senders;
+        for (size_t i = 0; i < worker.clients.size(); ++i)
+        {
+          size_t global = i * workers.size() + t;
+          if (global >= static_cast<size_t>(opt.senders))
+            break;
+          senders.push_back(&worker.clients[i]);
+        }
+
+        // Ставит в очередь отправителей сообщения, срок которых наступил
+        auto send_due = [&]
+        {
+          uint64_t due = static_cast<uint64_t>(opt.messages);
+          if (opt.rate > 0)
+            due = std::min(due, static_cast<uint64_t>(seconds_since(start) * opt.rate) + 1);
+          uint64_t stamp = now_ns();
+          for (Client *client : senders)
+          {
+            if (client->queued >= due || !client->socket->is_valid())
+              continue;
+            client->out.reserve(client->out.size() + (due - client->queued) * (opt.size + kMaxVarintSize + 1));
+            for (; client->queued < due; ++client->queued)
+              append_message(client->out, opt, stamp);
+            pump(*client);
+          }
+        };
+        send_due();
+
+        uint64_t delivered = 0;
+        bool ok = run_until(worker, opt, opt.timeout, [&]
+                            {
+          if (opt.rate > 0)
+            send_due();
+          delivered = 0;
+          for (auto &c : worker.clients)
+            delivered += c.delivered;
+          return delivered >= expected[t]; },
+                            opt.rate > 0 ? 1 : 100);
+        finished[t] = seconds_since(start);
+        delivered_total.fetch_add(delivered);
+        if (!ok)
+          all_ok = false; });
+    }
+
+    while (ready.load() != static_cast<int>(workers.size()))
+      std::this_thread::yield();
+    start = Clock::now();
+    go = true;
+    for (auto &thread : threads)
+      thread.join();
+
+    Result result;
+    for (double f : finished)
+      result.elapsed = std::max(result.elapsed, f);
+    for (auto &worker : workers)
+      worker->latency.merge_into(result.latency);
+    for (uint64_t e : expected)
+      result.expected += e;
+    result.ok = all_ok;
+    result.sent = static_cast<uint64_t>(opt.senders) * opt.messages;
+    result.delivered = delivered_total.load();
+    return result;
+  }
+
+  bool check_senders(const Options &opt)
+  {
+    if (opt.senders > opt.connections)
+    {
+      std::cerr << "--senders must not exceed --connections\n";
+      return false;
+    }
+    return true;
+  }
+
+  int run_throughput(const Options &opt)
+  {
+    if (!check_senders(opt))
+      return 1;
+    Result r = measure(opt);
+    std::cout << "sent:        " << r.sent << " msgs x " << opt.size << " B";
+    if (opt.rate > 0)
+      std::cout << " at " << opt.rate << " msg/s per sender";
+    std::cout << '\n'
+              << "delivered:   " << r.delivered << "/" << r.expected << (r.ok ? "" : " (TIMEOUT)") << '\n'
+              << "elapsed:     " << r.elapsed << " s\n"
+              << "msg/s:       " << r.sent / r.elapsed << '\n'
+              << "delivery/s:  " << r.delivered / r.elapsed << '\n'
+              << "latency ms:  p50 " << ms(r.latency.quantile(0.5)) << "  p99 " << ms(r.latency.quantile(0.99))
+              << "  p999 " << ms(r.latency.quantile(0.999)) << "  max " << ms(r.latency.quantile(1.0)) << '\n';
+    return r.ok ? 0 : 1;
+  }
+
+  /// Рост числа подключений шагами, пока сервер справляется с нагрузкой
+  int run_ramp(Options opt)
+  {
+    if (opt.rate <= 0)
+    {
+      std::cerr << "--mode ramp needs --rate: saturation is measured at a fixed offered load\n";
+      return 2;
+    }
+    if (!check_senders(opt))
+      return 1;
+    int step = opt.ramp_step > 0 ? opt.ramp_step : opt.connections;
+    int limit = opt.max_connections > 0 ? opt.max_connections : opt.connections * 16;
+
+    std::printf("%8s %12s %12s %10s %10s %10s  %s\n", "conns", "msg/s", "delivery/s", "p50 ms", "p99 ms", "p999 ms", "status");
+    int saturated_at = 0;
+    int last_good = 0;
+    for (int n = opt.connections; n <= limit; n += step)
+    {
+      opt.connections = n;
+      Result r = measure(opt);
+      double p99 = ms(r.latency.quantile(0.99));
+      // Отправка не должна отставать от расписания больше чем на 5%
+      double planned = opt.messages / opt.rate;
+      const char *status = !r.ok ? "timeout" : p99 > opt.slo_ms ? "p99 over SLO" : r.elapsed > planned * 1.05 + 0.1 ? "falling behind" : "ok";
+      std::printf("%8d %12.0f %12.0f %10.3f %10.3f %10.3f  %s\n", n, r.sent / r.elapsed, r.delivered / r.elapsed,
+                  ms(r.latency.quantile(0.5)), p99, ms(r.latency.quantile(0.999)), status);
+      std::fflush(stdout);
+      if (std::strcmp(status, "ok") != 0)
+      {
+        saturated_at = n;
+        break;
+      }
+      last_good = n;
+    }
+
+    if (saturated_at)
+      std::cout << "saturation at " << saturated_at << " connections, last good " << last_good << '\n';
+    else
+      std::cout << "no saturation up to " << last_good << " connections\n";
+    return 0;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  Options opt;
+  try
+  {
+    if (!parse(argc, argv, opt))
+    {
+      usage();
+      return 2;
+    }
+  }
+  catch (std::exception &)
+  {
+    usage();
+    return 2;
+  }
+
+  raise_fd_limit();
+
+  try
+  {
+    if (opt.mode == "idle")
+      return run_idle(opt);
+    return opt.mode == "ramp" ? run_ramp(opt) : run_throughput(opt);
+  }
+  catch (std::exception &e)
+  {
+    std::cerr << e.what() << '\n';
+    return 1;
+  }
+}
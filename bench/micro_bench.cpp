@@ -0,0 +1,976 @@
+/**
+ * @file micro_bench.cpp
+ * @brief Микробенчмарки горячих участков сервера без сети
+ *
+ * Наборы:
+ * - framing: разбор потока Framer в текстовом ("\n" и "\r\n") и бинарном протоколе;
+ *   данные подаются порциями по 16 КиБ, как после recv
+ * - chain: проход сообщения через ChainedHandler из K обработчиков
+ *   (K-1 отказываются по префиксу команды, последний принимает);
+ *   chain/command — команда последнего из K-1 командных обработчиков
+ * - router: те же текст и команда через CommandRouter с K-1 командами
+ * - registry: добавление/удаление, поиск и обход ClientRegistry;
+ *   rooms/join_leave — подписка и отписка N клиентов в RoomIndex
+ * - fanout: рассылка в комнату из N подписчиков тем же путем, что
+ *   connectionManager::deliverLocal (RoomIndex -> ClientRegistry -> IIoBackend::send),
+ *   но в IIoBackend, который вместо сокета только собирает iovec и
+ *   списывает очередь — без ядра и шума системных вызовов
+ * - history: выдача истории комнаты из M сообщений новому подписчику
+ * - store: запись в журнал сообщений на диске с ожиданием групповой фиксации
+ *   (каталог во временном /tmp)
+ * - log: запись в журнал ниже порога, с прореживанием и с выводом
+ *   (в /dev/null; ожидание фонового вывода входит в замер)
+ * - pool: создание и освобождение MessageBuffer разных размеров
+ * - pipeline: сообщение клиента целиком — разбор, буфер сообщения, рассылка
+ *   в комнату, история и списание очередей
+ * - loop: задача рассылки в поток другого цикла событий и ее выполнение
+ * - accept: решение AcceptLimiter о новом подключении — поток с одного
+ *   адреса (почти все отказы) и подключения с N разных адресов
+ * - connection/footprint: прирост кучи на одно простаивающее подключение,
+ *   принятое так же, как в connectionManager (без времени)
+ *
+ * Результат — JSON в stdout (или в --out), чтобы сравнивать коммиты:
+ * для каждого замера имя, параметры, число операций, медиана нс/операцию
+ * по --repetitions повторам и число обращений к operator new на операцию
+ * после прогрева (allocs_per_op; operator new заменен счетчиком).
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "../include/handler/Messages/chain/chained_handler.h"
+#include "../include/handler/Messages/router/command_router.h"
+#include "../include/log/logger.h"
+#include "../include/memory/block_pool.h"
+#include "../include/net/connection/accept_limiter.h"
+#include "../include/net/connection/client_registry.h"
+#include "../include/net/connection/connection.h"
+#include "../include/net/connection/framer.h"
+#include "../include/net/connection/message_buffer.h"
+#include "../include/net/connection/name_index.h"
+#include "../include/net/connection/protocol.h"
+#include "../include/net/connection/room_history.h"
+#include "../include/net/connection/room_index.h"
+#include "../include/net/reactor/event_loop.h"
+#include "../include/net/reactor/io_backend.h"
+#include "../include/net/socket.h"
+#include "../include/storage/message_log.h"
+
+// ---------------------------------------------------------------- allocations
+
+namespace
+{
+  std::atomic<uint64_t> allocations{0}; ///< Вызовов operator new (во всех потоках)
+  std::atomic<int64_t> live_bytes{0};   ///< Занято через operator new, байт
+}
+
+/// Ловушка подсчета аллокаций: все выделения процесса, включая слабы BlockPool
+void *operator new(size_t size)
+{
+  void *block = std::malloc(size ? size : 1);
+  if (!block)
+    throw std::bad_alloc();
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  live_bytes.fetch_add(static_cast<int64_t>(malloc_usable_size(block)), std::memory_order_relaxed);
+  return block;
+}
+
+void operator delete(void *block) noexcept
+{
+  if (!block)
+    return;
+  live_bytes.fetch_sub(static_cast<int64_t>(malloc_usable_size(block)), std::memory_order_relaxed);
+  std::free(block);
+}
+
+void operator delete(void *block, size_t) noexcept
+{
+  operator delete(block);
+}
+
+namespace
+{
+  using Clock = std::chrono::steady_clock;
+
+  struct Options
+  {
+    std::string filter;      ///< Подстрока имени замера; пусто — все
+    std::string out;         ///< Файл для JSON; пусто — stdout
+    double min_time_ms = 200; ///< Минимальная длительность одного повтора
+    int repetitions = 3;     ///< Повторов каждого замера
+  };
+
+  /// Результат одного замера
+  struct Result
+  {
+    std::string name;                                ///< Имя замера
+    std::vector<std::pair<std::string, long>> params; ///< Параметры
+    uint64_t ops = 0;                                ///< Операций в последнем повторе
+    double ns_per_op = 0;                            ///< Медиана по повторам
+    double bytes_per_op = 0;                         ///< Обработано байт за операцию (0 — не применимо)
+    double allocs_per_op = 0;                        ///< Вызовов operator new за операцию после прогрева
+    std::vector<std::pair<std::string, double>> values; ///< Прочие величины замера (без времени)
+  };
+
+  /// Не дает компилятору выбросить вычисление результата
+  template <typename T>
+  void keep(T const &value)
+  {
+    asm volatile("" : : "r,m"(value) : "memory");
+  }
+
+  class Runner
+  {
+  public:
+    explicit Runner(const Options &opt) : opt_(opt) {}
+
+    /**
+     * Выполнить замер: batch() выполняет ops_per_batch операций и
+     * повторяется, пока не наберется min_time
+     */
+    void run(const std::string &name, std::vector<std::pair<std::string, long>> params,
+             uint64_t ops_per_batch, double bytes_per_op, const std::function<void()> &batch)
+    {
+      std::string full = full_name(name, params);
+      if (!selected(full))
+        return;
+
+      batch(); // Прогрев кэшей и аллокаций
+      std::vector<double> samples;
+      samples.reserve(static_cast<size_t>(opt_.repetitions));
+      uint64_t ops = 0;
+      uint64_t total_ops = 0;
+      uint64_t allocated = allocations.load(std::memory_order_relaxed);
+      for (int r = 0; r < opt_.repetitions; ++r)
+      {
+        uint64_t batches = 0;
+        auto start = Clock::now();
+        double elapsed_ns = 0;
+        do
+        {
+          batch();
+          ++batches;
+          elapsed_ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        } while (elapsed_ns < opt_.min_time_ms * 1e6);
+        ops = batches * ops_per_batch;
+        total_ops += ops;
+        samples.push_back(elapsed_ns / static_cast<double>(ops));
+      }
+      allocated = allocations.load(std::memory_order_relaxed) - allocated;
+      std::sort(samples.begin(), samples.end());
+
+      Result result{name, std::move(params), ops, samples[samples.size() / 2], bytes_per_op,
+                    static_cast<double>(allocated) / static_cast<double>(total_ops), {}};
+      std::fprintf(stderr, "%-48s %12.1f ns/op %10.3f allocs/op\n", full.c_str(), result.ns_per_op, result.allocs_per_op);
+      results_.push_back(std::move(result));
+    }
+
+    /// Записать замер без времени (например, расход памяти)
+    void report(const std::string &name, std::vector<std::pair<std::string, long>> params,
+                const std::string &key, double value)
+    {
+      std::string full = full_name(name, params);
+      std::fprintf(stderr, "%-48s %12.1f %s\n", full.c_str(), value, key.c_str());
+      Result result{name, std::move(params), 0, 0, 0, 0, {{key, value}}};
+      results_.push_back(std::move(result));
+    }
+
+    /// true, если замер проходит --filter
+    bool selected(const std::string &full) const
+    {
+      return opt_.filter.empty() || full.find(opt_.filter) != std::string::npos;
+    }
+
+    /// Имя замера вместе с параметрами
+    static std::string full_name(const std::string &name, const std::vector<std::pair<std::string, long>> &params)
+    {
+      std::string full = name;
+      for (auto &param : params)
+        full += "/" + param.first + ":" + std::to_string(param.second);
+      return full;
+    }
+
+    /// JSON со всеми замерами
+    std::string json() const
+    {
+      char date[32];
+      std::time_t now = std::time(nullptr);
+      std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+#ifdef __OPTIMIZE__
+      const bool optimized = true;
+#else
+      const bool optimized = false;
+#endif
+
+      std::string out = "{\n  \"context\": {\"date\": \"" + std::string(date) +
+                        "\", \"cpus\": " + std::to_string(std::thread::hardware_concurrency()) +
+                        ", \"optimized\": " + (optimized ? "true" : "false") +
+                        ", \"min_time_ms\": " + number(opt_.min_time_ms) +
+                        ", \"repetitions\": " + std::to_string(opt_.repetitions) + "},\n  \"benchmarks\": [";
+      for (size_t i = 0; i < results_.size(); ++i)
+      {
+        const Result &r = results_[i];
+        out += i ? ",\n    {" : "\n    {";
+        out += "\"name\": \"" + r.name + "\", \"params\": {";
+        for (size_t p = 0; p < r.params.size(); ++p)
+          out += (p ? ", \"" : "\"") + r.params[p].first + "\": " + std::to_string(r.params[p].second);
+        out += "}";
+        if (r.ns_per_op > 0)
+        {
+          out += ", \"ops\": " + std::to_string(r.ops) + ", \"ns_per_op\": " + number(r.ns_per_op) +
+                 ", \"ops_per_sec\": " + number(1e9 / r.ns_per_op) + ", \"allocs_per_op\": " + number(r.allocs_per_op);
+          if (r.bytes_per_op > 0)
+            out += ", \"mb_per_sec\": " + number(r.bytes_per_op * 1e3 / r.ns_per_op);
+        }
+        for (auto &value : r.values)
+          out += ", \"" + value.first + "\": " + number(value.second);
+        out += "}";
+      }
+      out += "\n  ]\n}\n";
+      return out;
+    }
+
+  private:
+    const Options &opt_;
+    std::vector<Result> results_;
+
+    static std::string number(double value)
+    {
+      char buf[32];
+      std::snprintf(buf, sizeof(buf), "%.4g", value);
+      return buf;
+    }
+  };
+
+  // ---------------------------------------------------------------- framing
+
+  /// Поток из count сообщений с телом size байт
+  std::string make_stream(Protocol protocol, size_t size, size_t count, bool crlf)
+  {
+    std::string stream;
+    std::string body(size, 'x');
+    if (protocol == Protocol::Binary)
+    {
+      stream += static_cast<char>(kBinaryHandshake);
+      unsigned char header[kMaxVarintSize + 1];
+      size_t len = encode_varint(static_cast<uint32_t>(size + 1), header);
+      header[len++] = static_cast<unsigned char>(FrameType::Message);
+      for (size_t i = 0; i < count; ++i)
+      {
+        stream.append(reinterpret_cast<const char *>(header), len);
+        stream += body;
+      }
+      return stream;
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+      stream += body;
+      stream += crlf ? "\r\n" : "\n";
+    }
+    return stream;
+  }
+
+  void bench_framing(Runner &runner)
+  {
+    constexpr size_t kMessages = 4096;
+    constexpr size_t kChunk = 16 * 1024;
+    struct Case
+    {
+      const char *name;
+      Protocol protocol;
+      bool crlf;
+    };
+    const Case cases[] = {{"framing/text", Protocol::Text, false},
+                          {"framing/text_crlf", Protocol::Text, true},
+                          {"framing/binary", Protocol::Binary, false}};
+    for (const Case &c : cases)
+    {
+      for (size_t size : {16, 64, 512, 4096})
+      {
+        std::string stream = make_stream(c.protocol, size, kMessages, c.crlf);
+        runner.run(c.name, {{"size", static_cast<long>(size)}}, kMessages,
+                   static_cast<double>(stream.size()) / kMessages, [&]
+                   {
+          Framer framer(64 * 1024);
+          Framer::Frame frame;
+          size_t frames = 0;
+          for (size_t offset = 0; offset < stream.size(); offset += kChunk)
+          {
+            framer.append(stream.data() + offset, std::min(kChunk, stream.size() - offset));
+            while (framer.next(frame))
+            {
+              keep(frame.parts[0].data());
+              ++frames;
+            }
+          }
+          if (frames != kMessages)
+            throw std::logic_error("framing lost messages"); });
+      }
+    }
+  }
+
+  // ---------------------------------------------------------------- chain
+
+  /// Отказывается от всего, что не начинается с его команды
+  class CommandHandler : public IMessageHandler
+  {
+  public:
+    explicit CommandHandler(std::string command) : command_(std::move(command)) {}
+
+    bool handle(std::shared_ptr<Socket>, const MessageRef &msg) override
+    {
+      return msg->view().substr(0, command_.size()) == command_;
+    }
+
+  private:
+    std::string command_;
+  };
+
+  /// Принимает все сообщения
+  class SinkHandler : public IMessageHandler
+  {
+  public:
+    bool handle(std::shared_ptr<Socket>, const MessageRef &msg) override
+    {
+      handled_ += msg->size();
+      keep(handled_);
+      return true;
+    }
+
+  private:
+    size_t handled_ = 0;
+  };
+
+  /// Имя i-й команды: две цифры, чтобы имена не были префиксами друг друга
+  std::string command_name(long i)
+  {
+    char name[16];
+    std::snprintf(name, sizeof(name), "/cmd%02ld", i);
+    return name;
+  }
+
+  void bench_chain(Runner &runner)
+  {
+    constexpr size_t kMessages = 1024;
+    auto sender = std::make_shared<Socket>(AF_INET, SOCK_STREAM, 0);
+    MessageRef msg = MessageBuffer::create({"hello, room\n"});
+    for (long handlers : {1, 2, 4, 8, 16, 32})
+    {
+      ChainedHandler chain;
+      for (long i = 1; i < handlers; ++i)
+        chain.add(std::make_unique<CommandHandler>(command_name(i)));
+      chain.add(std::make_unique<SinkHandler>());
+      runner.run("chain/dispatch", {{"handlers", handlers}}, kMessages, 0, [&]
+                 {
+        for (size_t i = 0; i < kMessages; ++i)
+          keep(chain.handle(sender, msg)); });
+      if (handlers == 1)
+        continue;
+      MessageRef command = MessageBuffer::create({command_name(handlers - 1), " args\n"});
+      runner.run("chain/command", {{"handlers", handlers}}, kMessages, 0, [&]
+                 {
+        for (size_t i = 0; i < kMessages; ++i)
+          keep(chain.handle(sender, command)); });
+    }
+  }
+
+  // ---------------------------------------------------------------- router
+
+  void bench_router(Runner &runner)
+  {
+    constexpr size_t kMessages = 1024;
+    auto sender = std::make_shared<Socket>(AF_INET, SOCK_STREAM, 0);
+    MessageRef msg = MessageBuffer::create({"hello, room\n"});
+    for (long handlers : {1, 2, 4, 8, 16, 32})
+    {
+      CommandRouter router;
+      size_t commands = 0;
+      for (long i = 1; i < handlers; ++i)
+        router.add(command_name(i), [&commands](const std::shared_ptr<Socket> &, std::string_view args)
+                   { commands += args.size(); });
+      router.set_text(std::make_unique<SinkHandler>());
+      runner.run("router/dispatch", {{"handlers", handlers}}, kMessages, 0, [&]
+                 {
+        for (size_t i = 0; i < kMessages; ++i)
+          keep(router.handle(sender, msg)); });
+      if (handlers == 1)
+        continue;
+      MessageRef command = MessageBuffer::create({command_name(handlers - 1), " args\n"});
+      runner.run("router/command", {{"handlers", handlers}}, kMessages, 0, [&]
+                 {
+        for (size_t i = 0; i < kMessages; ++i)
+          keep(router.handle(sender, command)); });
+      keep(commands);
+    }
+  }
+
+  // ---------------------------------------------------------------- registry
+
+  /// Подключения на настоящих (неподключенных) сокетах: реестр индексируется дескриптором
+  std::vector<std::shared_ptr<Connection>> make_connections(size_t count)
+  {
+    std::vector<std::shared_ptr<Connection>> connections;
+    connections.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+      auto socket = std::make_shared<Socket>(AF_INET, SOCK_STREAM, 0);
+      connections.push_back(std::make_shared<Connection>(socket, 64 * 1024));
+    }
+    return connections;
+  }
+
+  void bench_registry(Runner &runner)
+  {
+    for (long count : {100, 1000, 10000})
+    {
+      auto connections = make_connections(static_cast<size_t>(count));
+      ClientRegistry registry;
+
+      runner.run("registry/add_remove", {{"clients", count}}, static_cast<uint64_t>(count), 0, [&]
+                 {
+        for (auto &client : connections)
+          registry.add(client);
+        // Удаление вразброс: каждый второй, затем остальные
+        for (size_t i = 0; i < connections.size(); i += 2)
+          registry.remove(connections[i]->fd());
+        for (size_t i = 1; i < connections.size(); i += 2)
+          registry.remove(connections[i]->fd()); });
+
+      for (auto &client : connections)
+        registry.add(client);
+      runner.run("registry/find", {{"clients", count}}, static_cast<uint64_t>(count), 0, [&]
+                 {
+        for (auto &client : connections)
+          keep(registry.find(client->fd()).get()); });
+      runner.run("registry/iterate", {{"clients", count}}, static_cast<uint64_t>(count), 0, [&]
+                 {
+        size_t visited = 0;
+        registry.for_each([&](const std::shared_ptr<Connection> &client)
+                          { visited += client->pending_bytes() + 1; });
+        keep(visited); });
+
+      // Подписка и отписка всех клиентов шарда в одной комнате, как при волне переподключений:
+      // позиции хранятся в подписках и правятся у перенесенного подписчика, как в connectionManager
+      RoomIndex rooms;
+      auto leave = [&](Connection &client)
+      {
+        Connection::Subscription removed;
+        client.unsubscribe("general", removed);
+        int moved = rooms.leave(removed.room->view(), removed.slot);
+        if (moved >= 0)
+          registry.find(moved)->set_slot(removed.room.get(), removed.slot);
+      };
+      runner.run("rooms/join_leave", {{"members", count}}, static_cast<uint64_t>(count), 0, [&]
+                 {
+        for (auto &client : connections)
+        {
+          uint32_t slot = 0;
+          MessageRef name = rooms.join("general", client->fd(), slot);
+          client->subscribe(std::move(name), slot);
+        }
+        for (size_t i = 0; i < connections.size(); i += 2)
+          leave(*connections[i]);
+        for (size_t i = 1; i < connections.size(); i += 2)
+          leave(*connections[i]); });
+      registry.clear();
+    }
+  }
+
+  // ---------------------------------------------------------------- names
+
+  void bench_names(Runner &runner)
+  {
+    constexpr uint64_t kLookups = 1 << 16;
+    for (long count : {10, 1000, 100000})
+    {
+      std::vector<std::string> names;
+      names.reserve(static_cast<size_t>(count));
+      NameIndex index;
+      for (long i = 0; i < count; ++i)
+      {
+        names.push_back("user" + std::to_string(i));
+        NameIndex::Target target{static_cast<uint32_t>(i % 4), static_cast<int>(i), index.next_token()};
+        index.claim(names.back(), target, {});
+      }
+
+      runner.run("names/find", {{"names", count}}, kLookups, 0, [&]
+                 {
+        NameIndex::Target target;
+        for (uint64_t i = 0; i < kLookups; ++i)
+          keep(index.find(names[i % names.size()], target));
+        keep(target.fd); });
+      runner.run("names/rename", {{"names", count}}, kLookups, 0, [&]
+                 {
+        // Владелец user0 переименовывается туда и обратно
+        NameIndex::Target target{0, 0, 0};
+        index.find(names[0], target);
+        for (uint64_t i = 0; i < kLookups; i += 2)
+        {
+          index.claim("renamed", target, names[0]);
+          index.claim(names[0], target, "renamed");
+        } });
+    }
+  }
+
+  // ---------------------------------------------------------------- accept
+
+  void bench_accept(Runner &runner)
+  {
+    constexpr uint64_t kAccepts = 1 << 16;
+    for (long sources : {1, 1000, 100000})
+    {
+      // Общее ведро не мешает замеру; ведро адреса — 20 подключений в секунду
+      AcceptLimiter limiter({1e9, 0}, {20, 40}, 65536);
+      std::vector<sockaddr_in> peers(static_cast<size_t>(sources));
+      for (size_t i = 0; i < peers.size(); ++i)
+      {
+        peers[i].sin_family = AF_INET;
+        peers[i].sin_addr.s_addr = htonl(0x0A000000u + static_cast<uint32_t>(i));
+      }
+
+      // Одна операция — решение по одному принятому подключению
+      runner.run("accept/limit", {{"sources", sources}}, kAccepts, 0, [&]
+                 {
+        size_t accepted = 0;
+        auto now = AcceptLimiter::Clock::now();
+        for (uint64_t i = 0; i < kAccepts; ++i)
+        {
+          const auto *peer = reinterpret_cast<const sockaddr *>(&peers[i % peers.size()]);
+          accepted += limiter.admit(peer, now) == AcceptLimiter::Verdict::Accept;
+        }
+        keep(accepted); });
+    }
+  }
+
+  // ---------------------------------------------------------------- fanout
+
+  /**
+   * @class SinkBackend
+   * @brief IIoBackend в памяти: очередь подключения «отправляется» сборкой
+   * iovec и списанием, как после полного sendmsg
+   */
+  class SinkBackend : public IIoBackend
+  {
+  public:
+    const char *name() const noexcept override { return "sink"; }
+    void attach(const std::shared_ptr<Connection> &) override {}
+    void detach(const std::shared_ptr<Connection> &) override {}
+
+    void send(const std::shared_ptr<Connection> &client, Payload data) override
+    {
+      client->enqueue(std::move(data));
+      if (client->schedule_flush())
+        dirty_.push_back(client);
+    }
+
+    /// Списать очереди всех подключений с новыми данными
+    void flush()
+    {
+      iovec iov[64];
+      for (auto &client : dirty_)
+      {
+        client->clear_flush_scheduled();
+        while (client->has_pending_output())
+        {
+          size_t count = client->gather(iov, 64);
+          size_t bytes = 0;
+          for (size_t i = 0; i < count; ++i)
+            bytes += iov[i].iov_len;
+          client->consume(bytes);
+        }
+      }
+      dirty_.clear();
+    }
+
+  private:
+    std::vector<std::shared_ptr<Connection>> dirty_;
+  };
+
+  void bench_fanout(Runner &runner)
+  {
+    constexpr size_t kRounds = 16; ///< Сообщений в комнату между списаниями очередей
+    for (long count : {10, 100, 1000, 10000})
+    {
+      auto connections = make_connections(static_cast<size_t>(count));
+      ClientRegistry registry;
+      RoomIndex rooms;
+      SinkBackend sink;
+      for (auto &client : connections)
+      {
+        registry.add(client);
+        uint32_t slot = 0;
+        rooms.join("general", client->fd(), slot);
+      }
+      MessageRef msg = MessageBuffer::create({std::string(64, 'x'), "\n"});
+      std::shared_ptr<Socket> sender = connections.front()->socket();
+
+      // Одна операция — доставка одного сообщения одному получателю
+      runner.run("fanout/room", {{"recipients", count}}, kRounds * static_cast<uint64_t>(count), 0, [&]
+                 {
+        for (size_t round = 0; round < kRounds; ++round)
+        {
+          rooms.for_each_member("general", [&](int fd)
+                                {
+            const auto &client = registry.find(fd);
+            if (client && client->socket() != sender)
+              sink.send(client, msg); });
+        }
+        sink.flush(); });
+    }
+  }
+
+  // ---------------------------------------------------------------- history
+
+  void bench_history(Runner &runner)
+  {
+    for (long count : {100, 1000})
+    {
+      RoomHistory history(static_cast<size_t>(count), 64 * 1024 * 1024, 16);
+      for (long i = 0; i < count; ++i)
+        history.append("general", MessageBuffer::create({std::string(64, 'x'), "\n"}), MessageRef());
+      auto connections = make_connections(1);
+      SinkBackend sink;
+
+      // Одна операция — вся история комнаты одному подписчику, включая списание очереди
+      runner.run("history/backfill", {{"messages", count}}, 1, 0, [&]
+                 {
+        history.for_each("general", [&](RoomHistory::Entry &entry)
+                         { sink.send(connections.front(), entry.text); });
+        sink.flush(); });
+    }
+  }
+
+  // ---------------------------------------------------------------- pool
+
+  void bench_pool(Runner &runner)
+  {
+    constexpr size_t kMessages = 1024;
+    for (long size : {64, 1024, 8192})
+    {
+      std::string body(static_cast<size_t>(size), 'x');
+      std::vector<MessageRef> messages(kMessages);
+
+      // Одна операция — создание и освобождение сообщения; все kMessages живут одновременно
+      runner.run("pool/message", {{"size", size}}, kMessages, 0, [&]
+                 {
+        for (auto &message : messages)
+          message = MessageBuffer::create({body, "\n"});
+        for (auto &message : messages)
+          message = MessageRef(); });
+    }
+  }
+
+  // ---------------------------------------------------------------- pipeline
+
+  void bench_pipeline(Runner &runner)
+  {
+    constexpr size_t kMessages = 1024;
+    constexpr long kRecipients = 10;
+    auto connections = make_connections(kRecipients);
+    ClientRegistry registry;
+    RoomIndex rooms;
+    RoomHistory history(100, 256 * 1024, 16);
+    SinkBackend sink;
+    for (auto &client : connections)
+    {
+      registry.add(client);
+      uint32_t slot = 0;
+      rooms.join("general", client->fd(), slot);
+    }
+    Connection &sender = *connections.front();
+    std::string line = std::string(64, 'x') + "\n";
+
+    // Одна операция — сообщение клиента тем же путем, что в connectionManager:
+    // разбор, буфер сообщения, рассылка в комнату, история, запись очередей
+    runner.run("pipeline/message", {{"recipients", kRecipients}}, kMessages, 0, [&]
+               {
+      for (size_t i = 0; i < kMessages; ++i)
+      {
+        sender.framer().append(line.data(), line.size());
+        Framer::Frame frame;
+        while (sender.framer().next(frame))
+        {
+          MessageRef msg = MessageBuffer::create({frame.parts[0], frame.parts[1], "\n"});
+          rooms.for_each_member("general", [&](int fd)
+                                {
+            const auto &client = registry.find(fd);
+            if (client && client.get() != &sender)
+              sink.send(client, msg); });
+          history.append("general", msg, MessageRef());
+        }
+        sender.framer().release();
+        sink.flush();
+      } });
+  }
+
+  // ---------------------------------------------------------------- loop
+
+  void bench_loop(Runner &runner)
+  {
+    constexpr uint64_t kTasks = 4096;
+    EventLoop loop;
+    std::thread thread([&]
+                       { loop.run(); });
+    std::atomic<uint64_t> done{0};
+    auto sender = std::make_shared<int>(0);
+    MessageRef room = MessageBuffer::create({"general"});
+    MessageRef msg = MessageBuffer::create({std::string(64, 'x'), "\n"});
+
+    // Одна операция — задача с замыканием как у рассылки между шардами
+    // (указатель, отправитель, комната, сообщение) и ее выполнение
+    runner.run("loop/post", {{"tasks", static_cast<long>(kTasks)}}, kTasks, 0, [&]
+               {
+      uint64_t target = done.load(std::memory_order_relaxed) + kTasks;
+      for (uint64_t i = 0; i < kTasks; ++i)
+      {
+        loop.post([&done, sender, room, msg]
+                  {
+          keep(msg.get());
+          done.fetch_add(1, std::memory_order_release); });
+      }
+      while (done.load(std::memory_order_acquire) < target)
+        std::this_thread::yield(); });
+
+    loop.stop();
+    thread.join();
+  }
+
+  // ---------------------------------------------------------------- footprint
+
+  /**
+   * Прирост кучи на одно простаивающее подключение: прием так же, как в
+   * connectionManager::acceptClients (сокет, Connection, таймер, реестр,
+   * подписка на комнату), приветствие, одно входящее сообщение и опустевшие
+   * очереди. Слабы BlockPool учитываются целиком, поэтому замер выполняется
+   * первым, пока пул пуст
+   */
+  void bench_footprint(Runner &runner)
+  {
+    constexpr long kClients = 10000;
+    if (!runner.selected(Runner::full_name("connection/footprint", {{"clients", kClients}})))
+      return;
+
+    MessageRef welcome = MessageBuffer::create({std::string(100, 'w'), "\n"});
+    ClientRegistry registry;
+    RoomIndex rooms;
+    SinkBackend sink;
+    std::vector<std::shared_ptr<Connection>> connections;
+    connections.reserve(kClients);
+
+    int64_t before = live_bytes.load(std::memory_order_relaxed);
+    for (long i = 0; i < kClients; ++i)
+    {
+      auto socket = std::allocate_shared<Socket>(PoolAllocator<Socket>(), ::socket(AF_INET, SOCK_STREAM, 0));
+      auto client = std::allocate_shared<Connection>(PoolAllocator<Connection>(), socket, 64 * 1024);
+      Connection *raw = client.get();
+      client->timer().callback = [&registry, &rooms, raw]
+      { keep(raw); };
+      registry.add(client);
+      uint32_t slot = 0;
+      MessageRef room = rooms.join("general", client->fd(), slot);
+      client->subscribe(std::move(room), slot);
+      sink.send(client, welcome);
+
+      client->framer().append("hello\n", 6);
+      Framer::Frame frame;
+      while (client->framer().next(frame))
+        keep(frame.size());
+      client->framer().release();
+      connections.push_back(std::move(client));
+    }
+    sink.flush();
+    int64_t after = live_bytes.load(std::memory_order_relaxed);
+
+    runner.report("connection/footprint", {{"clients", kClients}}, "bytes_per_client",
+                  static_cast<double>(after - before) / kClients);
+  }
+
+  // ---------------------------------------------------------------- store
+
+  /// Удалить каталог журнала вместе с сегментами
+  void remove_dir(const std::string &dir)
+  {
+    if (DIR *listing = opendir(dir.c_str()))
+    {
+      while (dirent *entry = readdir(listing))
+      {
+        std::string name = entry->d_name;
+        if (name != "." && name != "..")
+          unlink((dir + "/" + name).c_str());
+      }
+      closedir(listing);
+    }
+    rmdir(dir.c_str());
+  }
+
+  void bench_store(Runner &runner)
+  {
+    constexpr size_t kMessages = 65536; ///< Сообщений между ожиданиями фиксации
+    char dir[] = "/tmp/micro_bench_storeXXXXXX";
+    if (!mkdtemp(dir))
+      throw std::runtime_error("cannot create a temporary directory");
+
+    {
+      MessageLog log(dir);
+      MessageRef room = MessageBuffer::create({"general"});
+      MessageRef msg = MessageBuffer::create({std::string(64, 'x'), "\n"});
+
+      // Одна операция — постановка сообщения; ожидание fdatasync пачек входит в замер
+      runner.run("store/append", {{"bytes", 64}}, kMessages, 0, [&]
+                 {
+        for (size_t i = 0; i < kMessages; ++i)
+          log.append(room, msg);
+        log.sync(); });
+    }
+    remove_dir(dir);
+  }
+
+  // ---------------------------------------------------------------- log
+
+  void bench_log(Runner &runner)
+  {
+    // Пачка меньше кольца потока: замер не уходит в ветку отбрасывания
+    constexpr size_t kRecords = Log::kRecords / 2;
+    int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (null_fd < 0)
+      throw std::runtime_error("cannot open /dev/null");
+    Log::set_output(null_fd);
+    Log::set_level(LogLevel::Info);
+    std::string_view text = "hello, room";
+
+    runner.run("log/disabled", {}, kRecords, 0, [&]
+               {
+      for (size_t i = 0; i < kRecords; ++i)
+        Log::write(LogLevel::Debug, "Received: %.*s", static_cast<int>(text.size()), text.data()); });
+
+    LogSampler sampler(100);
+    runner.run("log/sampled", {{"every", 100}}, kRecords, 0, [&]
+               {
+      for (size_t i = 0; i < kRecords; ++i)
+        Log::sampled(sampler, LogLevel::Info, "Received: %.*s", static_cast<int>(text.size()), text.data()); });
+
+    runner.run("log/enabled", {}, kRecords, 0, [&]
+               {
+      for (size_t i = 0; i < kRecords; ++i)
+        Log::write(LogLevel::Info, "Received: %.*s", static_cast<int>(text.size()), text.data());
+      Log::flush(); });
+
+    Log::flush();
+    Log::set_output(2);
+    close(null_fd);
+  }
+
+  void usage()
+  {
+    std::cerr << "usage: micro_bench [--filter SUBSTR] [--min-time MS] [--repetitions R] [--out FILE]\n";
+  }
+
+  bool parse(int argc, char **argv, Options &opt)
+  {
+    for (int i = 1; i < argc; ++i)
+    {
+      std::string key = argv[i];
+      if (i + 1 >= argc)
+        return false;
+      std::string value = argv[++i];
+      if (key == "--filter")
+        opt.filter = value;
+      else if (key == "--min-time")
+        opt.min_time_ms = std::stod(value);
+      else if (key == "--repetitions")
+        opt.repetitions = std::stoi(value);
+      else if (key == "--out")
+        opt.out = value;
+      else
+        return false;
+    }
+    return opt.repetitions > 0 && opt.min_time_ms > 0;
+  }
+
+  void raise_fd_limit()
+  {
+    rlimit rl{};
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max)
+    {
+      rl.rlim_cur = rl.rlim_max;
+      setrlimit(RLIMIT_NOFILE, &rl);
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  Options opt;
+  try
+  {
+    if (!parse(argc, argv, opt))
+    {
+      usage();
+      return 2;
+    }
+  }
+  catch (std::exception &)
+  {
+    usage();
+    return 2;
+  }
+
+  raise_fd_limit();
+
+  try
+  {
+    Runner runner(opt);
+    bench_footprint(runner);
+    bench_framing(runner);
+    bench_chain(runner);
+    bench_router(runner);
+    bench_registry(runner);
+    bench_names(runner);
+    bench_accept(runner);
+    bench_fanout(runner);
+    bench_history(runner);
+    bench_pool(runner);
+    bench_pipeline(runner);
+    bench_loop(runner);
+    bench_store(runner);
+    bench_log(runner);
+
+    std::string json = runner.json();
+    if (opt.out.empty())
+    {
+      std::cout << json;
+    }
+    else
+    {
+      std::ofstream file(opt.out);
+      file << json;
+      if (!file)
+        throw std::runtime_error("cannot write " + opt.out);
+    }
+    return 0;
+  }
+  catch (std::exception &e)
+  {
+    std::cerr << e.what() << '\n';
+    return 1;
+  }
+}
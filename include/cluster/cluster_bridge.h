@@ -0,0 +1,200 @@
+/**
+ * @file cluster_bridge.h
+ * @brief Мост между процессами chat_server: рассылка по узлам кластера
+ * @defgroup Cluster Кластер
+ */
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/socket.h>
+#include "../include/net/socket.h"
+#include "../include/net/connection/message_buffer.h"
+#include "../include/net/reactor/event_loop.h"
+#include "../include/net/reactor/timer_wheel.h"
+
+/**
+ * @class ClusterBridge
+ * @brief Связи с другими узлами: пересылка своих рассылок и прием чужих
+ *
+ * @details Кластер — полная сетка: каждый узел перечисляет в peers всех
+ * остальных и сам подключается к ним по TCP. Рассылка, начатая клиентом
+ * этого узла, уходит одним кадром в каждое исходящее подключение — по
+ * одному на узел, а не на удаленного получателя; принявший узел раздает ее
+ * своим клиентам. Входящие подключения только принимают кадры.
+ *
+ * Защита от петель: принятое сообщение доставляется только локально и
+ * дальше не пересылается, а кадры с собственным идентификатором узла
+ * отбрасываются. Каждый узел нумерует свои сообщения (seq); приемник
+ * помнит последний номер каждого источника, отбрасывает повторы и считает
+ * пропуски. Идентификатор узла случаен при каждом запуске, поэтому
+ * перезапущенный узел — новый источник и нумерация с нуля не путается
+ * с прежней.
+ *
+ * Кадр: u32 длина остатка, u64 узел-источник, u64 seq, u64 время отправки
+ * (system_clock, нс), u16 длина имени комнаты, комната, текст. Исходящее
+ * подключение начинается приветствием: 8 байт "CHATNODE", u64 узел, u16
+ * длина секрета и сам секрет. Числа — в порядке байтов узла (кластер
+ * однородный).
+ *
+ * Входящее подключение принимается только с адреса одного из peers (порт
+ * не сравнивается: исходящий порт узла случаен) и только с тем же секретом,
+ * что задан в Options::secret. Секрет передается открытым текстом и
+ * защищает лишь от случайных и подложных подключений, а не от перехвата:
+ * порт кластера должен быть доступен только узлам (отдельная сеть или
+ * межсетевой экран), наружу его открывать нельзя.
+ *
+ * Свой цикл событий и поток: публикации из потоков шардов копятся в очереди,
+ * первая из пачки будит поток моста, и вся пачка сериализуется один раз и
+ * одним send уходит каждому узлу. Пока узел недоступен, его сообщения
+ * отбрасываются (повторной отправки нет), подключение повторяется каждые
+ * reconnect_interval.
+ *
+ * @threadsafe publish() можно вызывать из любого потока
+ */
+class ClusterBridge
+{
+public:
+  /// Наибольшая длина секрета узлов
+  static constexpr size_t kMaxSecret = 1024;
+
+  /// Параметры моста
+  struct Options
+  {
+    std::string ip;                                     ///< Адрес для входящих подключений узлов
+    int port = 0;                                       ///< Порт для входящих подключений узлов
+    std::vector<std::string> peers;                     ///< Остальные узлы, "адрес:порт"; с других адресов подключения не принимаются
+    std::string secret;                                 ///< Общий секрет узлов (до kMaxSecret байт); пусто — проверяется только адрес
+    std::chrono::milliseconds reconnect_interval{1000}; ///< Пауза перед повторным подключением
+    size_t max_queued_bytes = 64 * 1024 * 1024;         ///< Предел очереди отправки узлу; сверх него сообщения отбрасываются
+  };
+
+  /// Сообщение, принятое от другого узла
+  struct Inbound
+  {
+    MessageRef room; ///< Комната (пустая ссылка — рассылка всем)
+    MessageRef text; ///< Текст с завершающим "\n"
+  };
+
+  /// Доставка пачки принятых сообщений (вызывается в потоке моста)
+  using Deliver = std::function<void(std::vector<Inbound> &&batch)>;
+
+  /**
+   * @brief Открыть слушающий сокет, начать подключения к узлам и запустить поток
+   * @param options Параметры
+   * @param deliver Доставка принятых сообщений своим клиентам
+   * @throws std::runtime_error при ошибке bind/listen, неверном адресе узла или слишком длинном секрете
+   */
+  ClusterBridge(Options options, Deliver deliver);
+
+  /// @brief Останавливает поток и закрывает подключения
+  ~ClusterBridge();
+
+  ClusterBridge(const ClusterBridge &) = delete;
+  ClusterBridge &operator=(const ClusterBridge &) = delete;
+
+  /**
+   * @brief Переслать рассылку своего клиента всем узлам
+   * @param room Комната (пустая ссылка — рассылка всем)
+   * @param text Текст с завершающим "\n"
+   */
+  void publish(const MessageRef &room, const MessageRef &text);
+
+  /// @brief Идентификатор этого узла
+  uint64_t node_id() const noexcept { return node_id_; }
+
+  /// @brief Число узлов, к которым сейчас установлено исходящее подключение
+  size_t connected_peers() const noexcept { return connected_.load(std::memory_order_relaxed); }
+
+private:
+  /// Сообщение в очереди на пересылку
+  struct Outgoing
+  {
+    uint64_t seq;     ///< Номер у этого узла
+    uint64_t time_ns; ///< Время публикации
+    MessageRef room;  ///< Комната
+    MessageRef text;  ///< Текст
+  };
+
+  /// Узел, к которому подключается этот
+  struct Peer
+  {
+    std::string address;     ///< "адрес:порт" из параметров
+    sockaddr_storage addr{}; ///< Разобранный адрес
+    socklen_t addr_len = 0;  ///< Длина адреса
+    int fd = -1;             ///< Исходящее подключение (-1 — нет)
+    bool connected = false;  ///< connect завершен, очередь можно писать
+    Timer retry;             ///< Повторное подключение
+  };
+
+  /// Подключение (исходящее к Peer или входящее от другого узла)
+  struct Link
+  {
+    int fd = -1;             ///< Дескриптор
+    Peer *peer = nullptr;    ///< Узел исходящего подключения; nullptr — входящее
+    std::string in;          ///< Непрочитанные кадры
+    std::string out;         ///< Неотправленные данные
+    size_t out_offset = 0;   ///< Отправлено из out
+    bool writing = false;    ///< Ожидается EPOLLOUT
+    bool greeted = false;    ///< Приветствие прочитано (у исходящего — не ожидается)
+    uint64_t remote = 0;     ///< Узел на другой стороне (для журнала)
+  };
+
+  Options options_;  ///< Параметры
+  Deliver deliver_;  ///< Доставка принятых сообщений
+  uint64_t node_id_; ///< Идентификатор узла
+
+  EventLoop loop_;                                       ///< Цикл событий моста
+  TimerWheel timers_;                                    ///< Таймеры повторных подключений
+  Socket listener_;                                      ///< Слушающий сокет для входящих подключений узлов
+  std::vector<std::unique_ptr<Peer>> peers_;             ///< Узлы из параметров
+  std::unordered_map<int, std::unique_ptr<Link>> links_; ///< Открытые подключения
+  std::unordered_map<uint64_t, uint64_t> last_seq_;      ///< Последний принятый номер каждого источника
+  std::atomic<size_t> connected_{0};                     ///< Установленных исходящих подключений
+
+  std::mutex outbox_mutex_;       ///< Защищает outbox_ и next_seq_
+  std::vector<Outgoing> outbox_;  ///< Опубликованные, еще не сериализованные сообщения
+  uint64_t next_seq_ = 0;         ///< Номер следующего своего сообщения
+  std::vector<Outgoing> sending_; ///< Забранная пачка (только поток моста)
+  std::string batch_;             ///< Сериализованная пачка (только поток моста)
+  std::vector<Inbound> received_; ///< Принятые за одно чтение (только поток моста)
+
+  std::thread thread_; ///< Поток цикла моста
+
+  /// @brief Начать неблокирующее подключение к узлу
+  void dial(Peer &peer);
+
+  /// @brief Принять ожидающие входящие подключения
+  void accept();
+
+  /// @brief true, если адрес входящего подключения принадлежит одному из узлов
+  bool known_peer(const sockaddr_storage &from) const noexcept;
+
+  /**
+   * @brief Обработать событие подключения
+   * @param fd Дескриптор
+   * @param events События epoll
+   */
+  void serve(int fd, uint32_t events);
+
+  /// @brief Разобрать принятые кадры подключения; false — нарушение протокола
+  bool parse(Link &link);
+
+  /// @brief Сериализовать очередь публикаций и поставить ее всем подключенным узлам
+  void flush();
+
+  /// @brief Отправить очередь подключения; false — подключение оборвано
+  bool send(Link &link);
+
+  /// @brief Закрыть подключение; исходящее повторяется после паузы
+  void drop(int fd);
+};
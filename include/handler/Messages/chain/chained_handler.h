@@ -43,5 +43,5 @@ public:
    * @details Метод последовательно вызывает handle() у всех обработчиков
    * до первого успешного выполнения. Порядок вызова соответствует порядку добавления.
    */
-  bool handle(std::shared_ptr<Socket> sender, const std::string &msg) override;
+  bool handle(std::shared_ptr<Socket> sender, const MessageRef &msg) override;
 };
\ No newline at end of file
@@ -5,36 +5,29 @@
  */
 
 #pragma once
-#include <mutex>
 #include "../include/handler/Messages/interface/imessage_handler.h"
 #include "../include/net/connection/connectionManager.h"
 /**
  * @class BroadcastHandler
- * @brief Реализует рассылку сообщений всем подключенным клиентам, кроме отправителя
+ * @brief Реализует рассылку сообщений подписчикам текущей комнаты отправителя
  *
  * @details Класс обеспечивает:
  * - Потокобезопасную рассылку сообщений
  * - Фильтрацию отправителя
  * - Интеграцию с паттерном Chain of Responsibility
  *
- * @note Для работы требует внешний thread-safe контейнер клиентов
- * @warning Клиенты должны жить дольше экземпляра BroadcastHandler
+ * @note Доставку по шардам выполняет connectionManager::broadcast()
+ * @warning Менеджер подключений должен жить дольше экземпляра BroadcastHandler
  * @see IMessageHandler для базового интерфейса
  */
 class BroadcastHandler : public IMessageHandler
 {
 public:
-  /// Тип контейнера для хранения клиентов
-  using ClientContainer = std::vector<std::shared_ptr<Socket>>;
-
   /**
    * @brief Конструктор обработчика
-   * @param clients Ссылка на контейнер клиентов (должен быть thread-safe)
-   * @param mutex Мьютекс для синхронизации доступа к клиентам
-   * @pre Контейнер clients должен быть валидным
-   * @pre Мьютекс mutex должен защищать доступ к clients
+   * @param manager Менеджер подключений, выполняющий доставку
    */
-  explicit BroadcastHandler(ClientContainer &clients, std::mutex &mutex);
+  explicit BroadcastHandler(connectionManager &manager);
 
   /**
    * @brief Обработка входящего сообщения
@@ -43,16 +36,15 @@ public:
    * @return Всегда возвращает true (сообщение считается обработанным)
    *
    * @details Алгоритм работы:
-   * 1. Блокирует мьютекс для безопасного доступа к клиентам
-   * 2. Рассылает сообщение всем клиентам кроме отправителя
-   * 3. Игнорирует ошибки отправки отдельным клиентам
-   * 4. Разблокирует мьютекс при выходе
+   * 1. Подписчикам комнаты в шарде отправителя сообщение сразу ставится в очереди отправки
+   * 2. Остальным шардам оно передается через их очереди задач
+   * 3. Запись в сокеты выполняется циклом событий позже; медленный
+   *    получатель не задерживает рассылку
    *
-   * @threadsafe Гарантируется потокобезопасность при использовании общего мьютекса
+   * @threadsafe Общих блокировок на время рассылки не берется
    */
-  bool handle(std::shared_ptr<Socket> sender, const std::string &msg) override;
+  bool handle(std::shared_ptr<Socket> sender, const MessageRef &msg) override;
 
 private:
-  ClientContainer &clients_; ///< Ссылка на контейнер клиентов
-  std::mutex &mutex_;        ///< Ссылка на мьютекс для синхронизации
+  connectionManager &manager_; ///< Менеджер подключений
 };
\ No newline at end of file
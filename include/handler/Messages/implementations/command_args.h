@@ -0,0 +1,48 @@
+/**
+ * @file command_args.h
+ * @brief Разбор текстовых команд и проверка имен для обработчиков команд
+ * @ingroup Handlers
+ */
+
+#pragma once
+#include <cstddef>
+#include <string_view>
+
+/**
+ * @brief Проверить, что text — команда command (с аргументом или без)
+ * @param text Строка без завершающего "\n"
+ * @param command Имя команды вместе с "/"
+ * @param arg Аргумент команды без окружающих пробелов
+ * @return true, если строка — эта команда
+ */
+inline bool match_command(std::string_view text, std::string_view command, std::string_view &arg) noexcept
+{
+  if (text.substr(0, command.size()) != command)
+    return false;
+  text.remove_prefix(command.size());
+  if (!text.empty() && text.front() != ' ')
+    return false;
+
+  size_t begin = text.find_first_not_of(' ');
+  size_t end = text.find_last_not_of(' ');
+  arg = begin == std::string_view::npos ? std::string_view() : text.substr(begin, end - begin + 1);
+  return true;
+}
+
+/**
+ * @brief Проверить имя комнаты или никнейм
+ * @param name Имя
+ * @param max_size Наибольшая длина
+ * @return true, если имя непустое, не длиннее max_size и без пробелов и управляющих символов
+ */
+inline bool valid_name(std::string_view name, size_t max_size) noexcept
+{
+  if (name.empty() || name.size() > max_size)
+    return false;
+  for (unsigned char ch : name)
+  {
+    if (ch <= ' ' || ch == 0x7F)
+      return false;
+  }
+  return true;
+}
@@ -0,0 +1,65 @@
+/**
+ * @file room_handler.h
+ * @brief Обработчик команд комнат (/join, /leave)
+ * @ingroup Handlers
+ */
+
+#pragma once
+#include <string_view>
+#include "../include/handler/Messages/interface/imessage_handler.h"
+#include "../include/net/connection/connectionManager.h"
+
+/**
+ * @class RoomHandler
+ * @brief Подписка клиента на комнаты
+ *
+ * @details Команды:
+ * - `/join <room>` — подписаться на комнату и сделать ее текущей; новый
+ *   подписчик получает историю комнаты
+ * - `/leave [room]` — отписаться от комнаты (по умолчанию от текущей)
+ *
+ * Имя комнаты — от 1 до kMaxRoomName печатных символов без пробелов.
+ * Результат команды сообщается отправителю. Остальные сообщения передаются
+ * дальше по цепочке. В CommandRouter команды регистрируются напрямую через
+ * join() и leave().
+ *
+ * @warning Менеджер подключений должен жить дольше экземпляра RoomHandler
+ * @see connectionManager::join, connectionManager::leave
+ */
+class RoomHandler : public IMessageHandler
+{
+public:
+  /// Максимальная длина имени комнаты
+  static constexpr size_t kMaxRoomName = 64;
+
+  /**
+   * @brief Конструктор обработчика
+   * @param manager Менеджер подключений, хранящий подписки
+   */
+  explicit RoomHandler(connectionManager &manager);
+
+  /**
+   * @brief Обработать команду комнаты
+   * @param sender Сокет-отправитель
+   * @param msg Сообщение
+   * @return true, если сообщение было командой /join или /leave
+   */
+  bool handle(std::shared_ptr<Socket> sender, const MessageRef &msg) override;
+
+  /**
+   * @brief Выполнить /join
+   * @param sender Сокет-отправитель
+   * @param room Аргумент команды (имя комнаты)
+   */
+  void join(const std::shared_ptr<Socket> &sender, std::string_view room);
+
+  /**
+   * @brief Выполнить /leave
+   * @param sender Сокет-отправитель
+   * @param room Аргумент команды (пусто — текущая комната)
+   */
+  void leave(const std::shared_ptr<Socket> &sender, std::string_view room);
+
+private:
+  connectionManager &manager_; ///< Менеджер подключений
+};
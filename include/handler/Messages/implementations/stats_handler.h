@@ -0,0 +1,44 @@
+/**
+ * @file stats_handler.h
+ * @brief Обработчик команды /stats
+ * @ingroup Handlers
+ */
+
+#pragma once
+#include "../include/handler/Messages/interface/imessage_handler.h"
+#include "../include/net/connection/connectionManager.h"
+
+/**
+ * @class StatsHandler
+ * @brief Отправляет клиенту метрики сервера
+ *
+ * @details Команда `/stats` возвращает отправителю текст
+ * connectionManager::metrics_text() (формат Prometheus). Остальные сообщения
+ * передаются дальше по цепочке. В CommandRouter команда регистрируется
+ * через stats().
+ *
+ * @warning Менеджер подключений должен жить дольше экземпляра StatsHandler
+ */
+class StatsHandler : public IMessageHandler
+{
+public:
+  /**
+   * @brief Конструктор обработчика
+   * @param manager Менеджер подключений
+   */
+  explicit StatsHandler(connectionManager &manager);
+
+  /**
+   * @brief Обработать команду /stats
+   * @param sender Сокет-отправитель
+   * @param msg Сообщение
+   * @return true, если сообщение было командой /stats
+   */
+  bool handle(std::shared_ptr<Socket> sender, const MessageRef &msg) override;
+
+  /// @brief Выполнить /stats: отправить метрики отправителю
+  void stats(const std::shared_ptr<Socket> &sender);
+
+private:
+  connectionManager &manager_; ///< Менеджер подключений
+};
@@ -0,0 +1,61 @@
+/**
+ * @file user_handler.h
+ * @brief Обработчик никнеймов и личных сообщений (/nick, /msg)
+ * @ingroup Handlers
+ */
+
+#pragma once
+#include <string_view>
+#include "../include/handler/Messages/interface/imessage_handler.h"
+#include "../include/net/connection/connectionManager.h"
+
+/**
+ * @class UserHandler
+ * @brief Никнейм клиента и личные сообщения по никнейму
+ *
+ * @details Команды:
+ * - `/nick <name>` — занять никнейм (прежний освобождается)
+ * - `/msg <nick> <text>` — отправить текст одному клиенту
+ *
+ * Никнейм — от 1 до NameIndex::kMaxName печатных символов без пробелов.
+ * Результат команды сообщается отправителю. Остальные сообщения передаются
+ * дальше по цепочке. В CommandRouter команды регистрируются напрямую через
+ * nick() и msg().
+ *
+ * @warning Менеджер подключений должен жить дольше экземпляра UserHandler
+ * @see connectionManager::set_nick, connectionManager::direct
+ */
+class UserHandler : public IMessageHandler
+{
+public:
+  /**
+   * @brief Конструктор обработчика
+   * @param manager Менеджер подключений, хранящий никнеймы
+   */
+  explicit UserHandler(connectionManager &manager);
+
+  /**
+   * @brief Обработать команду /nick или /msg
+   * @param sender Сокет-отправитель
+   * @param msg Сообщение
+   * @return true, если сообщение было одной из этих команд
+   */
+  bool handle(std::shared_ptr<Socket> sender, const MessageRef &msg) override;
+
+  /**
+   * @brief Выполнить /nick
+   * @param sender Сокет-отправитель
+   * @param name Аргумент команды (никнейм)
+   */
+  void nick(const std::shared_ptr<Socket> &sender, std::string_view name);
+
+  /**
+   * @brief Выполнить /msg
+   * @param sender Сокет-отправитель
+   * @param args Аргумент команды: никнейм получателя и текст
+   */
+  void msg(const std::shared_ptr<Socket> &sender, std::string_view args);
+
+private:
+  connectionManager &manager_; ///< Менеджер подключений
+};
@@ -4,6 +4,7 @@
  * @defgroup Handlers Группа обработчиков сообщений
  */
 #pragma once
+#include "./net/connection/message_buffer.h"
 #include "./net/socket.h"
 #include <memory>
 
@@ -24,7 +25,8 @@ public:
   /**
    * @brief Обработать входящее сообщение
    * @param sender Умный указатель на сокет-отправитель
-   * @param msg Текст полученного сообщения
+   * @param msg Полученное сообщение (с завершающим переводом строки);
+   *            его можно без копирования поставить в очереди получателей
    * @return true - если сообщение было обработано,
    *         false - если обработчик не смог обработать сообщение
    *
@@ -36,7 +38,7 @@ public:
    * @throws Может генерировать исключения при критических ошибках
    * @threadsafe Должен быть безопасен для вызова из разных потоков
    */
-  virtual bool handle(std::shared_ptr<Socket> sender, const std::string &msg) = 0;
+  virtual bool handle(std::shared_ptr<Socket> sender, const MessageRef &msg) = 0;
 
   /**
    * @brief Виртуальный деструктор
@@ -0,0 +1,113 @@
+/**
+ * @file handler_pool.h
+ * @brief Пул потоков для цепочки обработчиков сообщений
+ * @ingroup Handlers
+ */
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../include/net/connection/connection.h"
+
+/**
+ * @class HandlerPool
+ * @brief Ограниченный пул рабочих потоков с дорожками по подключениям
+ *
+ * @details Потоки ввода-вывода только разбирают кадры и передают сообщения
+ * пулу, поэтому дорогой обработчик не задерживает чтение и запись. Каждый
+ * поток пула обслуживает свою дорожку (очередь), подключение всегда попадает
+ * в одну и ту же дорожку по дескриптору — сообщения одного клиента
+ * обрабатываются строго по порядку, разные клиенты — параллельно.
+ * Очередь дорожки ограничена: при переполнении submit() отказывает, и решение
+ * остается за вызывающим (обработка не блокирует поток ввода-вывода).
+ * Глубина очередей и время ожидания задач видны через stats().
+ *
+ * @threadsafe submit() и stats() можно вызывать из любого потока
+ */
+class HandlerPool
+{
+public:
+  /// Сообщение, ожидающее обработки
+  struct Job
+  {
+    std::shared_ptr<Connection> client;           ///< Подключение-отправитель
+    MessageRef msg;                               ///< Сообщение (пустая ссылка — служебная задача)
+    void *context = nullptr;                      ///< Данные вызывающего (передаются исполнителю как есть)
+    std::chrono::steady_clock::time_point queued; ///< Момент постановки в очередь (заполняет submit)
+  };
+
+  /// Исполнитель задачи; вызывается в потоке пула
+  using Executor = std::function<void(Job &job)>;
+
+  /// Счетчики пула (сумма по дорожкам)
+  struct Stats
+  {
+    size_t threads = 0;         ///< Количество потоков
+    size_t queued = 0;          ///< Задач в очередях сейчас
+    uint64_t processed = 0;     ///< Выполнено задач
+    uint64_t rejected = 0;      ///< Отказано из-за переполнения очереди
+    uint64_t wait_ns_total = 0; ///< Суммарное время ожидания в очереди, нс
+    uint64_t wait_ns_max = 0;   ///< Наибольшее время ожидания в очереди, нс
+  };
+
+  /**
+   * @brief Запустить потоки пула
+   * @param threads Количество потоков (и дорожек), не меньше 1
+   * @param capacity Максимум задач в очереди одной дорожки
+   * @param executor Исполнитель задач
+   */
+  HandlerPool(size_t threads, size_t capacity, Executor executor);
+
+  /// @brief Останавливает пул (см. stop())
+  ~HandlerPool();
+
+  HandlerPool(const HandlerPool &) = delete;
+  HandlerPool &operator=(const HandlerPool &) = delete;
+
+  /**
+   * @brief Поставить сообщение в дорожку его подключения
+   * @param job Задача (client обязателен)
+   * @return false, если очередь дорожки заполнена или пул остановлен
+   */
+  bool submit(Job job);
+
+  /**
+   * @brief Выполнить оставшиеся задачи и остановить потоки
+   * @note Повторный вызов ничего не делает
+   */
+  void stop();
+
+  /// @brief Счетчики пула
+  Stats stats() const noexcept;
+
+private:
+  /// Дорожка: очередь и обслуживающий ее поток
+  struct Lane
+  {
+    std::mutex mutex;                       ///< Защищает jobs и stopping
+    std::condition_variable ready;          ///< Появилась задача или запрошена остановка
+    std::vector<Job> jobs;                  ///< Очередь задач (забирается целиком, емкость сохраняется)
+    bool stopping = false;                  ///< Запрошена остановка
+    std::thread thread;                     ///< Поток дорожки
+    std::atomic<size_t> depth{0};           ///< Копия jobs.size() для stats()
+    std::atomic<uint64_t> processed{0};     ///< Выполнено задач
+    std::atomic<uint64_t> rejected{0};      ///< Отказано задач
+    std::atomic<uint64_t> wait_ns_total{0}; ///< Суммарное ожидание, нс
+    std::atomic<uint64_t> wait_ns_max{0};   ///< Наибольшее ожидание, нс
+  };
+
+  std::vector<std::unique_ptr<Lane>> lanes_; ///< Дорожки пула
+  size_t capacity_;                          ///< Максимум задач в дорожке
+  Executor executor_;                        ///< Исполнитель задач
+
+  /// @brief Цикл потока дорожки
+  void run(Lane &lane);
+};
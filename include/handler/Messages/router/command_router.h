@@ -0,0 +1,104 @@
+/**
+ * @file command_router.h
+ * @brief Маршрутизатор команд чата за одно обращение к таблице
+ * @ingroup Handlers
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "../include/handler/Messages/interface/imessage_handler.h"
+
+/**
+ * @class CommandRouter
+ * @brief Команда -> обработчик через совершенный хеш; обычный текст — сразу в рассылку
+ *
+ * @details Сообщение, начинающееся не с '/', без поиска передается
+ * обработчику текста (обычно BroadcastHandler). У команды выделяется имя
+ * (до пробела), по нему вычисляется хеш и номер ячейки таблицы; в ячейке
+ * сравнивается одна строка. Стоимость поиска не зависит от числа команд, в
+ * отличие от ChainedHandler, где каждое сообщение проходит всех
+ * обработчиков через виртуальный вызов и сравнение префикса.
+ *
+ * Таблица строится при регистрации: ее размер — степень двойки не меньше
+ * удвоенного числа команд, а множитель хеша подбирается так, чтобы у всех
+ * имен были разные ячейки (совершенный хеш). После запуска сервера таблица
+ * не меняется, поэтому handle() читает ее без блокировок.
+ *
+ * Неизвестная команда обрабатывается как текст (так же, как раньше в конце
+ * цепочки).
+ *
+ * @warning add() и set_text() вызываются до запуска сервера
+ * @threadsafe handle() можно вызывать из любого потока
+ */
+class CommandRouter : public IMessageHandler
+{
+public:
+  /// Обработчик команды: отправитель и аргумент без окружающих пробелов
+  using Command = std::function<void(const std::shared_ptr<Socket> &sender, std::string_view args)>;
+
+  /// Максимальная длина имени команды вместе с '/'
+  static constexpr size_t kMaxName = 32;
+
+  /**
+   * @brief Зарегистрировать команду
+   * @tparam Fn Вызываемый объект void(const std::shared_ptr<Socket> &, std::string_view)
+   * @param name Имя с '/' в начале, например "/join"
+   * @param fn Обработчик
+   * @throws std::runtime_error если имя некорректно или уже занято
+   */
+  template <typename Fn>
+  void add(std::string_view name, Fn fn)
+  {
+    static_assert(std::is_invocable_r_v<void, Fn &, const std::shared_ptr<Socket> &, std::string_view>,
+                  "command handler must be callable as void(const std::shared_ptr<Socket> &, std::string_view)");
+    add_command(name, Command(std::move(fn)));
+  }
+
+  /**
+   * @brief Задать обработчик обычного текста и неизвестных команд
+   * @param handler Обработчик (передача владения)
+   */
+  void set_text(std::unique_ptr<IMessageHandler> handler) { text_ = std::move(handler); }
+
+  /**
+   * @brief Обработать сообщение
+   * @param sender Сокет-отправитель
+   * @param msg Сообщение с завершающим "\n"
+   * @return false, если это не команда и обработчик текста не задан или отказался
+   */
+  bool handle(std::shared_ptr<Socket> sender, const MessageRef &msg) override;
+
+  /// @brief Количество зарегистрированных команд
+  size_t size() const noexcept { return routes_.size(); }
+
+private:
+  /// Зарегистрированная команда
+  struct Route
+  {
+    std::string name; ///< Имя с '/'
+    Command command;  ///< Обработчик
+  };
+
+  std::vector<Route> routes_;             ///< Команды в порядке регистрации
+  std::vector<const Route *> table_;      ///< Ячейки совершенного хеша (nullptr — пусто)
+  uint64_t multiplier_ = 0;               ///< Множитель, при котором у имен нет коллизий
+  unsigned shift_ = 63;                   ///< 64 - log2(размер таблицы)
+  std::unique_ptr<IMessageHandler> text_; ///< Обработчик текста
+
+  /// @brief Добавить команду и перестроить таблицу
+  void add_command(std::string_view name, Command command);
+
+  /// @brief Ячейка имени при текущем множителе
+  size_t slot(std::string_view name) const noexcept;
+
+  /// @brief Подобрать множитель и размер таблицы без коллизий
+  void rebuild();
+};
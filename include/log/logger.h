@@ -0,0 +1,178 @@
+/**
+ * @file logger.h
+ * @brief Асинхронный журнал с кольцевыми буферами потоков
+ * @defgroup Logging Журнал сервера
+ */
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// Уровень важности записи журнала
+enum class LogLevel : uint8_t
+{
+  Debug, ///< Подробности для отладки (в том числе каждое входящее сообщение)
+  Info,  ///< Обычные события: запуск, подключения
+  Warn,  ///< Отклонения, не мешающие работе: таймауты, медленные клиенты
+  Error, ///< Ошибки
+  Off    ///< Журнал отключен (только как порог)
+};
+
+/**
+ * @class LogSampler
+ * @brief Прореживание частой записи: пропускает одну из every
+ *
+ * @details Заводится статическим объектом в месте вызова. Счетчик общий для
+ * всех потоков, но увеличивается только когда уровень записи включен, поэтому
+ * выключенная запись не стоит ничего.
+ */
+class LogSampler
+{
+public:
+  /// @param every Пропускать одну запись из every (0 и 1 — все)
+  explicit LogSampler(uint32_t every) noexcept : every_(every > 1 ? every : 1) {}
+
+  /// @brief true, если очередную запись нужно выводить
+  bool take() noexcept { return count_.fetch_add(1, std::memory_order_relaxed) % every_ == 0; }
+
+  /// @brief Делитель прореживания
+  uint32_t every() const noexcept { return every_; }
+
+private:
+  uint32_t every_;                   ///< Делитель
+  std::atomic<uint64_t> count_{0};   ///< Записей до прореживания
+};
+
+/**
+ * @class Log
+ * @brief Журнал процесса: запись без блокировок, вывод фоновым потоком
+ *
+ * @details Поток при первой записи получает собственное кольцо на kRecords
+ * записей фиксированного размера (один писатель, один читатель). Запись —
+ * проверка уровня, форматирование прямо в ячейку кольца и одна release-запись
+ * индекса: без мьютекса, без выделения памяти и без системных вызовов. Если
+ * кольцо заполнено, запись отбрасывается и учитывается в счетчике
+ * chat_log_dropped_total, писатель никогда не ждет. Фоновый поток раз в
+ * kFlushInterval забирает записи всех колец, упорядочивает их по времени и
+ * выводит одним write в дескриптор журнала (по умолчанию stderr); о
+ * потерянных записях он сообщает отдельной строкой.
+ *
+ * @threadsafe Все методы можно вызывать из любого потока
+ */
+class Log
+{
+public:
+  static constexpr size_t kRecords = 1024;     ///< Записей в кольце одного потока
+  static constexpr size_t kRecordSize = 256;   ///< Размер записи; длинный текст обрезается
+  static constexpr std::chrono::milliseconds kFlushInterval{20}; ///< Период вывода
+
+  /// @brief Задать порог: записи ниже него отбрасываются без форматирования
+  static void set_level(LogLevel level) noexcept { level_.store(level, std::memory_order_relaxed); }
+
+  /// @brief Текущий порог
+  static LogLevel level() noexcept { return level_.load(std::memory_order_relaxed); }
+
+  /// @brief true, если записи уровня level выводятся
+  static bool enabled(LogLevel level) noexcept { return level >= Log::level() && level != LogLevel::Off; }
+
+  /**
+   * @brief Разобрать имя уровня
+   * @param name debug, info, warn, error или off
+   * @param level Результат
+   * @return false, если имя неизвестно
+   */
+  static bool parse_level(const char *name, LogLevel &level) noexcept;
+
+  /// @brief Задать дескриптор вывода (например, открытый файл); не закрывается журналом
+  static void set_output(int fd) noexcept;
+
+  /**
+   * @brief Добавить запись в журнал
+   * @param level Уровень
+   * @param format Формат printf
+   */
+  static void write(LogLevel level, const char *format, ...) noexcept __attribute__((format(printf, 2, 3)));
+
+  /**
+   * @brief Добавить запись, если ее пропускает прореживание
+   * @param sampler Прореживание места вызова
+   * @param level Уровень
+   * @param format Формат printf
+   */
+  static void sampled(LogSampler &sampler, LogLevel level, const char *format, ...) noexcept __attribute__((format(printf, 3, 4)));
+
+  /// @brief Дождаться вывода всех записей, сделанных до вызова
+  static void flush();
+
+private:
+  /// Запись кольца
+  struct Record
+  {
+    uint64_t time_ns;     ///< Время записи (system_clock), нс
+    LogLevel level;       ///< Уровень
+    uint16_t length;      ///< Длина текста
+    char text[kRecordSize - sizeof(uint64_t) - sizeof(uint32_t)]; ///< Текст без перевода строки
+  };
+
+  /// Кольцо одного потока: пишет владелец, читает фоновый поток
+  struct ThreadRing
+  {
+    alignas(64) std::atomic<uint64_t> head{0};    ///< Следующая ячейка писателя
+    std::atomic<uint64_t> dropped{0};             ///< Отброшено записей (пишет только владелец)
+    uint64_t cached_tail = 0;                     ///< Последний прочитанный владельцем tail
+    alignas(64) std::atomic<uint64_t> tail{0};    ///< Следующая ячейка читателя
+    uint64_t dropped_seen = 0;                    ///< Сколько потерь уже выведено (только читатель)
+    size_t index = 0;                             ///< Номер потока в журнале
+    std::array<Record, kRecords> records;         ///< Ячейки
+  };
+
+  /// Кольца всех потоков и фоновый поток вывода
+  struct Registry
+  {
+    std::mutex mutex;                                  ///< Защищает rings, stop и passes
+    std::condition_variable wake;                      ///< Будит поток вывода
+    std::condition_variable done;                      ///< Сообщает о завершенном проходе
+    std::vector<std::unique_ptr<ThreadRing>> rings;    ///< Кольца потоков
+    std::atomic<int> fd{2};                            ///< Дескриптор вывода
+    bool stop = false;                                 ///< Завершение процесса
+    uint64_t passes = 0;                               ///< Выполнено проходов вывода
+    std::thread flusher;                               ///< Поток вывода
+
+    Registry();
+    ~Registry();
+  };
+
+  static std::atomic<LogLevel> level_; ///< Порог вывода
+
+  /// @brief Кольцо текущего потока
+  static ThreadRing &local() noexcept
+  {
+    thread_local ThreadRing *ring = attach();
+    return *ring;
+  }
+
+  /// @brief Реестр колец процесса
+  static Registry &registry();
+
+  /// @brief Выделить и зарегистрировать кольцо для нового потока
+  static ThreadRing *attach();
+
+  /// @brief Отформатировать запись в кольцо текущего потока
+  static void append(LogLevel level, const char *format, va_list args) noexcept;
+
+  /// @brief Тело фонового потока
+  static void run(Registry &reg);
+
+  /// @brief Забрать записи всех колец и вывести их; возвращает false, если выводить было нечего
+  static bool drain(Registry &reg, std::vector<Record> &batch, std::string &out);
+};
@@ -0,0 +1,92 @@
+/**
+ * @file block_pool.h
+ * @brief Пул блоков памяти по классам размеров с кэшем в каждом потоке
+ * @defgroup Memory Память
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+/**
+ * @class BlockPool
+ * @brief Выделение блоков до kMaxBlock байт без malloc в установившемся режиме
+ *
+ * @details Размер округляется вверх до одного из классов (шаг 16 байт до
+ * 128, дальше четыре класса на каждое удвоение). У каждого потока свой
+ * список свободных блоков каждого класса: выделение и освобождение — снятие
+ * и возврат в список без блокировок и атомарных операций.
+ *
+ * Блок может освобождаться не тем потоком, который его выделил (сообщение
+ * рассылки отпускает последний получатель). Поэтому списки потоков
+ * ограничены: лишние блоки уходят пачкой в общий список класса, а пустой
+ * список потока берет оттуда целую пачку — один мьютекс на пачку, а не на
+ * блок. Когда общий список пуст, из системы берется слаб в 64 КиБ и
+ * нарезается на блоки.
+ *
+ * Память слабов не возвращается системе: освобожденные блоки остаются в
+ * пуле, поэтому после прогрева сервер не обращается к malloc, а пиковый
+ * объем остается занятым. Блоки больше kMaxBlock выделяются напрямую
+ * (operator new) и учитываются в stats().
+ *
+ * @threadsafe Все методы можно вызывать из любого потока
+ */
+class BlockPool
+{
+public:
+  /// Наибольший размер блока из пула, байт
+  static constexpr size_t kMaxBlock = 16 * 1024;
+
+  /// Обращения пула к системе (ловушка подсчета аллокаций)
+  struct Stats
+  {
+    uint64_t slabs = 0;      ///< Выделено слабов
+    uint64_t slab_bytes = 0; ///< Память слабов, байт
+    uint64_t direct = 0;     ///< Блоков, выделенных мимо слабов (больше kMaxBlock или в завершающемся потоке)
+  };
+
+  /**
+   * @brief Выделить блок
+   * @param bytes Размер (0 допускается)
+   * @return Блок, выровненный на 16 байт
+   * @throws std::bad_alloc при нехватке памяти
+   */
+  static void *allocate(size_t bytes);
+
+  /**
+   * @brief Освободить блок
+   * @param block Блок из allocate() (nullptr допускается)
+   * @param bytes Тот же размер, что был передан в allocate()
+   */
+  static void deallocate(void *block, size_t bytes) noexcept;
+
+  /// @brief Счетчики обращений к системе
+  static Stats stats() noexcept;
+};
+
+/**
+ * @class PoolAllocator
+ * @brief Аллокатор STL поверх BlockPool (например, для std::allocate_shared)
+ */
+template <typename T>
+class PoolAllocator
+{
+public:
+  using value_type = T;
+
+  PoolAllocator() noexcept = default;
+
+  template <typename U>
+  PoolAllocator(const PoolAllocator<U> &) noexcept {}
+
+  T *allocate(size_t n) { return static_cast<T *>(BlockPool::allocate(n * sizeof(T))); }
+
+  void deallocate(T *block, size_t n) noexcept { BlockPool::deallocate(block, n * sizeof(T)); }
+
+  template <typename U>
+  bool operator==(const PoolAllocator<U> &) const noexcept { return true; }
+
+  template <typename U>
+  bool operator!=(const PoolAllocator<U> &) const noexcept { return false; }
+};
@@ -0,0 +1,89 @@
+/**
+ * @file histogram.h
+ * @brief Гистограмма длительностей с логарифмическими корзинами (в духе HDR Histogram)
+ * @ingroup Metrics
+ */
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @class Histogram
+ * @brief Гистограмма значений одного потока-писателя
+ *
+ * @details Значения меньше kSubBuckets хранятся точно; дальше каждая степень
+ * двойки делится на kSubBuckets равных корзин, поэтому относительная
+ * погрешность не больше 1/16 на всем диапазоне, а память постоянна.
+ * Запись — номер корзины через clz и увеличение трех счетчиков без
+ * lock-префикса (relaxed load + store): писатель у гистограммы один.
+ * Читатели из других потоков видят каждый счетчик согласованным, но не
+ * обязательно все одновременно.
+ */
+class Histogram
+{
+public:
+  static constexpr unsigned kSubBucketBits = 4;                  ///< log2 корзин на степень двойки
+  static constexpr unsigned kSubBuckets = 1u << kSubBucketBits;  ///< Корзин на степень двойки
+  static constexpr unsigned kMaxValueBits = 40;                  ///< Значения от 2^40 попадают в последнюю корзину
+  static constexpr size_t kBuckets = (kMaxValueBits - kSubBucketBits + 1) * kSubBuckets; ///< Всего корзин
+
+  /// Копия гистограммы (сумма по потокам)
+  struct Snapshot
+  {
+    std::array<uint64_t, kBuckets> buckets{}; ///< Количество значений по корзинам
+    uint64_t count = 0;                       ///< Всего значений
+    uint64_t sum = 0;                         ///< Сумма значений
+
+    /**
+     * @brief Оценка квантиля
+     * @param q Квантиль от 0 до 1
+     * @return Верхняя граница корзины, в которую попал квантиль (0 для пустой гистограммы)
+     */
+    uint64_t quantile(double q) const noexcept;
+  };
+
+  /// @brief Номер корзины для значения
+  static size_t bucket_of(uint64_t value) noexcept
+  {
+    if (value < kSubBuckets)
+      return static_cast<size_t>(value);
+    unsigned msb = 63u - static_cast<unsigned>(__builtin_clzll(value));
+    if (msb >= kMaxValueBits)
+      return kBuckets - 1;
+    unsigned shift = msb - kSubBucketBits;
+    return (shift + 1) * kSubBuckets + static_cast<size_t>((value >> shift) & (kSubBuckets - 1));
+  }
+
+  /// @brief Наименьшее значение, попадающее в корзину
+  static uint64_t bucket_floor(size_t bucket) noexcept
+  {
+    if (bucket < kSubBuckets)
+      return bucket;
+    size_t shift = bucket / kSubBuckets - 1;
+    return (static_cast<uint64_t>(kSubBuckets) + bucket % kSubBuckets) << shift;
+  }
+
+  /// @brief Записать значение (только из потока-владельца)
+  void record(uint64_t value) noexcept
+  {
+    bump(buckets_[bucket_of(value)], 1);
+    bump(count_, 1);
+    bump(sum_, value);
+  }
+
+  /// @brief Добавить содержимое к копии
+  void merge_into(Snapshot &out) const noexcept;
+
+private:
+  static void bump(std::atomic<uint64_t> &cell, uint64_t n) noexcept
+  {
+    cell.store(cell.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  std::array<std::atomic<uint64_t>, kBuckets> buckets_{}; ///< Счетчики корзин
+  std::atomic<uint64_t> count_{0};                         ///< Всего значений
+  std::atomic<uint64_t> sum_{0};                           ///< Сумма значений
+};
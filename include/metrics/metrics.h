@@ -0,0 +1,175 @@
+/**
+ * @file metrics.h
+ * @brief Счетчики и гистограммы конвейера сообщений
+ * @defgroup Metrics Метрики сервера
+ */
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../include/metrics/histogram.h"
+
+/// Счетчики конвейера сообщений
+enum class Counter : size_t
+{
+  Accepts,           ///< Принято подключений
+  Rejects,           ///< Отклонено подключений сверх лимита
+  AcceptRateLimited, ///< Сброшено подключений сверх общей частоты
+  SourceRateLimited, ///< Сброшено подключений сверх частоты одного адреса
+  Disconnects,       ///< Закрыто подключений
+  BytesIn,           ///< Прочитано байт из сокетов
+  BytesOut,          ///< Записано байт в сокеты
+  MessagesFramed,    ///< Разобрано входящих сообщений
+  Deliveries,        ///< Поставлено сообщений в очереди получателей
+  DirectMessages,    ///< Отправлено личных сообщений (/msg)
+  SendErrors,        ///< Ошибок записи в сокет
+  DroppedMessages,   ///< Отброшено сообщений медленным клиентам
+  DroppedBytes,      ///< Отброшено байт медленным клиентам
+  SlowDisconnects,   ///< Отключено медленных клиентов
+  Timeouts,          ///< Отключено по сроку (рукопожатие, простой, ping)
+  LogDropped,        ///< Отброшено записей журнала при заполненном кольце
+  StoreAppends,      ///< Поставлено сообщений в журнал сообщений на диске
+  StoreDropped,      ///< Отброшено сообщений при переполненной очереди записи
+  StoreCommits,      ///< Групповых фиксаций (fdatasync)
+  StoreBytes,        ///< Записано байт в сегменты
+  StoreErrors,       ///< Неудачных попыток записи пачки (каждый повтор считается)
+  ClusterSent,       ///< Отправлено сообщений другим узлам (по одному на узел)
+  ClusterReceived,   ///< Принято сообщений от других узлов
+  ClusterRepeats,    ///< Отброшено повторов и собственных сообщений, вернувшихся от узлов
+  ClusterLost,       ///< Пропущено номеров в последовательностях источников
+  ClusterDropped,    ///< Не отправлено узлам: нет подключения или переполнена очередь
+  ClusterRejected,   ///< Отклонено входящих подключений: адрес не из списка узлов или неверный секрет
+  Count
+};
+
+/// Измеряемые длительности
+enum class Latency : size_t
+{
+  Delivery,    ///< От чтения сообщения до постановки в очередь последнему подписчику (во всех шардах)
+  Handler,     ///< Выполнение цепочки обработчиков для одного сообщения
+  StoreCommit, ///< Запись и fdatasync одной пачки журнала сообщений
+  Cluster,     ///< От публикации на узле-источнике до приема другим узлом
+  Count
+};
+
+/**
+ * @class Metrics
+ * @brief Метрики процесса: у каждого потока свой набор счетчиков
+ *
+ * @details Поток при первой записи получает собственный слот (выравнен по
+ * кэш-линии) и дальше пишет только в него: без блокировок, без атомарных
+ * read-modify-write и без разделения кэш-линий между потоками. Запись
+ * счетчика — обращение к thread_local и пара relaxed load/store; запись
+ * длительности — еще номер корзины гистограммы. snapshot() суммирует слоты
+ * всех потоков (в том числе завершившихся) и выполняется только при чтении
+ * метрик. Значения выводятся в текстовом формате Prometheus.
+ *
+ * @threadsafe Все методы можно вызывать из любого потока
+ */
+class Metrics
+{
+public:
+  /// Копия метрик, просуммированная по потокам
+  struct Snapshot
+  {
+    std::array<uint64_t, static_cast<size_t>(Counter::Count)> counters{};           ///< Значения счетчиков
+    std::array<Histogram::Snapshot, static_cast<size_t>(Latency::Count)> latencies; ///< Гистограммы, нс
+
+    uint64_t operator[](Counter counter) const noexcept { return counters[static_cast<size_t>(counter)]; }
+    const Histogram::Snapshot &operator[](Latency latency) const noexcept { return latencies[static_cast<size_t>(latency)]; }
+  };
+
+  /**
+   * @brief Увеличить счетчик текущего потока
+   * @param counter Счетчик
+   * @param n Величина увеличения
+   */
+  static void add(Counter counter, uint64_t n = 1) noexcept
+  {
+    auto &cell = local().counters[static_cast<size_t>(counter)];
+    cell.store(cell.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Записать длительность в гистограмму текущего потока
+   * @param latency Гистограмма
+   * @param ns Длительность, нс
+   */
+  static void record(Latency latency, uint64_t ns) noexcept
+  {
+    local().latencies[static_cast<size_t>(latency)].record(ns);
+  }
+
+  /// @brief Монотонное время в наносекундах (для отметок, передаваемых между потоками)
+  static uint64_t now_ns() noexcept
+  {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch())
+                                     .count());
+  }
+
+  /// @brief Сумма метрик всех потоков
+  static Snapshot snapshot();
+
+  /**
+   * @brief Дописать метрики в текстовом формате Prometheus
+   * @param out Строка-приемник
+   * @param snapshot Метрики
+   * @details Счетчики выводятся как counter, длительности — как summary
+   * (квантили 0.5, 0.9, 0.99, 0.999) в секундах
+   */
+  static void write_prometheus(std::string &out, const Snapshot &snapshot);
+
+  /**
+   * @brief Дописать одно значение типа gauge в формате Prometheus
+   * @param out Строка-приемник
+   * @param name Имя метрики
+   * @param help Описание
+   * @param value Значение
+   */
+  static void write_gauge(std::string &out, const char *name, const char *help, double value);
+
+  /**
+   * @brief Дописать внешний счетчик (counter) в формате Prometheus
+   * @param out Строка-приемник
+   * @param name Имя метрики
+   * @param help Описание
+   * @param value Значение
+   */
+  static void write_counter(std::string &out, const char *name, const char *help, uint64_t value);
+
+private:
+  /// Метрики одного потока
+  struct alignas(64) ThreadSlot
+  {
+    std::array<std::atomic<uint64_t>, static_cast<size_t>(Counter::Count)> counters{}; ///< Счетчики
+    std::array<Histogram, static_cast<size_t>(Latency::Count)> latencies;              ///< Гистограммы
+  };
+
+  /// @brief Слот текущего потока
+  static ThreadSlot &local() noexcept
+  {
+    thread_local ThreadSlot *slot = attach();
+    return *slot;
+  }
+
+  /// Слоты всех потоков; не освобождаются, чтобы итоги завершившихся потоков сохранялись
+  struct Registry
+  {
+    std::mutex mutex;                               ///< Защищает slots
+    std::vector<std::unique_ptr<ThreadSlot>> slots; ///< Слоты потоков
+  };
+
+  /// @brief Реестр слотов процесса
+  static Registry &registry();
+
+  /// @brief Выделить и зарегистрировать слот для нового потока
+  static ThreadSlot *attach();
+};
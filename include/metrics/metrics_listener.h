@@ -0,0 +1,76 @@
+/**
+ * @file metrics_listener.h
+ * @brief HTTP-выдача метрик для Prometheus
+ * @ingroup Metrics
+ */
+
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include "../include/net/socket.h"
+#include "../include/net/reactor/event_loop.h"
+
+/**
+ * @class MetricsListener
+ * @brief Минимальный HTTP/1.0 сервер, отдающий метрики на любой GET
+ *
+ * @details Слушает отдельный порт в цикле событий одного из шардов.
+ * Запрос читается до пустой строки, ответ (text/plain, формат Prometheus)
+ * пишется целиком, после чего подключение закрывается. Рассчитан на редкие
+ * опросы скрейпера, а не на нагрузку: незавершенные запросы больше 8 КиБ
+ * отбрасываются.
+ *
+ * @warning Создается и разрушается, пока цикл событий не запущен или уже остановлен
+ */
+class MetricsListener
+{
+public:
+  /// Формирует тело ответа
+  using Source = std::function<std::string()>;
+
+  /**
+   * @brief Конструктор: открывает слушающий сокет и регистрирует его в цикле
+   * @param loop Цикл событий, в котором обслуживаются запросы
+   * @param domain Семейство адресов (AF_INET или AF_INET6)
+   * @param ip Адрес
+   * @param port Порт
+   * @param source Источник текста метрик (вызывается в потоке цикла)
+   * @throws runtime_error При ошибке bind/listen
+   */
+  MetricsListener(EventLoop &loop, int domain, const std::string &ip, int port, Source source);
+
+  /// @brief Снимает сокеты с цикла и закрывает их
+  ~MetricsListener();
+
+  MetricsListener(const MetricsListener &) = delete;
+  MetricsListener &operator=(const MetricsListener &) = delete;
+
+private:
+  /// Подключение скрейпера
+  struct Peer
+  {
+    Socket socket;       ///< Сокет подключения
+    std::string request; ///< Прочитанная часть запроса
+    std::string reply;   ///< Неотправленная часть ответа
+  };
+
+  EventLoop &loop_;                                      ///< Цикл событий
+  Socket listener_;                                      ///< Слушающий сокет
+  Source source_;                                        ///< Источник метрик
+  std::unordered_map<int, std::unique_ptr<Peer>> peers_; ///< Открытые подключения
+
+  /// @brief Принять ожидающие подключения
+  void accept();
+
+  /**
+   * @brief Обработать событие подключения
+   * @param fd Дескриптор подключения
+   * @param events События epoll
+   */
+  void serve(int fd, uint32_t events);
+
+  /// @brief Снять подключение с цикла и закрыть
+  void drop(int fd);
+};
@@ -0,0 +1,139 @@
+/**
+ * @file accept_limiter.h
+ * @brief Ограничение частоты новых подключений (общее и по адресу источника)
+ * @ingroup ServerCore
+ */
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <sys/socket.h>
+#include "../include/memory/block_pool.h"
+
+/**
+ * @class AcceptLimiter
+ * @brief Два уровня ведер токенов: одно на сервер и по одному на IP-адрес клиента
+ *
+ * @details Ведро хранится как GCRA: одно число — время, к которому ведро
+ * снова станет полным. Подключение проходит, если это время отстоит от
+ * текущего не больше чем на запас ведра, и сдвигает его на интервал между
+ * токенами. Общее ведро — одно атомарное слово (CAS без блокировок), его
+ * делят все шарды.
+ *
+ * Ведра адресов лежат в таблицах, разбитых на kStripes полос с мьютексом у
+ * каждой: подключения одного адреса попадают в разные шарды (SO_REUSEPORT
+ * хеширует и порт клиента), поэтому таблица общая. Полное ведро
+ * неотличимо от отсутствующего, так что заполненная полоса просто
+ * выбрасывает такие записи (не чаще, чем наполняется самое старое ведро
+ * полосы); если и это не помогло, новый адрес пропускается без учета —
+ * его по-прежнему ограничивает общее ведро.
+ *
+ * Сначала проверяется ведро адреса: поток подключений с одного адреса
+ * отсекается, не расходуя общие токены.
+ *
+ * @threadsafe admit() можно вызывать из любого потока
+ */
+class AcceptLimiter
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /// Количество полос таблицы адресов
+  static constexpr size_t kStripes = 64;
+
+  /// Параметры ведра
+  struct Rate
+  {
+    double per_second = 0; ///< Токенов в секунду; 0 — без ограничения
+    size_t burst = 0;      ///< Емкость ведра; 0 — скорость за одну секунду
+  };
+
+  /// Решение о новом подключении
+  enum class Verdict
+  {
+    Accept,      ///< Подключение принимается
+    GlobalLimit, ///< Исчерпано общее ведро
+    SourceLimit  ///< Исчерпано ведро адреса клиента
+  };
+
+  /**
+   * @brief Конструктор
+   * @param global Общее ограничение
+   * @param per_source Ограничение для одного IP-адреса
+   * @param max_sources Наибольшее число адресов в таблице
+   */
+  AcceptLimiter(Rate global, Rate per_source, size_t max_sources);
+
+  AcceptLimiter(const AcceptLimiter &) = delete;
+  AcceptLimiter &operator=(const AcceptLimiter &) = delete;
+
+  /// @brief true, если задано хотя бы одно ограничение
+  bool enabled() const noexcept { return global_.enabled() || source_.enabled(); }
+
+  /**
+   * @brief Учесть новое подключение
+   * @param peer Адрес клиента (не IPv4/IPv6 — только общее ведро)
+   * @param now Текущее время
+   * @return Принять подключение или причина отказа
+   */
+  Verdict admit(const sockaddr *peer, Clock::time_point now) noexcept;
+
+  /// @brief Адресов в таблице (включая уже полные ведра)
+  size_t sources() const noexcept;
+
+private:
+  /// Интервал и допуск GCRA в наносекундах
+  struct Bucket
+  {
+    int64_t interval = 0;  ///< Время на один токен; 0 — ограничения нет
+    int64_t tolerance = 0; ///< Запас ведра сверх одного токена
+
+    Bucket() = default;
+    explicit Bucket(Rate rate);
+
+    bool enabled() const noexcept { return interval > 0; }
+
+    /// Новое время полного ведра или -1, если токенов нет
+    int64_t take(int64_t tat, int64_t now) const noexcept;
+  };
+
+  /// IPv6-адрес; IPv4 хранится как ::ffff:a.b.c.d
+  struct SourceKey
+  {
+    uint64_t hi = 0;
+    uint64_t lo = 0;
+
+    bool operator==(const SourceKey &other) const noexcept { return hi == other.hi && lo == other.lo; }
+  };
+
+  struct SourceHash
+  {
+    size_t operator()(const SourceKey &key) const noexcept;
+  };
+
+  using SourceMap = std::unordered_map<SourceKey, int64_t, SourceHash, std::equal_to<SourceKey>,
+                                       PoolAllocator<std::pair<const SourceKey, int64_t>>>;
+
+  /// Полоса таблицы адресов
+  struct Stripe
+  {
+    std::mutex mutex;     ///< Защищает tats и sweep_at
+    SourceMap tats;       ///< Адрес -> время полного ведра
+    int64_t sweep_at = 0; ///< Раньше этого времени ни одно ведро полосы не наполнится
+  };
+
+  Bucket global_;                       ///< Общее ведро
+  Bucket source_;                       ///< Ведро одного адреса
+  size_t stripe_limit_;                 ///< Адресов в одной полосе
+  std::atomic<int64_t> global_tat_{0};  ///< Время полного общего ведра
+  std::unique_ptr<Stripe[]> stripes_;   ///< Полосы таблицы адресов (только при source_.enabled())
+
+  bool admit_source(const SourceKey &key, int64_t now) noexcept;
+  bool admit_global(int64_t now) noexcept;
+};
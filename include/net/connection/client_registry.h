@@ -0,0 +1,78 @@
+/**
+ * @file client_registry.h
+ * @brief Реестр подключений одного шарда
+ * @ingroup ServerCore
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "../include/net/connection/connection.h"
+
+/**
+ * @class ClientRegistry
+ * @brief Подключения шарда в плотном массиве с прямым индексом по дескриптору
+ *
+ * @details Реестр принадлежит потоку шарда: добавление, удаление и обход
+ * выполняются только им, поэтому обход при рассылке не берет блокировок и
+ * не конкурирует с подключениями и отключениями. Удаление — перестановка
+ * с последним элементом, O(1); обход идет по непрерывному массиву. Поиск по
+ * дескриптору — обращение к массиву позиций, индексируемому самим дескриптором
+ * (дескрипторы процесса плотные и переиспользуются ядром).
+ * Другие потоки обходят подключения через очередь задач шарда
+ * (connectionManager::for_each_client), а число подключений читают без блокировок.
+ *
+ * @warning Кроме size(), методы вызываются только из потока шарда
+ */
+class ClientRegistry
+{
+public:
+  /**
+   * @brief Добавить подключение
+   * @param client Подключение (дескриптор не должен быть занят)
+   */
+  void add(std::shared_ptr<Connection> client);
+
+  /**
+   * @brief Удалить подключение по дескриптору
+   * @param fd Дескриптор
+   * @return true, если подключение было в реестре
+   */
+  bool remove(int fd);
+
+  /**
+   * @brief Найти подключение
+   * @param fd Дескриптор
+   * @return Подключение или пустой указатель (ссылка действительна до изменения реестра)
+   */
+  const std::shared_ptr<Connection> &find(int fd) const noexcept;
+
+  /**
+   * @brief Обойти подключения
+   * @param fn Вызывается для каждого подключения; не должен изменять реестр
+   */
+  template <typename Fn>
+  void for_each(Fn &&fn) const
+  {
+    for (const auto &client : clients_)
+    {
+      fn(client);
+    }
+  }
+
+  /// @brief Удалить все подключения
+  void clear();
+
+  /// @brief Количество подключений (можно читать из любого потока)
+  size_t size() const noexcept { return count_.load(std::memory_order_relaxed); }
+
+private:
+  static constexpr uint32_t kNoSlot = UINT32_MAX; ///< Дескриптор не в реестре
+
+  std::vector<std::shared_ptr<Connection>> clients_; ///< Подключения подряд
+  std::vector<uint32_t> slots_;                      ///< Позиция в clients_ по дескриптору
+  std::atomic<size_t> count_{0};                     ///< Копия clients_.size() для других потоков
+};
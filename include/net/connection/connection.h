@@ -0,0 +1,289 @@
+/**
+ * @file connection.h
+ * @brief Состояние отдельного клиентского подключения
+ * @ingroup ServerCore
+ */
+
+#pragma once
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <sys/uio.h>
+#include "../include/net/connection/framer.h"
+#include "../include/net/connection/message_buffer.h"
+#include "../include/net/connection/message_queue.h"
+#include "../include/net/reactor/timer_wheel.h"
+#include "../include/net/socket.h"
+
+/**
+ * @class Connection
+ * @brief Неблокирующее подключение клиента и его буферы чтения/записи
+ *
+ * @details Хранит:
+ * - Сокет клиента (тот же shared_ptr получают обработчики сообщений)
+ * - Кольцевой буфер приема с разбором сообщений (Framer) и протокол подключения
+ * - Подписки на комнаты и текущую комнату, куда уходят сообщения клиента
+ * - Очередь исходящих сообщений; постановка в нее не делает системных вызовов,
+ *   очередь дописывается в сокет асинхронно одним sendmsg на несколько сообщений,
+ *   с учетом частичной записи
+ * - Таймер сроков (рукопожатие, простой, ping) и время последних входящих данных
+ *
+ * @warning Не потокобезопасен: используется только потоком цикла событий
+ */
+class Connection
+{
+public:
+  /// Неизменяемое сообщение, разделяемое между очередями получателей
+  using Payload = MessageRef;
+
+  /// Максимум сообщений, записываемых одним системным вызовом
+  static constexpr size_t kMaxIov = 64;
+
+  /// Подписка на комнату
+  struct Subscription
+  {
+    MessageRef room;   ///< Имя комнаты, общее для шарда (RoomIndex::join())
+    uint32_t slot = 0; ///< Позиция подключения среди подписчиков комнаты в RoomIndex
+  };
+
+  /**
+   * @brief Конструктор
+   * @param socket Сокет принятого подключения (в неблокирующем режиме)
+   * @param max_frame_size Максимальная длина входящего сообщения
+   */
+  Connection(std::shared_ptr<Socket> socket, size_t max_frame_size);
+
+  /// @brief Сокет клиента
+  const std::shared_ptr<Socket> &socket() const noexcept { return socket_; }
+
+  /// @brief Дескриптор сокета
+  int fd() const noexcept { return socket_->fd(); }
+
+  /// @brief Буфер приема и разбор сообщений
+  Framer &framer() noexcept { return framer_; }
+
+  /// @brief Протокол подключения
+  Protocol protocol() const noexcept { return framer_.protocol(); }
+
+  /// @brief Текущая комната (пустая ссылка, если подписок нет)
+  const MessageRef &room() const noexcept { return room_; }
+
+  /// @brief Никнейм (пусто — не задан)
+  const std::string &nick() const noexcept { return nick_; }
+
+  /// @brief Метка владения никнеймом в NameIndex (0 — еще не выдана)
+  uint64_t nick_token() const noexcept { return nick_token_; }
+
+  /**
+   * @brief Запомнить никнейм
+   * @param nick Имя, уже занятое в NameIndex
+   * @param token Метка владения
+   */
+  void set_nick(std::string_view nick, uint64_t token)
+  {
+    nick_.assign(nick);
+    nick_token_ = token;
+  }
+
+  /// @brief Номер истории шарда при последней подписке: более ранние сообщения еще не выданы
+  uint64_t history_mark() const noexcept { return history_mark_; }
+
+  /// @brief Запомнить номер истории шарда при подписке (RoomHistory::sequence())
+  void set_history_mark(uint64_t mark) noexcept { history_mark_ = mark; }
+
+  /// @brief Все комнаты, на которые подписан клиент
+  const std::vector<Subscription> &rooms() const noexcept { return rooms_; }
+
+  /**
+   * @brief Сделать текущей комнату, на которую клиент уже подписан
+   * @param room Имя комнаты
+   * @return false, если подписки нет
+   */
+  bool select_room(std::string_view room) noexcept;
+
+  /**
+   * @brief Запомнить новую подписку и сделать комнату текущей
+   * @param room Имя комнаты из RoomIndex::join()
+   * @param slot Позиция в комнате из RoomIndex::join()
+   * @pre Подписки на эту комнату еще нет (см. select_room())
+   */
+  void subscribe(MessageRef room, uint32_t slot);
+
+  /**
+   * @brief Забыть подписку
+   * @param room Имя комнаты
+   * @param removed Сюда переносится удаленная подписка (для RoomIndex::leave())
+   * @return false, если подписки не было
+   * @note Если комната была текущей, текущей становится последняя из оставшихся
+   */
+  bool unsubscribe(std::string_view room, Subscription &removed);
+
+  /**
+   * @brief Обновить позицию в комнате после перестановки в RoomIndex::leave()
+   * @param room Имя комнаты (сравнивается по адресу: имена интернированы)
+   * @param slot Новая позиция
+   */
+  void set_slot(const MessageBuffer *room, uint32_t slot) noexcept;
+
+  /**
+   * @brief Поставить сообщение в очередь отправки
+   * @param data Сообщение
+   * @note Реальная запись выполняется позже (flush() или io_uring)
+   */
+  void enqueue(Payload data);
+
+  /**
+   * @brief Заполнить вектор ввода-вывода неотправленными данными очереди
+   * @param iov Массив для заполнения
+   * @param max Размер массива
+   * @return Количество заполненных элементов (0, если очередь пуста)
+   * @note Буферы остаются действительными до consume() соответствующих байт
+   */
+  size_t gather(iovec *iov, size_t max) const noexcept;
+
+  /**
+   * @brief Учесть отправленные байты
+   * @param bytes Количество байт, принятых ядром
+   * @note Полностью отправленные сообщения удаляются из очереди
+   */
+  void consume(size_t bytes);
+
+  /**
+   * @brief Записать очередь в сокет сколько позволяет ядро
+   * @return false при фатальной ошибке записи (подключение нужно закрыть)
+   */
+  bool flush();
+
+  /// @brief true, если в очереди остались неотправленные данные
+  bool has_pending_output() const noexcept { return !outbound_.empty(); }
+
+  /// @brief Количество неотправленных байт
+  size_t pending_bytes() const noexcept { return pending_bytes_; }
+
+  /**
+   * @brief Отметить первые сообщения очереди как переданные ядру
+   * @param count Количество сообщений в асинхронной отправке (0 — отправка завершена)
+   * @note Такие сообщения не отбрасываются drop_oldest()
+   */
+  void set_in_flight(size_t count) noexcept { in_flight_ = count; }
+
+  /**
+   * @brief Отбросить самые старые сообщения, чтобы очередь уменьшилась до target байт
+   * @param target Желаемый размер очереди
+   * @param bytes [out] Сколько байт отброшено
+   * @return Количество отброшенных сообщений
+   * @note Частично отправленное и переданные ядру сообщения не трогаются
+   */
+  size_t drop_oldest(size_t target, size_t &bytes);
+
+  /// @brief true, если очередь превысила верхний порог и еще не опустилась ниже нижнего
+  bool congested() const noexcept { return congested_; }
+
+  /// @brief Когда очередь превысила верхний порог
+  std::chrono::steady_clock::time_point congested_since() const noexcept { return congested_since_; }
+
+  /**
+   * @brief Изменить состояние перегрузки
+   * @param congested Новое состояние
+   * @param now Текущее время (запоминается при входе в перегрузку)
+   */
+  void set_congested(bool congested, std::chrono::steady_clock::time_point now) noexcept
+  {
+    if (congested && !congested_)
+      congested_since_ = now;
+    congested_ = congested;
+  }
+
+  /// @brief Закрыть подключение, как только очередь отправки опустеет
+  void close_after_flush() noexcept { close_after_flush_ = true; }
+
+  /// @brief true, если подключение ожидает закрытия
+  bool closing() const noexcept { return close_after_flush_; }
+
+  /// @brief Больше не разбирать входящие сообщения (клиент запросил отключение)
+  void stop_reading() noexcept { reading_stopped_ = true; }
+
+  /// @brief true, если входящие сообщения больше не разбираются
+  bool reading_stopped() const noexcept { return reading_stopped_ || close_after_flush_; }
+
+  /**
+   * @brief Отметить, что подключение стоит в списке на запись
+   * @return true, если отметка поставлена сейчас (раньше ее не было)
+   */
+  bool schedule_flush() noexcept { return !std::exchange(flush_scheduled_, true); }
+
+  /// @brief Снять отметку о постановке в список на запись
+  void clear_flush_scheduled() noexcept { flush_scheduled_ = false; }
+
+  /// @brief true, если подключение стоит в списке на запись
+  bool flush_scheduled() const noexcept { return flush_scheduled_; }
+
+  /// @brief Когда очередь последний раз писалась из списка на запись
+  std::chrono::steady_clock::time_point last_flush() const noexcept { return last_flush_; }
+
+  /// @brief Запомнить время записи из списка на запись
+  void set_last_flush(std::chrono::steady_clock::time_point when) noexcept { last_flush_ = when; }
+
+  /// @brief Таймер сроков подключения (в колесе шарда)
+  Timer &timer() noexcept { return timer_; }
+
+  /// @brief Когда от клиента последний раз приходили данные (или когда он подключился)
+  std::chrono::steady_clock::time_point last_active() const noexcept { return last_active_; }
+
+  /**
+   * @brief Отметить входящие данные
+   * @param now Текущее время
+   * @details Таймер не перевзводится: срок простоя проверяется при его срабатывании
+   */
+  void touch(std::chrono::steady_clock::time_point now) noexcept
+  {
+    last_active_ = now;
+    ping_sent_ = false;
+  }
+
+  /// @brief Отметить первый полностью принятый кадр
+  void mark_framed() noexcept { framed_ = true; }
+
+  /**
+   * @brief true, пока идет бинарное рукопожатие
+   * @details Клиент прислал байт бинарного режима и начало кадра, но еще ни
+   * одного кадра целиком. Текстовый клиент (в том числе молчащий) и бинарный,
+   * еще ничего не присылавший после байта режима, рукопожатия не ведут.
+   */
+  bool handshake_pending() const noexcept
+  {
+    return !framed_ && framer_.protocol() == Protocol::Binary && framer_.buffered() > 0;
+  }
+
+  /// @brief true, если после последних входящих данных клиенту отправлен ping
+  bool ping_sent() const noexcept { return ping_sent_; }
+
+  /// @brief Отметить отправку ping
+  void set_ping_sent() noexcept { ping_sent_ = true; }
+
+private:
+  std::shared_ptr<Socket> socket_; ///< Сокет клиента
+  Framer framer_;                  ///< Буфер приема
+  std::vector<Subscription> rooms_; ///< Подписки на комнаты
+  MessageRef room_;                 ///< Текущая комната
+  std::string nick_;               ///< Никнейм
+  uint64_t nick_token_ = 0;        ///< Метка владения никнеймом
+  uint64_t history_mark_ = 0;      ///< Граница выдачи истории (см. history_mark())
+  MessageQueue outbound_;          ///< Очередь исходящих сообщений
+  size_t front_offset_ = 0;        ///< Сколько байт из outbound_.front() уже отправлено
+  size_t pending_bytes_ = 0;       ///< Неотправленные байты во всей очереди
+  size_t in_flight_ = 0;           ///< Сообщений в асинхронной отправке (io_uring)
+  bool congested_ = false;         ///< Очередь выше верхнего порога
+  std::chrono::steady_clock::time_point congested_since_; ///< Начало перегрузки
+  bool close_after_flush_ = false; ///< Закрыть после отправки очереди
+  bool flush_scheduled_ = false;   ///< Подключение уже в списке на запись
+  bool reading_stopped_ = false;   ///< Входящие сообщения игнорируются
+  std::chrono::steady_clock::time_point last_flush_; ///< Последняя запись из списка на запись
+  std::chrono::steady_clock::time_point last_active_; ///< Последние входящие данные
+  bool ping_sent_ = false;         ///< Ping отправлен и еще не получено ответа
+  bool framed_ = false;            ///< Принят хотя бы один кадр целиком
+  Timer timer_;                    ///< Таймер сроков подключения
+};
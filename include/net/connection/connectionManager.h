@@ -1,45 +1,88 @@
 /**
  * @file connectionManager.h
- * @brief Реализация менеджера подключений (thread-per-connection)
+ * @brief Реализация менеджера подключений (циклы событий epoll, по одному на ядро)
  * @ingroup ServerCore
  */
 
 #pragma once
 #include <vector>
 #include <thread>
-#include <mutex>
 #include <memory>
 #include <atomic>
+#include <functional>
 #include "../include/net/socket.h"
+#include "../include/net/connection/accept_limiter.h"
+#include "../include/net/connection/client_registry.h"
+#include "../include/net/connection/connection.h"
+#include "../include/net/connection/name_index.h"
+#include "../include/net/connection/room_history.h"
+#include "../include/net/connection/room_index.h"
+#include "../include/net/reactor/event_loop.h"
+#include "../include/net/reactor/io_backend.h"
+#include "../include/net/reactor/timer_wheel.h"
+#include "serverConfig.h"
 #include "IConnectionManager.h"
 #include "../include/handler/Messages/interface/imessage_handler.h"
+#include "../include/handler/Messages/pool/handler_pool.h"
+#include "../include/metrics/metrics_listener.h"
+#include "../include/storage/message_log.h"
+#include "../include/cluster/cluster_bridge.h"
 
 /**
  * @class connectionManager
  * @brief Реализация менеджера подключений
  *
  * @details Особенности:
- * - Принимает новые подключения в отдельном потоке
- * - Для каждого клиента создает отдельный поток обработки
- * - Использует Chain of Responsibility для обработки сообщений
+ * - Все сокеты неблокирующие и обслуживаются потоками циклов событий
+ *   (edge-triggered epoll), без отдельного потока на клиента
+ * - Сервер делится на шарды: у каждого свой слушающий сокет (SO_REUSEPORT),
+ *   свой цикл событий и свои подключения, ядро само распределяет accept
+ * - Состояние чтения/записи каждого клиента хранится в Connection
+ * - Чтение и запись выполняет IIoBackend шарда (epoll или io_uring)
+ * - Сообщения рассылаются подписчикам текущей комнаты отправителя; каждый шард
+ *   хранит индекс комнат своих подключений, в чужие шарды рассылка доставляется
+ *   через их очереди задач
+ * - Очередь отправки каждого клиента ограничена порогами (high/low water mark),
+ *   медленные клиенты обрабатываются по SlowConsumerPolicy
+ * - Никнеймы всех шардов — в общем NameIndex (поиск без блокировок):
+ *   личное сообщение — один поиск и одна постановка в очередь получателя
+ *   в потоке его шарда, без обхода подключений
+ * - Каждый шард хранит историю последних сообщений комнат (RoomHistory):
+ *   подписавшийся получает ее сразу после подтверждения /join, новый клиент —
+ *   историю комнаты по умолчанию, как только станет известен его протокол
+ * - Если задан ServerConfig::store_dir_, каждое разосланное сообщение
+ *   сохраняется в MessageLog (запись и fdatasync — в отдельном потоке)
+ * - Если задан ServerConfig::cluster_port_, рассылки своих клиентов
+ *   пересылаются другим узлам кластера (ClusterBridge), а их рассылки
+ *   доставляются своим клиентам как рассылки без отправителя
+ * - Слушающий сокет каждый раз вычерпывается до EAGAIN (accept4 сразу с
+ *   SOCK_NONBLOCK | SOCK_CLOEXEC); частоту новых подключений ограничивают
+ *   ведра токенов AcceptLimiter — общее и по IP-адресу, отказ — RST без
+ *   регистрации подключения
+ * - Сроки подключений (рукопожатие, простой, ping, отключение медленного
+ *   клиента) обслуживает колесо таймеров шарда: по одному таймеру на клиента;
+ *   полуоткрытые подключения находит TCP keepalive (ServerConfig::keepalive_idle_),
+ *   а не таймер простоя: текстовый клиент вправе только читать
+ * - Сообщения обрабатывает IMessageHandler (CommandRouter или цепочка
+ *   ChainedHandler); обработчик выполняется либо в потоке шарда, либо в HandlerPool (ServerConfig::handler_threads_).
+ *   Во втором случае методы, работающие с клиентом (broadcast, join, leave,
+ *   current_room, reply), выполняются в потоке его шарда через очередь задач
  *
- * @warning Деструктор останавливает все рабочие потоки
+ * @warning Деструктор останавливает потоки циклов событий
  * @threadsafe Все публичные методы потокобезопасны
  */
 class connectionManager : public IConnectionManager
 {
 public:
-  /// Тип контейнера для хранения клиентов
-  using ClientsContainer = std::vector<std::shared_ptr<Socket>>;
-
   /**
    * @brief Конструктор
    * @param domain Домен (AF_INET/AF_INET6)
    * @param type Тип сокета (SOCK_STREAM/SOCK_DGRAM)
    * @param protocol Протокол (0 для авто)
    * @param handler Обработчик сообщений (передача владения)
+   * @param config Параметры (число шардов, реализация ввода-вывода, лимиты)
    */
-  connectionManager(int domain, int type, int protocol, std::unique_ptr<IMessageHandler> handler);
+  connectionManager(int domain, int type, int protocol, std::unique_ptr<IMessageHandler> handler, ServerConfig config = ServerConfig());
 
   /**
    * @brief Деструктор
@@ -48,21 +91,140 @@ public:
   ~connectionManager();
   void start(const std::string &ip, const int port) override;
   void stop() override;
+
   /**
-   * @brief Получить список активных клиентов
-   * @return Ссылка на контейнер клиентов
-   * @warning Не потокобезопасно! Используйте get_clients_mutex()
+   * @brief Разослать сообщение подписчикам текущей комнаты отправителя, кроме него самого
+   * @param sender Сокет-отправитель (nullptr — рассылка всем клиентам сервера)
+   * @param msg Сообщение
+   *
+   * @details Сообщение не копируется: получатели разделяют один буфер. Клиентам своего шарда оно сразу
+   * ставится в очереди отправки (без системных вызовов), остальным шардам
+   * передается через их очереди задач и доставляется их потоками. Стоимость
+   * рассылки в шарде пропорциональна числу подписчиков комнаты в нем.
+   * Если отправитель не состоит ни в одной комнате, он получает подсказку.
+   * @threadsafe Отправитель задается только из обработчика его сообщения, рассылка всем — из любого потока
    */
-  ClientsContainer &get_clients()
+  void broadcast(const std::shared_ptr<Socket> &sender, const MessageRef &msg);
+
+  /// Результат изменения подписки
+  enum class RoomChange
   {
-    return active_clients_;
-  }
+    Done,        ///< Подписка изменена
+    Unchanged,   ///< Клиент уже был (или не был) в комнате; при /join комната стала текущей
+    LimitReached ///< Превышено ServerConfig::max_rooms_per_client_
+  };
+
+  /**
+   * @brief Подписать клиента на комнату и сделать ее текущей
+   * @param client Сокет клиента
+   * @param room Имя комнаты
+   * @param confirmation Ответ клиенту, если подписка состоялась (Done или Unchanged)
+   * @details Подписка, ответ и история комнаты (при Done) выполняются одной
+   * задачей в потоке шарда: рассылки комнаты приходят клиенту только после
+   * ответа и истории, а история не повторяет уже полученное рассылкой
+   * @warning Вызывается только обработчиком сообщения этого клиента
+   */
+  RoomChange join(const std::shared_ptr<Socket> &client, std::string_view room, const MessageRef &confirmation);
+
+  /**
+   * @brief Отписать клиента от комнаты
+   * @param client Сокет клиента
+   * @param room Имя комнаты; пустое — текущая комната
+   * @warning Вызывается только обработчиком сообщения этого клиента
+   */
+  RoomChange leave(const std::shared_ptr<Socket> &client, std::string_view room);
+
+  /**
+   * @brief Текущая комната клиента
+   * @param client Сокет клиента
+   * @return Имя комнаты или пустая ссылка
+   * @warning Вызывается только обработчиком сообщения этого клиента
+   */
+  MessageRef current_room(const std::shared_ptr<Socket> &client) const;
+
+  /// Результат смены никнейма
+  enum class NickChange
+  {
+    Done,      ///< Имя занято клиентом (прежнее освобождено)
+    Unchanged, ///< У клиента уже это имя
+    Taken      ///< Имя принадлежит другому клиенту
+  };
 
   /**
-   * @brief Получить мьютекс для работы с клиентами
-   * @return Ссылка на мьютекс
+   * @brief Задать никнейм клиента
+   * @param client Сокет клиента
+   * @param nick Имя (1..NameIndex::kMaxName байт, проверяет вызывающий)
+   * @details Новое имя занимается и прежнее освобождается одной записью в
+   * NameIndex; при отключении имя освобождается
+   * @warning Вызывается только обработчиком сообщения этого клиента
    */
-  std::mutex &get_clients_mutex() { return clientsMutex_; }
+  NickChange set_nick(const std::shared_ptr<Socket> &client, std::string_view nick);
+
+  /**
+   * @brief Отправить личное сообщение клиенту с никнеймом
+   * @param sender Сокет отправителя
+   * @param nick Никнейм получателя
+   * @param text Текст без завершающего "\n"
+   * @details Получатель находится одним поиском в NameIndex, сообщение
+   * ставится в его очередь в потоке его шарда. Если получателя нет или у
+   * отправителя нет никнейма, отправитель получает объяснение.
+   * @warning Вызывается только обработчиком сообщения этого клиента
+   */
+  void direct(const std::shared_ptr<Socket> &sender, std::string_view nick, std::string_view text);
+
+  /**
+   * @brief Отправить сообщение одному клиенту (в его протоколе)
+   * @param client Сокет клиента
+   * @param msg Текст сообщения с завершающим "\n"
+   * @warning Вызывается только обработчиком сообщения этого клиента
+   */
+  void reply(const std::shared_ptr<Socket> &client, const MessageRef &msg);
+
+  /// Посетитель подключения: реализация ввода-вывода его шарда и само подключение
+  using ClientVisitor = std::function<void(IIoBackend &io, const std::shared_ptr<Connection> &client)>;
+
+  /**
+   * @brief Обойти все подключения сервера
+   * @param visitor Вызывается для каждого подключения в потоке его шарда
+   *
+   * @details Обход своего шарда выполняется сразу, остальных — асинхронно
+   * через их очереди задач. Блокировок не берется, подключения и отключения
+   * в других шардах обход не задерживают.
+   * @threadsafe Может вызываться из любого потока
+   */
+  void for_each_client(ClientVisitor visitor);
+
+  /// @brief Количество подключенных клиентов во всех шардах
+  size_t client_count() const noexcept;
+
+  /// Счетчики медленных клиентов (сумма по потокам)
+  struct SlowConsumerStats
+  {
+    uint64_t dropped_messages = 0; ///< Отброшено сообщений
+    uint64_t dropped_bytes = 0;    ///< Отброшено байт
+    uint64_t disconnects = 0;      ///< Отключено клиентов
+  };
+
+  /// @brief Счетчики медленных клиентов
+  /// @threadsafe Может вызываться из любого потока
+  SlowConsumerStats slow_consumer_stats() const noexcept;
+
+  /// @brief Счетчики пула обработчиков (нулевые, если пул не используется)
+  /// @threadsafe Может вызываться из любого потока
+  HandlerPool::Stats handler_stats() const noexcept;
+
+  /**
+   * @brief Метрики сервера в текстовом формате Prometheus
+   * @return Счетчики и гистограммы Metrics, число клиентов и состояние пула обработчиков
+   * @threadsafe Может вызываться из любого потока
+   */
+  std::string metrics_text() const;
+
+  /// @brief Количество шардов
+  size_t shard_count() const noexcept { return shards_.size(); }
+
+  /// @brief Название используемой реализации ввода-вывода
+  const char *io_backend_name() const noexcept { return shards_.front()->io->name(); }
 
   /**
    * @brief Получить обработчик приведенный к типу T
@@ -83,31 +245,249 @@ public:
   }
 
 private:
-  Socket serverSocket_;                                ///< Основной серверный сокет
-  std::thread thread_accept_;                          ///< Поток для приема подключений
-  std::unique_ptr<IMessageHandler> handler_;           ///< Обработчик сообщений
-  std::vector<std::thread> thread_connection_clients_; ///< Потоки клиентов
-  std::mutex clientsMutex_;                            ///< Мьютекс для доступа к клиентам
-  std::atomic<bool> running_;                          ///< атомарная переменная для коррекнтого завершения работы
-  ClientsContainer active_clients_;                    ///< Активные подключения
+  /**
+   * @struct Shard
+   * @brief Слушающий сокет, цикл событий и подключения одного потока
+   * @note clients изменяется и обходится только потоком шарда
+   */
+  struct Shard
+  {
+    Shard(size_t index, int domain, int type, int protocol, std::chrono::milliseconds tick, const ServerConfig &config)
+        : index(index), serverSocket(domain, type, protocol),
+          history(config.history_messages_, config.history_bytes_, config.history_rooms_), timers(loop, tick) {}
+
+    size_t index;                   ///< Номер шарда
+    Socket serverSocket;            ///< Слушающий сокет шарда
+    EventLoop loop;                 ///< Цикл событий (epoll)
+    std::unique_ptr<IIoBackend> io; ///< Ввод-вывод подключений шарда
+    std::thread thread;             ///< Поток цикла событий
+    ClientRegistry clients;         ///< Подключения шарда
+    RoomIndex rooms;                ///< Подписки подключений шарда на комнаты
+    RoomHistory history;            ///< Последние сообщения комнат
+    bool accept_paused = false;     ///< Слушающий сокет снят с ожидания из-за лимита подключений
+    TimerWheel timers;              ///< Таймеры сроков подключений шарда
+  };
+
+  std::vector<std::unique_ptr<Shard>> shards_; ///< Шарды сервера
+  std::unique_ptr<IMessageHandler> handler_;   ///< Обработчик сообщений
+  std::atomic<bool> running_;                  ///< атомарная переменная для коррекнтого завершения работы
+  ServerConfig config_;                        ///< Параметры сервера
+  std::unique_ptr<HandlerPool> handlers_;      ///< Пул обработчиков (nullptr — обработка в потоках шардов)
+  std::unique_ptr<MetricsListener> admin_;     ///< Выдача метрик по HTTP (nullptr — отключена)
+  std::unique_ptr<MessageLog> store_;          ///< Журнал сообщений на диске (nullptr — отключен)
+  std::unique_ptr<ClusterBridge> cluster_;     ///< Связь с другими узлами (nullptr — один процесс)
+  std::atomic<size_t> connections_{0};         ///< Подключения всех шардов (для max_connections_)
+  NameIndex names_;                            ///< Никнеймы подключений всех шардов
+  AcceptLimiter accept_limiter_;               ///< Частота новых подключений (общая и по адресу)
+
+  /// Сообщение, которое сейчас обрабатывает поток пула
+  struct HandlerScope
+  {
+    Shard *shard = nullptr;             ///< Шард отправителя
+    const Connection *client = nullptr; ///< Отправитель
+  };
+  static thread_local HandlerScope handlerScope_; ///< Контекст обработчика в потоке пула
+
+  /**
+   * @brief Выполнить задачу в потоке каждого шарда
+   * @param task Задача void(Shard &); для своего шарда вызывается сразу
+   */
+  template <typename Task>
+  void for_each_shard(const Task &task)
+  {
+    for (auto &shard : shards_)
+    {
+      if (shard->loop.in_loop_thread())
+      {
+        task(*shard);
+        continue;
+      }
+      Shard *raw = shard.get();
+      shard->loop.post([raw, task]
+                       { task(*raw); });
+    }
+  }
+
+  /**
+   * @brief Найти клиента, чье сообщение обрабатывается в текущем потоке
+   * @param socket Сокет клиента
+   * @param shard [out] Шард-владелец
+   * @return Подключение, если текущий поток — поток шарда; nullptr в потоке пула
+   * @throws std::logic_error если вызвано не из обработчика сообщения клиента
+   */
+  const std::shared_ptr<Connection> *localClient(const std::shared_ptr<Socket> &socket, Shard *&shard) const;
+
+  /**
+   * @brief Выполнить действие с клиентом в потоке его шарда, не дожидаясь результата
+   * @param socket Сокет клиента
+   * @param fn Действие void(Shard &, const std::shared_ptr<Connection> &)
+   * @details Из потока пула действие передается через очередь задач шарда;
+   * порядок действий одного обработчика сохраняется. Если клиент к тому
+   * времени отключился, действие не выполняется.
+   */
+  template <typename Fn>
+  void runOnClient(const std::shared_ptr<Socket> &socket, Fn fn);
+
+  /**
+   * @brief Выполнить действие с клиентом в потоке его шарда и дождаться результата
+   * @param socket Сокет клиента
+   * @param fallback Результат, если клиент уже отключился
+   * @param fn Действие R(Shard &, const std::shared_ptr<Connection> &)
+   * @note Поток пула блокируется до выполнения; потоки шардов пул не ждут,
+   * поэтому взаимной блокировки нет
+   */
+  template <typename R, typename Fn>
+  R callOnClient(const std::shared_ptr<Socket> &socket, R fallback, Fn fn);
+
+  /**
+   * @brief Применить ограничение очереди отправки перед постановкой сообщения
+   * @param shard Шард-владелец клиента
+   * @param client Получатель
+   * @param size Размер нового сообщения
+   * @return true, если сообщение нужно поставить в очередь
+   * @details Выше high_water_mark_ клиент считается перегруженным до тех пор,
+   * пока очередь не опустится до low_water_mark_. Отброшенные сообщения и
+   * отключения учитываются в счетчиках шарда.
+   */
+  bool admit(Shard &shard, const std::shared_ptr<Connection> &client, size_t size);
+
+  /**
+   * @brief Подписать клиента на комнату в индексе шарда и сделать ее текущей
+   * @param shard Шард-владелец клиента
+   * @param client Клиент, еще не подписанный на комнату
+   * @param room Имя комнаты
+   */
+  void joinRoom(Shard &shard, Connection &client, std::string_view room);
+
+  /**
+   * @brief Убрать подписку из индекса шарда
+   * @param shard Шард-владелец клиента
+   * @param subscription Подписка, уже удаленная у клиента (или удаляемая вместе с ним)
+   * @note Подписчику, перенесенному на освободившуюся позицию, обновляется slot
+   */
+  void leaveRoom(Shard &shard, const Connection::Subscription &subscription);
+
+  /**
+   * @brief Поставить историю комнаты в очередь клиента
+   * @param shard Шард-владелец клиента
+   * @param client Получатель
+   * @param room Имя комнаты
+   */
+  void sendHistory(Shard &shard, const std::shared_ptr<Connection> &client, std::string_view room);
+
+  /**
+   * @brief Поставить текстовое сообщение в очередь клиента в его протоколе
+   * @param shard Шард-владелец клиента
+   * @param client Получатель
+   * @param text Текст с завершающим "\n"
+   * @param binary Кэш бинарной формы text (заполняется при первом бинарном получателе)
+   */
+  void deliver(Shard &shard, const std::shared_ptr<Connection> &client, const MessageRef &text, MessageRef &binary);
+
+  /**
+   * @brief Принять все ожидающие подключения
+   * @param shard Шард, чей слушающий сокет готов
+   * @note Вызывается циклом событий шарда
+   */
+  void acceptClients(Shard &shard);
+
+  /**
+   * @brief Занять место под новое подключение
+   * @return false, если достигнут max_connections_
+   * @threadsafe Может вызываться из любого потока
+   */
+  bool reserveConnection() noexcept;
+
+  /**
+   * @brief Освободить место закрытого (или так и не принятого) подключения
+   * @details Если сервер был заполнен, шарды с приостановленным приемом
+   * (ConnectionLimitPolicy::Queue) возобновляют его. Любая отмена
+   * reserveConnection() идет только через этот метод: шард, заставший
+   * временно заполненный сервер, иначе остался бы приостановленным
+   */
+  void releaseConnection();
+
+  /**
+   * @brief Снова ждать подключений на слушающем сокете шарда
+   * @param shard Шард с приостановленным приемом
+   * @note Вызывается в потоке шарда
+   */
+  void resumeAccept(Shard &shard);
+
+  /**
+   * @brief Проверить сроки подключения при срабатывании его таймера
+   * @param shard Шард-владелец подключения
+   * @param connection Подключение
+   * @details Закрывает бинарного клиента, не дославшего первый кадр за
+   * handshake_timeout_ (Connection::handshake_pending()), молчащего дольше
+   * idle_timeout_ (если задан), не ответившего на Ping или медленного
+   * дольше slow_consumer_timeout_; бинарному клиенту после ping_interval_
+   * простоя отправляет Ping. Затем взводит таймер на ближайший срок.
+   */
+  void checkTimeouts(Shard &shard, Connection &connection);
+
+  /**
+   * @brief Взвести таймер подключения на ближайший из его сроков
+   * @param shard Шард-владелец подключения
+   * @param client Подключение
+   */
+  void scheduleTimeouts(Shard &shard, Connection &client);
+
+  /**
+   * @brief Отключить медленного клиента (SlowConsumerPolicy::Disconnect)
+   * @param shard Шард-владелец подключения
+   * @param client Подключение
+   */
+  void disconnectSlow(Shard &shard, const std::shared_ptr<Connection> &client);
+
+  /**
+   * @brief Обработка данных, принятых от клиента
+   * @param shard Шард-владелец подключения
+   * @param client Подключение (данные накоплены в client->framer())
+   * @details Обрабатывает все завершенные строки; незавершенная остается в буфере
+   * @note Вызывается IIoBackend шарда
+   */
+  void handleClient(Shard &shard, const std::shared_ptr<Connection> &client);
+
+  /**
+   * @brief Обработать одно полученное сообщение
+   * @param shard Шард-владелец подключения
+   * @param client Подключение-отправитель
+   * @param frame Сообщение (в любом протоколе)
+   * @param received_at Момент чтения данных (Metrics::now_ns())
+   * @details Цепочка обработчиков вызывается сразу или сообщение передается пулу
+   */
+  void processMessage(Shard &shard, const std::shared_ptr<Connection> &client, const Framer::Frame &frame, uint64_t received_at);
+
+  /**
+   * @brief Выполнить задачу пула обработчиков
+   * @param job Сообщение клиента или запрос отключения (пустое сообщение)
+   * @note Вызывается в потоке пула
+   */
+  void runHandler(HandlerPool::Job &job);
 
   /**
-   * @brief Цикл принятия новых подключений
-   * @note Работает в отдельном потоке (thread_accept_)
+   * @brief Попрощаться с клиентом и закрыть подключение после отправки очереди
+   * @param shard Шард-владелец подключения
+   * @param client Подключение
    */
-  void acceptClients();
+  void quitClient(Shard &shard, const std::shared_ptr<Connection> &client);
 
   /**
-   * @brief Обработка клиентского подключения
-   * @param client Умный указатель на клиентский сокет
-   * @note Работает в отдельном потоке для каждого клиента
+   * @brief Доставить сообщение клиентам шарда
+   * @param shard Шард (вызывается в его потоке)
+   * @param sender Сокет-отправитель
+   * @param room Комната (пустая ссылка — все клиенты шарда)
+   * @param msg Сообщение (одна копия на всех получателей текстового протокола)
+   * @details Для бинарных получателей сообщение перекодируется один раз на шард.
+   * Сообщение в комнату попадает в историю шарда
    */
-  void handleClient(std::shared_ptr<Socket> client);
+  void deliverLocal(Shard &shard, const std::shared_ptr<Socket> &sender, const MessageRef &room, const IIoBackend::Payload &msg);
 
   /**
-   * @brief Удаление отключенного клиента
-   * @param client Сокет отключенного клиента
-   * @threadsafe Использует clientsMutex_
+   * @brief Снять подключение с цикла событий и освободить его
+   * @param shard Шард-владелец подключения
+   * @param client Подключение
    */
-  void cleanupDisconnectedClients(std::shared_ptr<Socket> client);
-};
\ No newline at end of file
+  void closeClient(Shard &shard, const std::shared_ptr<Connection> &client);
+};
@@ -0,0 +1,114 @@
+/**
+ * @file framer.h
+ * @brief Нарезка входящего потока байтов на сообщения
+ * @ingroup ServerCore
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <sys/types.h>
+#include "../include/net/connection/protocol.h"
+#include "../include/net/connection/ring_buffer.h"
+
+/**
+ * @class Framer
+ * @brief Потоковый разборщик сообщений поверх кольцевого буфера подключения
+ *
+ * @details Протокол определяется по первому принятому байту (см. protocol.h).
+ * Из одного приема извлекаются все завершенные сообщения, незавершенное
+ * остается в буфере до прихода продолжения. Сообщение длиннее max_frame_size
+ * считается ошибкой протокола. Разбор не выделяет память: кадр описывается
+ * участками кольцевого буфера. Буфер выделяется при первом приеме и растет
+ * только ради длинных сообщений; между приемами его можно вернуть в пул
+ * (release()).
+ *
+ * @warning Не потокобезопасен: используется только потоком цикла событий
+ */
+class Framer
+{
+public:
+  /**
+   * @struct Frame
+   * @brief Тело сообщения (для текста — строка без "\n" и "\r")
+   * @details Тело может переходить через конец кольцевого буфера, поэтому
+   * описывается двумя участками. Участки действительны до следующей записи в буфер.
+   */
+  struct Frame
+  {
+    FrameType type = FrameType::Message; ///< Тип сообщения
+    std::string_view parts[2];           ///< Начало и продолжение тела (второй участок может быть пуст)
+
+    /// @brief Длина тела
+    size_t size() const noexcept { return parts[0].size() + parts[1].size(); }
+
+    /// @brief true, если тело пустое
+    bool empty() const noexcept { return size() == 0; }
+
+    /// @brief Сравнить тело с текстом
+    bool equals(std::string_view text) const noexcept
+    {
+      return size() == text.size() && text.substr(0, parts[0].size()) == parts[0] &&
+             text.substr(parts[0].size()) == parts[1];
+    }
+  };
+
+  /// Начальный размер буфера приема
+  static constexpr size_t kInitialCapacity = 4096;
+
+  /**
+   * @brief Конструктор
+   * @param max_frame_size Максимальная длина тела сообщения в байтах
+   */
+  explicit Framer(size_t max_frame_size);
+
+  /// @brief Протокол подключения (Unknown, пока не принят первый байт)
+  Protocol protocol() const noexcept { return protocol_; }
+
+  /**
+   * @brief Принять данные из сокета прямо в кольцевой буфер (readv)
+   * @param fd Дескриптор сокета
+   * @return Количество принятых байт, 0 при закрытии соединения, -1 при ошибке (errno)
+   * @note Если буфер заполнен незавершенным сообщением максимальной длины,
+   * возвращает -1 с errno = EMSGSIZE
+   */
+  ssize_t read_from(int fd);
+
+  /**
+   * @brief Дописать уже принятые данные (например, из буфера io_uring)
+   * @param data Данные
+   * @param len Длина
+   */
+  void append(const char *data, size_t len);
+
+  /**
+   * @brief Извлечь следующее завершенное сообщение
+   * @param frame Сообщение (действительно до следующей записи в буфер)
+   * @return true, если сообщение извлечено; false, если нужна еще порция данных
+   * @throws std::runtime_error при превышении max_frame_size или неверном кадре
+   */
+  bool next(Frame &frame);
+
+  /// @brief Количество байт, ожидающих разбора
+  size_t buffered() const noexcept { return buffer_.size(); }
+
+  /**
+   * @brief Вернуть буфер приема в пул, если все принятое разобрано
+   * @note Простаивающее подключение не держит буфер; следующий прием возьмет его снова
+   */
+  void release() noexcept { buffer_.release(); }
+
+private:
+  RingBuffer buffer_;                     ///< Принятые, но еще не разобранные данные
+  size_t max_frame_size_;                 ///< Максимальная длина тела
+  size_t max_capacity_;                   ///< Предельная емкость буфера
+  size_t scanned_ = 0;                    ///< Сколько байт текста уже проверено на "\n"
+  Protocol protocol_ = Protocol::Unknown; ///< Протокол подключения
+
+  /// @brief Извлечь строку текстового протокола
+  bool next_line(Frame &frame);
+
+  /// @brief Извлечь кадр бинарного протокола
+  bool next_binary(Frame &frame);
+};
@@ -0,0 +1,118 @@
+/**
+ * @file message_buffer.h
+ * @brief Неизменяемый буфер сообщения с подсчетом ссылок
+ * @ingroup ServerCore
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string_view>
+#include <utility>
+
+class MessageRef;
+
+/**
+ * @class MessageBuffer
+ * @brief Сообщение, разделяемое между очередями отправки всех получателей
+ *
+ * @details Заголовок и байты сообщения лежат в одном блоке памяти, поэтому
+ * сообщение стоит ровно одну аллокацию независимо от числа получателей.
+ * Блок берется из BlockPool потока, создающего сообщение, а не из malloc.
+ * Счетчик ссылок встроен в заголовок и атомарен: ссылки передаются между
+ * потоками шардов. После создания содержимое не меняется.
+ */
+class MessageBuffer
+{
+public:
+  /**
+   * @brief Создать сообщение из последовательности фрагментов
+   * @param parts Фрагменты, записываемые подряд (например, текст и "\n")
+   * @param received_at Момент приема исходного сообщения (Metrics::now_ns()); 0 — не измеряется
+   * @return Ссылка на новое сообщение
+   * @throws std::bad_alloc при нехватке памяти
+   */
+  static MessageRef create(std::initializer_list<std::string_view> parts, uint64_t received_at = 0);
+
+  /// @brief Начало данных сообщения
+  const char *data() const noexcept { return reinterpret_cast<const char *>(this + 1); }
+
+  /// @brief Длина сообщения в байтах
+  size_t size() const noexcept { return size_; }
+
+  /// @brief true, если сообщение пустое
+  bool empty() const noexcept { return size_ == 0; }
+
+  /// @brief Содержимое сообщения
+  std::string_view view() const noexcept { return std::string_view(data(), size_); }
+
+  /// @brief Момент приема исходного сообщения, нс (0 — не измеряется)
+  uint64_t received_at() const noexcept { return received_at_; }
+
+  /// @brief Задать число шардов, в которых сообщение будет разослано
+  void set_fanout(uint32_t shards) const noexcept { fanout_.store(shards, std::memory_order_relaxed); }
+
+  /// @brief Отметить рассылку в одном шарде; true — в последнем из set_fanout()
+  bool finish_fanout() const noexcept { return fanout_.fetch_sub(1, std::memory_order_acq_rel) == 1; }
+
+  MessageBuffer(const MessageBuffer &) = delete;
+  MessageBuffer &operator=(const MessageBuffer &) = delete;
+
+private:
+  friend class MessageRef;
+
+  MessageBuffer(size_t size, uint64_t received_at) noexcept : size_(size), received_at_(received_at) {}
+
+  /// @brief Освободить блок, когда ушла последняя ссылка
+  void release() const noexcept;
+
+  mutable std::atomic<uint32_t> refs_{1};   ///< Количество ссылок
+  mutable std::atomic<uint32_t> fanout_{0}; ///< Шардов, еще не закончивших рассылку
+  size_t size_;                             ///< Длина сообщения
+  uint64_t received_at_;                    ///< Момент приема для метрики задержки доставки
+};
+
+/**
+ * @class MessageRef
+ * @brief Владеющая ссылка на MessageBuffer (аналог shared_ptr без отдельного блока управления)
+ */
+class MessageRef
+{
+public:
+  MessageRef() noexcept = default;
+
+  MessageRef(const MessageRef &other) noexcept : buffer_(other.buffer_)
+  {
+    if (buffer_)
+      buffer_->refs_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  MessageRef(MessageRef &&other) noexcept : buffer_(std::exchange(other.buffer_, nullptr)) {}
+
+  MessageRef &operator=(MessageRef other) noexcept
+  {
+    std::swap(buffer_, other.buffer_);
+    return *this;
+  }
+
+  ~MessageRef()
+  {
+    if (buffer_)
+      buffer_->release();
+  }
+
+  const MessageBuffer *get() const noexcept { return buffer_; }
+  const MessageBuffer &operator*() const noexcept { return *buffer_; }
+  const MessageBuffer *operator->() const noexcept { return buffer_; }
+  explicit operator bool() const noexcept { return buffer_ != nullptr; }
+
+private:
+  friend class MessageBuffer;
+
+  /// @brief Принять уже учтенную ссылку
+  explicit MessageRef(const MessageBuffer *buffer) noexcept : buffer_(buffer) {}
+
+  const MessageBuffer *buffer_ = nullptr; ///< Сообщение или nullptr
+};
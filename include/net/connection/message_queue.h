@@ -0,0 +1,91 @@
+/**
+ * @file message_queue.h
+ * @brief Очередь исходящих сообщений подключения
+ * @ingroup ServerCore
+ */
+
+#pragma once
+#include <cstddef>
+#include <new>
+#include <utility>
+#include "../include/net/connection/message_buffer.h"
+
+/**
+ * @class MessageQueue
+ * @brief Кольцо ссылок на сообщения с емкостью степени двойки
+ *
+ * @details Замена std::deque для очереди отправки: пустая очередь не
+ * занимает памяти (deque выделяет блок уже в конструкторе), а кольцо
+ * растет удвоением в BlockPool и не выделяет память, пока в нем есть место.
+ * Опустевшее кольцо больше kKeepCapacity возвращается в пул, чтобы
+ * подключение после всплеска не держало большую очередь.
+ *
+ * @warning Не потокобезопасна
+ */
+class MessageQueue
+{
+public:
+  /// Емкость, которую опустевшая очередь оставляет себе
+  static constexpr size_t kKeepCapacity = 256;
+
+  MessageQueue() noexcept = default;
+  ~MessageQueue();
+
+  MessageQueue(const MessageQueue &) = delete;
+  MessageQueue &operator=(const MessageQueue &) = delete;
+
+  /// @brief Количество сообщений
+  size_t size() const noexcept { return size_; }
+
+  /// @brief true, если очередь пуста
+  bool empty() const noexcept { return size_ == 0; }
+
+  /// @brief Сообщение по номеру от начала очереди (меньше size())
+  const MessageRef &operator[](size_t index) const noexcept { return slots_[(head_ + index) & (capacity_ - 1)]; }
+
+  /// @brief Первое сообщение
+  const MessageRef &front() const noexcept { return slots_[head_]; }
+
+  /**
+   * @brief Добавить сообщение в конец
+   * @param message Сообщение
+   * @throws std::bad_alloc при нехватке памяти для роста
+   */
+  void push_back(MessageRef message)
+  {
+    if (size_ == capacity_)
+      reallocate(capacity_ == 0 ? kInitialCapacity : capacity_ * 2);
+    new (&slots_[(head_ + size_) & (capacity_ - 1)]) MessageRef(std::move(message));
+    ++size_;
+  }
+
+  /// @brief Удалить первое сообщение (очередь не пуста)
+  void pop_front() noexcept
+  {
+    slots_[head_].~MessageRef();
+    head_ = (head_ + 1) & (capacity_ - 1);
+    if (--size_ == 0)
+      drained();
+  }
+
+  /**
+   * @brief Удалить сообщения из середины очереди
+   * @param index Номер первого удаляемого
+   * @param count Сколько удалить (index + count не больше size())
+   */
+  void erase(size_t index, size_t count) noexcept;
+
+private:
+  MessageRef *slots_ = nullptr; ///< Кольцо (nullptr, пока емкость 0)
+  size_t capacity_ = 0;         ///< Емкость (степень двойки или 0)
+  size_t head_ = 0;             ///< Индекс первого сообщения
+  size_t size_ = 0;             ///< Количество сообщений
+
+  static constexpr size_t kInitialCapacity = 8; ///< Емкость первого выделения
+
+  /// @brief Перенести сообщения в кольцо емкостью capacity
+  void reallocate(size_t capacity);
+
+  /// @brief Очередь опустела: начать кольцо сначала, большое — вернуть в пул
+  void drained() noexcept;
+};
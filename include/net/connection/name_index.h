@@ -0,0 +1,143 @@
+/**
+ * @file name_index.h
+ * @brief Индекс никнеймов всех подключений сервера
+ * @ingroup ServerCore
+ */
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+/**
+ * @class NameIndex
+ * @brief Никнейм -> подключение (шард, дескриптор, метка) для всех шардов
+ *
+ * @details Открытая адресация с линейным пробированием. Ячейка хранит имя
+ * прямо в себе (до kMaxName байт в четырех атомарных словах) и адрес
+ * подключения, поэтому поиск не выделяет память и не разыменовывает
+ * указателей на записи, которые могли быть удалены.
+ *
+ * Чтение без блокировок (seqlock): поиск запоминает счетчик версий,
+ * просматривает ячейки и повторяется, только если за это время писатель
+ * изменил таблицу. Писатели (/nick и отключения — редкие события)
+ * упорядочены мьютексом; переименование — одна запись под счетчиком
+ * версий, поэтому читатель видит либо старое имя, либо новое, но не оба и
+ * не ни одного. Удаление сдвигает следующие ячейки назад (без надгробий),
+ * так что таблица не деградирует при смене имен.
+ *
+ * Таблица удваивается, когда заполнена наполовину. Прежние таблицы
+ * остаются в памяти до разрушения индекса: читатель мог начать поиск в
+ * старой таблице. Их суммарный размер меньше размера текущей.
+ *
+ * @threadsafe Все методы можно вызывать из любого потока; find() не блокируется
+ */
+class NameIndex
+{
+public:
+  /// Максимальная длина имени, байт
+  static constexpr size_t kMaxName = 32;
+
+  /// Подключение, которому принадлежит имя
+  struct Target
+  {
+    uint32_t shard = 0; ///< Номер шарда
+    int fd = -1;        ///< Дескриптор подключения
+    uint64_t token = 0; ///< Метка владения (не 0): отличает подключение от следующего с тем же fd
+  };
+
+  /// @brief Создает пустую таблицу
+  NameIndex();
+
+  NameIndex(const NameIndex &) = delete;
+  NameIndex &operator=(const NameIndex &) = delete;
+
+  /**
+   * @brief Найти владельца имени
+   * @param name Имя
+   * @param target [out] Владелец
+   * @return false, если имя свободно
+   */
+  bool find(std::string_view name, Target &target) const noexcept;
+
+  /**
+   * @brief Занять имя и одновременно освободить прежнее
+   * @param name Новое имя (1..kMaxName байт)
+   * @param target Владелец
+   * @param previous Прежнее имя владельца (пусто — не было); освобождается,
+   * только если принадлежит target.token
+   * @return false, если имя занято другим владельцем (ничего не меняется)
+   */
+  bool claim(std::string_view name, const Target &target, std::string_view previous);
+
+  /**
+   * @brief Освободить имя
+   * @param name Имя
+   * @param token Метка владельца: чужое имя не освобождается
+   */
+  void release(std::string_view name, uint64_t token);
+
+  /// @brief Выдать новую метку владения
+  uint64_t next_token() noexcept { return tokens_.fetch_add(1, std::memory_order_relaxed); }
+
+  /// @brief Количество занятых имен
+  size_t size() const noexcept { return count_.load(std::memory_order_relaxed); }
+
+private:
+  static constexpr size_t kWords = kMaxName / sizeof(uint64_t); ///< Слов на имя
+
+  /// Ячейка таблицы; все поля атомарны, читатели не блокируются
+  struct Slot
+  {
+    std::atomic<uint64_t> token{0};        ///< Метка владельца; 0 — ячейка пуста
+    std::atomic<uint64_t> address{0};      ///< Шард (старшие 32 бита) и дескриптор
+    std::atomic<uint64_t> length{0};       ///< Длина имени
+    std::atomic<uint64_t> words[kWords]{}; ///< Имя, дополненное нулями
+  };
+
+  /// Таблица размером в степень двойки
+  struct Table
+  {
+    explicit Table(size_t capacity) : mask(capacity - 1), slots(new Slot[capacity]) {}
+
+    size_t mask;                   ///< Размер - 1
+    std::unique_ptr<Slot[]> slots; ///< Ячейки
+  };
+
+  /// Имя, упакованное для сравнения по словам
+  struct Key
+  {
+    uint64_t length = 0;         ///< Длина
+    uint64_t words[kWords] = {}; ///< Имя, дополненное нулями
+    uint64_t hash = 0;           ///< Хеш имени
+  };
+
+  std::atomic<uint64_t> version_{0};           ///< Нечетный — идет запись
+  std::atomic<Table *> table_;                 ///< Текущая таблица
+  std::vector<std::unique_ptr<Table>> tables_; ///< Все таблицы (прежние живут до разрушения)
+  std::mutex write_mutex_;                     ///< Упорядочивает писателей
+  std::atomic<size_t> count_{0};               ///< Занятых ячеек текущей таблицы
+  std::atomic<uint64_t> tokens_{1};            ///< Следующая метка владения
+
+  /// @brief Упаковать имя (false — длина вне 1..kMaxName)
+  static bool make_key(std::string_view name, Key &key) noexcept;
+
+  /// @brief Ключ имени, записанного в ячейке (вызывающий держит мьютекс)
+  static Key key_of(const Slot &slot) noexcept;
+
+  /// @brief Индекс ячейки с именем или -1 (relaxed-чтения: вызывающий проверяет версию)
+  static long locate(const Table &table, const Key &key) noexcept;
+
+  /// @brief Записать имя в первую свободную ячейку (вызывающий держит мьютекс)
+  static void put(Table &table, const Key &key, uint64_t token, uint64_t address) noexcept;
+
+  /// @brief Удалить ячейку со сдвигом следующих назад (вызывающий держит мьютекс)
+  static void erase(Table &table, size_t index) noexcept;
+
+  /// @brief Перенести имена в таблицу вдвое больше (вызывающий держит мьютекс)
+  void grow();
+};
@@ -0,0 +1,57 @@
+/**
+ * @file protocol.h
+ * @brief Форматы сообщений на проводе: текстовый и бинарный
+ * @ingroup ServerCore
+ *
+ * @details Протокол выбирается для каждого подключения по первому байту от клиента:
+ * - kBinaryHandshake — бинарный режим, сам байт отбрасывается;
+ * - любой другой байт — текстовый режим (строки, завершенные "\n"), байт входит в первую строку.
+ *
+ * Бинарный кадр: varint (LEB128) длины, затем байт типа FrameType и тело.
+ * Длина учитывает байт типа и тело. Строка приветствия уходит до выбора протокола
+ * и всегда текстовая: бинарный клиент пропускает все до первого "\n".
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+/// Протокол подключения
+enum class Protocol : uint8_t
+{
+  Unknown, ///< Клиент еще ничего не прислал
+  Text,    ///< Строки, завершенные "\n"
+  Binary   ///< Кадры с префиксом длины
+};
+
+/// Тип бинарного кадра
+enum class FrameType : uint8_t
+{
+  Message = 1, ///< Текст сообщения (без завершающего "\n")
+  Ping = 2,    ///< Проверка связи; получатель отвечает Pong с тем же телом
+  Pong = 3     ///< Ответ на Ping
+};
+
+/// Первый байт, переключающий подключение в бинарный режим (в тексте не встречается)
+constexpr unsigned char kBinaryHandshake = 0xB1;
+
+/// Максимальная длина varint для 32-битной длины
+constexpr size_t kMaxVarintSize = 5;
+
+/**
+ * @brief Записать varint
+ * @param value Значение
+ * @param out Буфер не меньше kMaxVarintSize байт
+ * @return Количество записанных байт
+ */
+inline size_t encode_varint(uint32_t value, unsigned char *out) noexcept
+{
+  size_t len = 0;
+  while (value >= 0x80)
+  {
+    out[len++] = static_cast<unsigned char>(value | 0x80);
+    value >>= 7;
+  }
+  out[len++] = static_cast<unsigned char>(value);
+  return len;
+}
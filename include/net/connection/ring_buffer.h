@@ -0,0 +1,123 @@
+/**
+ * @file ring_buffer.h
+ * @brief Кольцевой буфер байтов для приема из сокета
+ * @ingroup ServerCore
+ */
+
+#pragma once
+#include <cstddef>
+#include <string_view>
+#include <sys/uio.h>
+
+/**
+ * @class RingBuffer
+ * @brief Кольцевой буфер с емкостью степени двойки
+ *
+ * @details Позиции чтения и записи растут монотонно и приводятся к индексу
+ * маской, поэтому буфер не сдвигает данные. Свободное место и непрочитанные
+ * данные описываются не более чем двумя непрерывными участками — их можно
+ * передать в readv напрямую, без промежуточного буфера. Хранилище берется
+ * из BlockPool и может быть отдано обратно, пока буфер пуст (release()).
+ *
+ * @warning Не потокобезопасен
+ */
+class RingBuffer
+{
+public:
+  /**
+   * @brief Конструктор
+   * @param capacity Начальная емкость (округляется вверх до степени двойки); 0 — выделить при первом reserve()
+   */
+  explicit RingBuffer(size_t capacity = 0);
+
+  /// @brief Возвращает хранилище в пул
+  ~RingBuffer();
+
+  RingBuffer(const RingBuffer &) = delete;
+  RingBuffer &operator=(const RingBuffer &) = delete;
+
+  /// @brief Количество непрочитанных байт
+  size_t size() const noexcept { return tail_ - head_; }
+
+  /// @brief Емкость буфера
+  size_t capacity() const noexcept { return capacity_; }
+
+  /// @brief Свободное место
+  size_t space() const noexcept { return capacity_ - size(); }
+
+  /// @brief true, если непрочитанных данных нет
+  bool empty() const noexcept { return head_ == tail_; }
+
+  /**
+   * @brief Увеличить емкость с сохранением данных
+   * @param capacity Требуемая емкость (округляется вверх до степени двойки)
+   * @note Меньшая емкость игнорируется
+   */
+  void reserve(size_t capacity);
+
+  /**
+   * @brief Вернуть хранилище в пул, если непрочитанных данных нет
+   * @note Следующий reserve() выделит хранилище заново
+   */
+  void release() noexcept;
+
+  /**
+   * @brief Описать свободное место для записи
+   * @param iov Массив из двух элементов
+   * @return Количество заполненных элементов (0, если места нет)
+   */
+  size_t write_regions(iovec iov[2]) noexcept;
+
+  /**
+   * @brief Учесть байты, записанные в участки из write_regions()
+   * @param bytes Количество записанных байт
+   */
+  void commit(size_t bytes) noexcept { tail_ += bytes; }
+
+  /**
+   * @brief Дописать данные, при необходимости увеличив емкость
+   * @param data Данные
+   * @param len Длина
+   */
+  void append(const char *data, size_t len);
+
+  /**
+   * @brief Найти байт среди непрочитанных данных
+   * @param ch Искомый байт
+   * @param from Смещение от начала непрочитанных данных, с которого искать
+   * @return Смещение найденного байта или size(), если его нет
+   */
+  size_t find(char ch, size_t from = 0) const noexcept;
+
+  /**
+   * @brief Байт непрочитанных данных
+   * @param offset Смещение от начала непрочитанных данных (меньше size())
+   */
+  unsigned char at(size_t offset) const noexcept
+  {
+    return static_cast<unsigned char>(data_[index(head_ + offset)]);
+  }
+
+  /**
+   * @brief Непрочитанные данные в виде не более чем двух участков
+   * @param len Сколько байт описать (offset + len не больше size())
+   * @param parts Массив из двух элементов; второй пуст, если данные не переходят через конец буфера
+   * @param offset Смещение от начала непрочитанных данных
+   */
+  void peek(size_t len, std::string_view parts[2], size_t offset = 0) const noexcept;
+
+  /**
+   * @brief Отбросить прочитанные байты
+   * @param bytes Количество байт (не больше size())
+   */
+  void consume(size_t bytes) noexcept;
+
+private:
+  char *data_ = nullptr; ///< Хранилище (nullptr, пока емкость 0)
+  size_t capacity_ = 0;  ///< Емкость (степень двойки или 0)
+  size_t head_ = 0;      ///< Позиция чтения
+  size_t tail_ = 0;      ///< Позиция записи
+
+  /// @brief Индекс в хранилище по позиции
+  size_t index(size_t pos) const noexcept { return pos & (capacity_ - 1); }
+};
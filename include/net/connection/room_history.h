@@ -0,0 +1,121 @@
+/**
+ * @file room_history.h
+ * @brief История последних сообщений комнат одного шарда
+ * @ingroup ServerCore
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "../include/net/connection/message_buffer.h"
+
+/**
+ * @class RoomHistory
+ * @brief Комната -> кольцо последних сообщений для подписавшихся позже
+ *
+ * @details У каждой комнаты кольцо фиксированной емкости (max_messages
+ * ссылок, выделяется одним массивом при первом сообщении). Кольцо хранит
+ * те же MessageRef, что уходят получателям, — сообщения не копируются, а
+ * бинарная форма, если ее уже построила рассылка, переиспользуется при
+ * выдаче истории. Кроме числа сообщений ограничен их суммарный размер
+ * (max_bytes): самые старые вытесняются. Число комнат с историей тоже
+ * ограничено (max_rooms); вытесняется комната, куда дольше всех не писали.
+ *
+ * Каждый шард получает все сообщения комнат и ведет свою историю, поэтому
+ * выдача истории не обращается к другим шардам; буферы сообщений при этом
+ * общие для всех шардов.
+ *
+ * @warning Не потокобезопасен: используется только потоком шарда
+ */
+class RoomHistory
+{
+public:
+  /// Сообщение истории
+  struct Entry
+  {
+    MessageRef text;   ///< Текстовая форма (с "\n" на конце)
+    MessageRef binary; ///< Бинарный кадр (пустая ссылка, пока не понадобился)
+    uint64_t seq = 0;  ///< Номер сообщения в истории шарда (общий для всех комнат)
+  };
+
+  /**
+   * @brief Конструктор
+   * @param max_messages Сообщений в истории одной комнаты; 0 — история не ведется
+   * @param max_bytes Суммарный размер текстов истории одной комнаты, байт
+   * @param max_rooms Комнат с историей
+   */
+  RoomHistory(size_t max_messages, size_t max_bytes, size_t max_rooms);
+
+  /**
+   * @brief Добавить сообщение в историю комнаты
+   * @param room Имя комнаты
+   * @param text Текст сообщения
+   * @param binary Бинарная форма, если уже построена
+   * @note Сообщение длиннее max_bytes не сохраняется
+   */
+  void append(std::string_view room, const MessageRef &text, const MessageRef &binary);
+
+  /**
+   * @brief Обойти историю комнаты от старых сообщений к новым
+   * @param room Имя комнаты
+   * @param fn Вызывается с Entry & каждого сообщения (может заполнить binary);
+   * не должен изменять историю
+   */
+  template <typename Fn>
+  void for_each(std::string_view room, Fn &&fn)
+  {
+    auto it = index_.find(room);
+    if (it == index_.end())
+      return;
+    Room &history = **it->second;
+    for (size_t i = 0; i < history.count; ++i)
+    {
+      fn(history.ring[(history.head + i) % history.ring.size()]);
+    }
+  }
+
+  /**
+   * @brief Номер, который получит следующее сообщение
+   * @details Подписчик запоминает его при подписке: сообщения с меньшими
+   * номерами он не получал и получит из истории, остальные уже пришли ему
+   * рассылкой. Номера сквозные по комнатам, поэтому вытеснение и повторное
+   * создание комнаты их не сбрасывает.
+   */
+  uint64_t sequence() const noexcept { return next_seq_; }
+
+  /// @brief Количество сообщений в истории комнаты
+  size_t size(std::string_view room) const noexcept;
+
+  /// @brief Количество комнат с историей
+  size_t room_count() const noexcept { return index_.size(); }
+
+private:
+  /// История одной комнаты
+  struct Room
+  {
+    std::string name;        ///< Имя (на него ссылается ключ индекса)
+    std::vector<Entry> ring; ///< Кольцо емкостью max_messages_
+    size_t head = 0;         ///< Самое старое сообщение
+    size_t count = 0;        ///< Сообщений в кольце
+    size_t bytes = 0;        ///< Суммарный размер текстов
+  };
+
+  using Order = std::list<std::unique_ptr<Room>>;
+
+  size_t max_messages_;   ///< Емкость кольца комнаты
+  size_t max_bytes_;      ///< Предел размера истории комнаты
+  size_t max_rooms_;      ///< Предел числа комнат
+  uint64_t next_seq_ = 0; ///< Номер следующего сообщения
+
+  Order order_;                                                  ///< Комнаты, недавно дополненные — в начале
+  std::unordered_map<std::string_view, Order::iterator> index_; ///< Комнаты по имени
+
+  /// @brief Удалить самое старое сообщение комнаты
+  static void pop_oldest(Room &room) noexcept;
+};
@@ -0,0 +1,88 @@
+/**
+ * @file room_index.h
+ * @brief Индекс подписок на комнаты одного шарда
+ * @ingroup ServerCore
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "../include/net/connection/message_buffer.h"
+
+/**
+ * @class RoomIndex
+ * @brief Комната -> дескрипторы подписчиков шарда
+ *
+ * @details Каждый шард хранит подписки только своих подключений, поэтому
+ * индекс изменяется и читается одним потоком без блокировок. Членство — один
+ * int в массиве комнаты. Имя комнаты хранится один раз (интернируется): все
+ * подписчики шарда получают одну и ту же MessageRef, а не копию имени на
+ * подписку. Поиск комнаты — одна хеш-таблица по имени без выделения памяти на
+ * запрос: ключ ссылается на это имя.
+ *
+ * Позицию подписчика в массиве (slot) хранит сама подписка подключения
+ * (Connection::Subscription), поэтому подписка и отписка — O(1) без таблицы
+ * позиций: удаление переставляет последнего подписчика на место ушедшего
+ * (как в ClientRegistry), а leave() сообщает, чей slot изменился.
+ * Обход подписчиков стоит O(размер комнаты). Пустые комнаты удаляются.
+ *
+ * @warning Не потокобезопасен: используется только потоком шарда
+ */
+class RoomIndex
+{
+public:
+  /**
+   * @brief Подписать подключение на комнату
+   * @param room Имя комнаты
+   * @param fd Дескриптор подключения (еще не подписанного: проверяет вызывающий)
+   * @param slot Позиция подписчика в комнате; хранится в подписке подключения
+   * @return Общее для шарда имя комнаты
+   * @throws std::bad_alloc при нехватке памяти (индекс не изменяется)
+   */
+  MessageRef join(std::string_view room, int fd, uint32_t &slot);
+
+  /**
+   * @brief Отписать подключение от комнаты
+   * @param room Имя комнаты
+   * @param slot Позиция подписчика, выданная join() (или последним leave())
+   * @return Дескриптор подписчика, перенесенного на slot; -1 — никто не переносился
+   */
+  int leave(std::string_view room, uint32_t slot) noexcept;
+
+  /**
+   * @brief Обойти подписчиков комнаты
+   * @param room Имя комнаты
+   * @param fn Вызывается с дескриптором каждого подписчика; не должен изменять индекс
+   */
+  template <typename Fn>
+  void for_each_member(std::string_view room, Fn &&fn) const
+  {
+    auto it = rooms_.find(room);
+    if (it == rooms_.end())
+      return;
+    for (int fd : it->second->members)
+    {
+      fn(fd);
+    }
+  }
+
+  /// @brief Количество подписчиков комнаты в шарде
+  size_t member_count(std::string_view room) const noexcept;
+
+  /// @brief Количество непустых комнат в шарде
+  size_t room_count() const noexcept { return rooms_.size(); }
+
+private:
+  /// Комната: имя (на него ссылается ключ индекса) и подписчики
+  struct Room
+  {
+    MessageRef name;          ///< Имя комнаты, общее для всех подписок шарда
+    std::vector<int> members; ///< Подписчики подряд (для обхода)
+  };
+
+  std::unordered_map<std::string_view, std::unique_ptr<Room>> rooms_; ///< Комнаты по имени
+};
@@ -0,0 +1,74 @@
+/**
+ * @struct ServerConfig
+ * @brief Параметры менеджера подключений
+ */
+
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "../include/net/reactor/io_backend.h"
+
+/// Что делать с клиентом, очередь отправки которого превысила верхний порог
+enum class SlowConsumerPolicy
+{
+  DropOldest, ///< Отбросить самые старые сообщения очереди до нижнего порога
+  DropNewest, ///< Отбрасывать новые сообщения, пока очередь не опустится ниже нижнего порога
+  Disconnect  ///< Отбрасывать новые сообщения, а через slow_consumer_timeout_ над порогом отключить
+};
+
+/// Что делать с новым подключением сверх max_connections_
+enum class ConnectionLimitPolicy
+{
+  Reject, ///< Принять, отправить отказ и сразу закрыть
+  Queue   ///< Не принимать: подключения ждут в очереди listen, пока кто-то не отключится
+};
+
+struct ServerConfig
+{
+  size_t shards_ = 1;                             ///< Количество шардов; 0 — по числу ядер
+  IoBackendKind io_backend_ = IoBackendKind::Epoll; ///< Реализация ввода-вывода (io_uring с откатом на epoll)
+  size_t max_frame_size_ = 64 * 1024;             ///< Максимальная длина строки от клиента, байт
+  std::string default_room_ = "general";          ///< Комната, в которую попадает новый клиент; пусто — никакая
+  size_t max_rooms_per_client_ = 64;              ///< Максимум подписок одного клиента
+  size_t max_connections_ = 0;                    ///< Максимум одновременных подключений на сервер; 0 — без ограничения
+  ConnectionLimitPolicy connection_limit_policy_ = ConnectionLimitPolicy::Reject; ///< Реакция на превышение max_connections_
+  int listen_backlog_ = 4096;                     ///< Очередь listen каждого шарда (ядро урезает до net.core.somaxconn)
+  double accept_rate_ = 0;                        ///< Новых подключений в секунду на сервер; 0 — без ограничения
+  size_t accept_burst_ = 0;                       ///< Подключений подряд сверх accept_rate_; 0 — accept_rate_ за секунду
+  double accept_rate_per_ip_ = 0;                 ///< Новых подключений в секунду с одного IP-адреса; 0 — без ограничения
+  size_t accept_burst_per_ip_ = 0;                ///< Подключений подряд с одного адреса; 0 — accept_rate_per_ip_ за секунду
+  size_t accept_sources_ = 65536;                 ///< Адресов, для которых помнится частота подключений
+
+  size_t history_messages_ = 100;                 ///< Сообщений в истории комнаты для новых подписчиков; 0 — без истории
+  size_t history_bytes_ = 256 * 1024;             ///< Предел суммарного размера истории комнаты (в каждом шарде), байт
+  size_t history_rooms_ = 1024;                   ///< Комнат с историей в шарде; вытесняется давно молчащая
+
+  size_t high_water_mark_ = 4 * 1024 * 1024;      ///< Верхний порог очереди отправки клиента, байт
+  size_t low_water_mark_ = 1024 * 1024;           ///< Нижний порог: ниже него клиент снова считается здоровым
+  SlowConsumerPolicy slow_consumer_policy_ = SlowConsumerPolicy::DropOldest; ///< Реакция на превышение порога
+  std::chrono::milliseconds slow_consumer_timeout_{10000}; ///< Время над порогом до отключения (Disconnect)
+
+  std::chrono::microseconds write_coalesce_delay_{200}; ///< Наибольшая задержка записи ради объединения сообщений; 0 — каждую итерацию цикла
+  size_t write_coalesce_bytes_ = 16 * 1024;       ///< Очередь такого размера пишется без ожидания
+
+  size_t handler_threads_ = 0;                    ///< Потоки пула обработчиков; 0 — обработка в потоках шардов
+  size_t handler_queue_capacity_ = 4096;          ///< Максимум сообщений в очереди одного потока пула
+
+  std::chrono::seconds handshake_timeout_{30};    ///< Срок первого кадра бинарного клиента, начавшего его присылать; 0 — без ограничения
+  std::chrono::seconds idle_timeout_{0};          ///< Отключение клиента без входящих данных; 0 — без ограничения (текстовый клиент может только читать)
+  std::chrono::seconds keepalive_idle_{60};       ///< Простой TCP до проб keepalive (полуоткрытые подключения); 0 — keepalive выключен
+  std::chrono::seconds keepalive_interval_{10};   ///< Пауза между пробами keepalive
+  int keepalive_probes_ = 6;                      ///< Проб без ответа до разрыва; TCP_USER_TIMEOUT — весь этот срок
+  std::chrono::seconds ping_interval_{30};        ///< Простой бинарного клиента до Ping; без ответа за столько же — отключение; 0 — без ping
+
+  std::string store_dir_;                         ///< Каталог журнала сообщений на диске; пусто — сообщения не сохраняются
+
+  int cluster_port_ = 0;                          ///< Порт для подключений других узлов кластера; 0 — один процесс
+  std::string cluster_ip_;                        ///< Адрес порта кластера; пусто — адрес клиентов (открывать наружу нельзя)
+  std::string cluster_secret_;                    ///< Общий секрет узлов кластера; пусто — узлы проверяются только по адресу
+  std::vector<std::string> cluster_peers_;        ///< Остальные узлы кластера ("адрес:порт"), к которым подключается этот
+
+  int admin_port_ = 0;                            ///< Порт HTTP-выдачи метрик (GET /metrics); 0 — отключена
+};
@@ -0,0 +1,56 @@
+/**
+ * @file epoll_backend.h
+ * @brief Ввод-вывод подключений через edge-triggered epoll
+ * @ingroup ServerCore
+ */
+
+#pragma once
+#include <vector>
+#include "../include/net/reactor/io_backend.h"
+
+/**
+ * @class EpollBackend
+ * @brief Реализация IIoBackend на готовности сокетов
+ *
+ * @details Сокет регистрируется в цикле событий с EPOLLET: при готовности
+ * чтения он вычитывается до EAGAIN. send() только ставит сообщение в очередь
+ * подключения и запоминает его в списке на запись (WriteCoalescer); список
+ * разбирается перед ожиданием событий, и вся очередь подключения уходит одним
+ * sendmsg. Неотправленный остаток дописывается по EPOLLOUT.
+ */
+class EpollBackend : public IIoBackend
+{
+public:
+  /**
+   * @brief Конструктор
+   * @param loop Цикл событий шарда
+   * @param on_data Обработчик принятых данных
+   * @param on_close Обработчик закрытия подключения
+   * @param coalescing Параметры объединения записей
+   */
+  EpollBackend(EventLoop &loop, DataHandler on_data, CloseHandler on_close, WriteCoalescing coalescing);
+
+  /// @brief Снимает обработчик перед ожиданием событий
+  ~EpollBackend() override;
+
+  const char *name() const noexcept override { return "epoll"; }
+  void attach(const std::shared_ptr<Connection> &client) override;
+  void detach(const std::shared_ptr<Connection> &client) override;
+  void send(const std::shared_ptr<Connection> &client, Payload data) override;
+
+private:
+  EventLoop &loop_;                                ///< Цикл событий шарда
+  DataHandler on_data_;                            ///< Обработчик принятых данных
+  CloseHandler on_close_;                          ///< Обработчик закрытия
+  WriteCoalescer dirty_;                           ///< Подключения с новыми данными в очереди
+
+  /// @brief Дописать очереди подключений из списка на запись
+  void flushPending();
+
+  /**
+   * @brief Обработка событий подключения
+   * @param client Подключение
+   * @param events Маска событий epoll
+   */
+  void handleEvents(const std::shared_ptr<Connection> &client, uint32_t events);
+};
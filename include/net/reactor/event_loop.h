@@ -0,0 +1,136 @@
+/**
+ * @file event_loop.h
+ * @brief Цикл обработки событий на базе epoll (edge-triggered)
+ * @ingroup ServerCore
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "../include/net/reactor/inline_task.h"
+
+/**
+ * @class EventLoop
+ * @brief Реактор: ожидает события на дескрипторах и вызывает их обработчики
+ *
+ * @details Особенности:
+ * - Один поток выполняет run() и все зарегистрированные обработчики
+ * - Другие потоки передают работу в цикл через post() (пробуждение через eventfd)
+ * - Дескрипторы регистрируются в режиме, выбранном вызывающим (обычно EPOLLET)
+ * - Исключение обработчика или задачи не останавливает цикл: оно пишется в
+ *   журнал, а для дескриптора вызывается его обработчик сбоя (например,
+ *   закрывающий только это подключение)
+ *
+ * @warning add()/modify()/remove() вызываются только из потока цикла
+ * @threadsafe post() и stop() можно вызывать из любого потока
+ */
+class EventLoop
+{
+public:
+  /// Обработчик событий дескриптора (маска epoll)
+  using Callback = std::function<void(uint32_t events)>;
+  /// Реакция на исключение из Callback: освободить то, чему принадлежит дескриптор
+  using FailureHandler = std::function<void()>;
+  /// Задача, выполняемая в потоке цикла (небольшие замыкания — без выделения памяти)
+  using Task = InlineTask;
+
+  /**
+   * @brief Создает epoll-дескриптор и eventfd для пробуждения
+   * @throws runtime_error Если системные вызовы завершились ошибкой
+   */
+  EventLoop();
+
+  /// @brief Закрывает служебные дескрипторы (зарегистрированные fd не закрываются)
+  ~EventLoop();
+
+  EventLoop(const EventLoop &) = delete;
+  EventLoop &operator=(const EventLoop &) = delete;
+
+  /**
+   * @brief Зарегистрировать дескриптор
+   * @param fd Файловый дескриптор
+   * @param events Маска событий epoll (EPOLLIN, EPOLLOUT, EPOLLET ...)
+   * @param callback Обработчик, вызываемый в потоке цикла
+   * @param on_failure Вызывается, если callback бросил исключение (nullptr —
+   * только запись в журнал; дескриптор остается зарегистрированным)
+   * @throws runtime_error Если epoll_ctl завершился ошибкой
+   */
+  void add(int fd, uint32_t events, Callback callback, FailureHandler on_failure = nullptr);
+
+  /**
+   * @brief Изменить маску событий уже зарегистрированного дескриптора
+   * @throws runtime_error Если epoll_ctl завершился ошибкой
+   */
+  void modify(int fd, uint32_t events);
+
+  /**
+   * @brief Снять дескриптор с наблюдения
+   * @note События, уже полученные в текущей итерации, для него не вызываются
+   */
+  void remove(int fd);
+
+  /**
+   * @brief Выполнить задачу в потоке цикла
+   * @param task Задача
+   * @threadsafe Может вызываться из любого потока
+   */
+  void post(Task task);
+
+  /**
+   * @brief Задать действие, выполняемое перед каждым ожиданием событий
+   * @param hook Действие (nullptr — снять)
+   * @note Используется для пакетной отправки накопленной за итерацию работы
+   */
+  void set_before_poll(Task hook) { before_poll_ = std::move(hook); }
+
+  /**
+   * @brief Основной цикл; возвращает управление после stop()
+   * @throws runtime_error Только при отказе самого epoll_wait или обработчика сбоя:
+   * такой цикл продолжать нельзя
+   */
+  void run();
+
+  /**
+   * @brief Запросить остановку цикла
+   * @threadsafe Может вызываться из любого потока
+   */
+  void stop();
+
+  /// @brief true, если вызов выполняется в потоке цикла
+  bool in_loop_thread() const noexcept { return owner_.load() == std::this_thread::get_id(); }
+
+private:
+  /// Регистрация дескриптора; адрес передается в epoll_event.data.ptr
+  struct Watch
+  {
+    int fd;
+    Callback callback;
+    FailureHandler on_failure;
+  };
+
+  int epoll_fd_ = -1;                                         ///< Дескриптор epoll
+  int wake_fd_ = -1;                                          ///< eventfd для пробуждения из других потоков
+  std::atomic<bool> running_;                                 ///< Флаг работы цикла
+  std::atomic<std::thread::id> owner_;                        ///< Поток, выполняющий run()
+  std::unordered_map<int, std::unique_ptr<Watch>> watches_;   ///< Зарегистрированные дескрипторы
+  std::vector<std::unique_ptr<Watch>> retired_;               ///< Снятые в текущей итерации регистрации
+  std::mutex tasksMutex_;                                     ///< Мьютекс очереди задач
+  std::vector<Task> tasks_;                                   ///< Задачи от других потоков
+  std::vector<Task> batch_;                                   ///< Выполняемая пачка задач (буфер переиспользуется)
+  Task before_poll_;                                          ///< Действие перед epoll_wait
+
+  /// @brief Разбудить поток цикла
+  void wakeup();
+
+  /// @brief Выполнить накопленные задачи
+  void run_pending_tasks();
+
+  /// @brief Вызвать обработчик дескриптора, перехватив его исключение
+  void dispatch(Watch &watch, uint32_t events);
+};
@@ -0,0 +1,138 @@
+/**
+ * @file inline_task.h
+ * @brief Задача цикла событий без выделения памяти для небольших замыканий
+ * @ingroup ServerCore
+ */
+
+#pragma once
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "../include/memory/block_pool.h"
+
+/**
+ * @class InlineTask
+ * @brief Перемещаемая обертка над void() с замыканием внутри объекта
+ *
+ * @details std::function хранит внутри лишь замыкание размером с пару
+ * указателей, поэтому каждая задача рассылки между шардами (шард, отправитель,
+ * комната, сообщение) стоила аллокацию. InlineTask держит замыкание до
+ * kInlineSize байт в себе; большее кладется в блок BlockPool. Копирования
+ * нет: задача выполняется один раз.
+ */
+class InlineTask
+{
+public:
+  /// Наибольшее замыкание, хранимое без выделения памяти
+  static constexpr size_t kInlineSize = 64;
+
+  InlineTask() noexcept = default;
+
+  /// @brief Принять замыкание void()
+  template <typename Fn, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Fn>, InlineTask>>>
+  InlineTask(Fn &&fn)
+  {
+    using Stored = std::decay_t<Fn>;
+    static_assert(std::is_invocable_r_v<void, Stored &>, "task must be callable as void()");
+    if constexpr (fits<Stored>())
+    {
+      new (storage_) Stored(std::forward<Fn>(fn));
+      ops_ = &kInlineOps<Stored>;
+    }
+    else
+    {
+      void *block = BlockPool::allocate(sizeof(Stored));
+      try
+      {
+        new (block) Stored(std::forward<Fn>(fn));
+      }
+      catch (...)
+      {
+        BlockPool::deallocate(block, sizeof(Stored));
+        throw;
+      }
+      *reinterpret_cast<void **>(storage_) = block;
+      ops_ = &kPooledOps<Stored>;
+    }
+  }
+
+  InlineTask(InlineTask &&other) noexcept : ops_(std::exchange(other.ops_, nullptr))
+  {
+    if (ops_)
+      ops_->move(other.storage_, storage_);
+  }
+
+  InlineTask &operator=(InlineTask &&other) noexcept
+  {
+    if (this != &other)
+    {
+      reset();
+      ops_ = std::exchange(other.ops_, nullptr);
+      if (ops_)
+        ops_->move(other.storage_, storage_);
+    }
+    return *this;
+  }
+
+  InlineTask(std::nullptr_t) noexcept {}
+
+  ~InlineTask() { reset(); }
+
+  /// @brief Выполнить задачу
+  void operator()() { ops_->call(storage_); }
+
+  /// @brief true, если задача задана
+  explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+private:
+  /// Операции над хранимым замыканием
+  struct Ops
+  {
+    void (*call)(void *storage);
+    void (*move)(void *from, void *to) noexcept; ///< Перенести и разрушить источник
+    void (*destroy)(void *storage) noexcept;
+  };
+
+  template <typename Stored>
+  static constexpr bool fits()
+  {
+    return sizeof(Stored) <= kInlineSize && alignof(Stored) <= alignof(std::max_align_t) &&
+           std::is_nothrow_move_constructible_v<Stored>;
+  }
+
+  template <typename Stored>
+  static constexpr Ops kInlineOps{
+      [](void *storage)
+      { (*static_cast<Stored *>(storage))(); },
+      [](void *from, void *to) noexcept
+      {
+        new (to) Stored(std::move(*static_cast<Stored *>(from)));
+        static_cast<Stored *>(from)->~Stored();
+      },
+      [](void *storage) noexcept
+      { static_cast<Stored *>(storage)->~Stored(); }};
+
+  template <typename Stored>
+  static constexpr Ops kPooledOps{
+      [](void *storage)
+      { (**static_cast<Stored **>(storage))(); },
+      [](void *from, void *to) noexcept
+      { *static_cast<void **>(to) = *static_cast<void **>(from); },
+      [](void *storage) noexcept
+      {
+        Stored *stored = *static_cast<Stored **>(storage);
+        stored->~Stored();
+        BlockPool::deallocate(stored, sizeof(Stored));
+      }};
+
+  alignas(std::max_align_t) unsigned char storage_[kInlineSize]; ///< Замыкание или указатель на него
+  const Ops *ops_ = nullptr;                                     ///< nullptr — задачи нет
+
+  void reset() noexcept
+  {
+    if (ops_)
+      ops_->destroy(storage_);
+    ops_ = nullptr;
+  }
+};
@@ -0,0 +1,88 @@
+/**
+ * @file io_backend.h
+ * @brief Базовый интерфейс ввода-вывода клиентских подключений шарда
+ * @ingroup ServerCore
+ */
+
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include "../include/net/connection/connection.h"
+#include "../include/net/reactor/event_loop.h"
+#include "../include/net/reactor/write_coalescer.h"
+
+/// Доступные реализации ввода-вывода
+enum class IoBackendKind
+{
+  Epoll, ///< Готовность через epoll, recv/send на каждую операцию
+  Uring  ///< io_uring: multishot recv, кольцо буферов, пакетная отправка
+};
+
+/**
+ * @class IIoBackend
+ * @brief Абстрактный класс чтения и записи клиентских сокетов одного шарда
+ *
+ * @details Обязанности:
+ *  - Получать данные подключения и передавать их обработчику сообщений
+ *  - Доставлять исходящие данные с учетом частичной записи
+ *  - Сообщать о закрытии подключения
+ *
+ * @warning Все методы вызываются только из потока цикла событий шарда
+ * @see EpollBackend, UringBackend - реализации
+ */
+class IIoBackend
+{
+public:
+  /// Обработчик принятых данных (данные накоплены в Connection::framer())
+  using DataHandler = std::function<void(const std::shared_ptr<Connection> &)>;
+  /// Обработчик закрытия подключения (вызывает detach() и закрывает сокет)
+  using CloseHandler = std::function<void(const std::shared_ptr<Connection> &)>;
+  /// Неизменяемые данные для отправки, разделяемые между получателями
+  using Payload = Connection::Payload;
+
+  /// @brief Название реализации для логов
+  virtual const char *name() const noexcept = 0;
+
+  /**
+   * @brief Начать обслуживание подключения
+   * @param client Подключение (сокет в неблокирующем режиме)
+   */
+  virtual void attach(const std::shared_ptr<Connection> &client) = 0;
+
+  /**
+   * @brief Прекратить обслуживание подключения
+   * @param client Подключение
+   * @note Вызывается до закрытия сокета
+   */
+  virtual void detach(const std::shared_ptr<Connection> &client) = 0;
+
+  /**
+   * @brief Поставить данные в очередь отправки подключения
+   * @param client Получатель
+   * @param data Данные (могут разделяться между получателями)
+   * @note Не делает системных вызовов на получателя: очередь дописывается
+   * асинхронно, ошибка записи приводит к вызову обработчика закрытия
+   */
+  virtual void send(const std::shared_ptr<Connection> &client, Payload data) = 0;
+
+  /**
+   * @brief Виртуальный деструктор
+   * @note Гарантирует корректное удаление производных классов
+   */
+  virtual ~IIoBackend() = default;
+};
+
+/**
+ * @brief Создать реализацию ввода-вывода для шарда
+ * @param kind Желаемая реализация
+ * @param loop Цикл событий шарда
+ * @param on_data Обработчик принятых данных
+ * @param on_close Обработчик закрытия подключения
+ * @param coalescing Параметры объединения записей
+ * @return Запрошенная реализация или EpollBackend, если ядро не поддерживает io_uring
+ */
+std::unique_ptr<IIoBackend> make_io_backend(IoBackendKind kind, EventLoop &loop,
+                                            IIoBackend::DataHandler on_data,
+                                            IIoBackend::CloseHandler on_close,
+                                            WriteCoalescing coalescing = WriteCoalescing());
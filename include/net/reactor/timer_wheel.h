@@ -0,0 +1,142 @@
+/**
+ * @file timer_wheel.h
+ * @brief Иерархическое колесо таймеров цикла событий
+ * @ingroup ServerCore
+ */
+
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include "../include/net/reactor/event_loop.h"
+
+class TimerWheel;
+
+/**
+ * @class Timer
+ * @brief Таймер, встраиваемый в объект-владелец (без выделения памяти при взводе)
+ *
+ * @details Узел двусвязного кольцевого списка ячейки колеса: взвод и отмена —
+ * перестановка указателей, O(1). Разрушение взведенного таймера снимает его.
+ *
+ * @warning Используется только из потока цикла, которому принадлежит колесо
+ */
+class Timer
+{
+public:
+  Timer() = default;
+  ~Timer() { cancel(); }
+
+  Timer(const Timer &) = delete;
+  Timer &operator=(const Timer &) = delete;
+
+  std::function<void()> callback; ///< Вызывается при срабатывании (таймер к этому моменту снят)
+
+  /// @brief true, если таймер взведен
+  bool armed() const noexcept { return next_ != nullptr; }
+
+  /// @brief Снять таймер (ничего не делает, если он не взведен)
+  void cancel() noexcept;
+
+private:
+  friend class TimerWheel;
+
+  Timer *prev_ = nullptr;        ///< Предыдущий узел списка ячейки
+  Timer *next_ = nullptr;        ///< Следующий узел списка ячейки
+  TimerWheel *wheel_ = nullptr;  ///< Колесо, в котором взведен таймер
+  uint64_t expires_ = 0;         ///< Тик срабатывания
+};
+
+/**
+ * @class TimerWheel
+ * @brief Хешированное иерархическое колесо таймеров (kLevels уровней по kSlots ячеек)
+ *
+ * @details Время делится на тики длительностью tick. Таймер со сроком меньше
+ * kSlots тиков попадает в ячейку нижнего уровня, более дальний — в ячейку
+ * верхнего уровня и по мере приближения срока переносится вниз. Взвод,
+ * перевзвод и отмена — O(1) без выделения памяти, продвижение на один тик —
+ * обход одной ячейки. При 100 мс на тик четыре уровня по 64 ячейки покрывают
+ * больше 19 суток; более дальние сроки ограничиваются этим пределом.
+ *
+ * Колесо продвигает timerfd, зарегистрированный в цикле событий: пока
+ * взведен хотя бы один таймер, он срабатывает каждый тик, пустое колесо
+ * цикл не будит. Поэтому колесо работает с любым IIoBackend поверх EventLoop.
+ *
+ * @warning Используется только из потока цикла событий
+ */
+class TimerWheel
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr unsigned kSlotBits = 6;               ///< log2 ячеек уровня
+  static constexpr size_t kSlots = size_t(1) << kSlotBits; ///< Ячеек на уровне
+  static constexpr size_t kLevels = 4;                   ///< Уровней
+
+  /**
+   * @brief Конструктор
+   * @param loop Цикл событий (для timerfd)
+   * @param tick Длительность тика (точность срабатывания)
+   * @throws runtime_error Если не удалось создать timerfd
+   */
+  TimerWheel(EventLoop &loop, std::chrono::milliseconds tick);
+
+  /// @brief Снимает все таймеры, отключает timerfd от цикла
+  ~TimerWheel();
+
+  TimerWheel(const TimerWheel &) = delete;
+  TimerWheel &operator=(const TimerWheel &) = delete;
+
+  /**
+   * @brief Взвести таймер (перевзвести, если уже взведен)
+   * @param timer Таймер
+   * @param deadline Срок; прошедший срок сработает на ближайшем тике
+   */
+  void arm(Timer &timer, Clock::time_point deadline);
+
+  /**
+   * @brief Взвести таймер, если он не взведен или взведен на более поздний срок
+   * @param timer Таймер
+   * @param deadline Срок
+   */
+  void arm_before(Timer &timer, Clock::time_point deadline);
+
+  /// @brief Время последнего продвижения колеса
+  Clock::time_point now() const noexcept { return now_; }
+
+  /// @brief Количество взведенных таймеров
+  size_t size() const noexcept { return count_; }
+
+  /**
+   * @brief Продвинуть колесо до момента now и вызвать наступившие таймеры
+   * @param now Текущее время
+   */
+  void advance(Clock::time_point now);
+
+private:
+  friend class Timer;
+
+  EventLoop &loop_;                 ///< Цикл событий
+  std::chrono::nanoseconds tick_;   ///< Длительность тика
+  Clock::time_point origin_;        ///< Момент тика 0
+  Clock::time_point now_;           ///< Время последнего продвижения
+  uint64_t current_ = 0;            ///< Последний обработанный тик
+  size_t count_ = 0;                ///< Взведено таймеров
+  int timer_fd_ = -1;               ///< timerfd, продвигающий колесо
+  bool ticking_ = false;            ///< timerfd запущен
+  std::array<std::array<Timer, kSlots>, kLevels> slots_; ///< Головы списков ячеек
+
+  /// @brief Номер тика для момента времени (с округлением вверх)
+  uint64_t tick_of(Clock::time_point when) const noexcept;
+
+  /// @brief Поместить таймер в ячейку по его expires_
+  void insert(Timer &timer) noexcept;
+
+  /// @brief Обработать следующий тик: перенести ячейки верхних уровней и вызвать наступившие
+  void step();
+
+  /// @brief Запустить или остановить timerfd
+  void set_ticking(bool ticking);
+};
@@ -0,0 +1,160 @@
+/**
+ * @file uring_backend.h
+ * @brief Ввод-вывод подключений через io_uring
+ * @ingroup ServerCore
+ */
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <linux/io_uring.h>
+#include "../include/net/reactor/io_backend.h"
+
+/**
+ * @class UringBackend
+ * @brief Реализация IIoBackend на io_uring (без liburing, через системные вызовы)
+ *
+ * @details Особенности:
+ * - На каждое подключение ставится один multishot recv, данные приходят
+ *   в буферы из зарегистрированного кольца (provided buffer ring)
+ * - Подключения с новыми данными копятся в списке на запись (WriteCoalescer);
+ *   перед ожиданием событий на каждое ставится одна отправка всей очереди,
+ *   и все отправки уходят в ядро одним io_uring_enter: рассылка N клиентам —
+ *   один системный вызов
+ * - Завершения читаются из CQ, когда дескриптор кольца готов в epoll шарда
+ * - На подключение в полете не больше одной отправки: порядок байт сохраняется
+ *   и при частичной записи
+ *
+ * @note Требует ядро 6.0+ (multishot recv и кольца буферов); create() проверяет
+ * multishot recv пробным запросом и на более старом ядре возвращает nullptr
+ */
+class UringBackend : public IIoBackend
+{
+public:
+  /**
+   * @brief Создать backend
+   * @param loop Цикл событий шарда
+   * @param on_data Обработчик принятых данных
+   * @param on_close Обработчик закрытия подключения
+   * @param coalescing Параметры объединения записей
+   * @return Backend или nullptr, если ядро не поддерживает нужные возможности
+   */
+  static std::unique_ptr<UringBackend> create(EventLoop &loop, DataHandler on_data, CloseHandler on_close,
+                                              WriteCoalescing coalescing);
+
+  /// @brief Освобождает кольца и буферы
+  ~UringBackend() override;
+
+  UringBackend(const UringBackend &) = delete;
+  UringBackend &operator=(const UringBackend &) = delete;
+
+  const char *name() const noexcept override { return "io_uring"; }
+  void attach(const std::shared_ptr<Connection> &client) override;
+  void detach(const std::shared_ptr<Connection> &client) override;
+  void send(const std::shared_ptr<Connection> &client, Payload data) override;
+
+private:
+  /// Тип операции в младших битах user_data
+  enum Op : uint64_t
+  {
+    OpRecv = 1,
+    OpSend = 2,
+    OpCancel = 3
+  };
+
+  /// Состояние подключения, пока на него есть операции в ядре
+  struct Link
+  {
+    std::shared_ptr<Connection> client; ///< Подключение
+    int fd;                             ///< Дескриптор на момент attach
+    iovec iov[Connection::kMaxIov];     ///< Фрагменты отправки в ядре
+    msghdr hdr{};                       ///< Заголовок отправки в ядре
+    bool receiving = false;             ///< Взведен multishot recv
+    bool sending = false;               ///< В ядре есть отправка
+    bool detached = false;              ///< detach() уже вызван
+  };
+
+  EventLoop &loop_;       ///< Цикл событий шарда
+  DataHandler on_data_;   ///< Обработчик принятых данных
+  CloseHandler on_close_; ///< Обработчик закрытия
+  WriteCoalescer dirty_;  ///< Подключения с новыми данными в очереди
+
+  int ring_fd_ = -1;            ///< Дескриптор io_uring
+  void *ring_ptr_ = nullptr;    ///< Общая проекция SQ и CQ колец
+  size_t ring_size_ = 0;        ///< Размер проекции колец
+  io_uring_sqe *sqes_ = nullptr; ///< Массив SQE
+  size_t sqes_size_ = 0;        ///< Размер проекции SQE
+
+  unsigned *sq_head_ = nullptr;  ///< Голова SQ (пишет ядро)
+  unsigned *sq_tail_ = nullptr;  ///< Хвост SQ (пишем мы)
+  unsigned *sq_flags_ = nullptr; ///< Флаги SQ (IORING_SQ_CQ_OVERFLOW)
+  unsigned *sq_array_ = nullptr; ///< Индексы SQE
+  unsigned sq_mask_ = 0;         ///< Маска SQ
+  unsigned sq_entries_ = 0;      ///< Размер SQ
+  unsigned *cq_head_ = nullptr;  ///< Голова CQ (пишем мы)
+  unsigned *cq_tail_ = nullptr;  ///< Хвост CQ (пишет ядро)
+  unsigned cq_mask_ = 0;         ///< Маска CQ
+  io_uring_cqe *cqes_ = nullptr; ///< Массив CQE
+  unsigned sq_local_tail_ = 0;   ///< Хвост SQ с учетом неопубликованных SQE
+  unsigned to_submit_ = 0;       ///< Подготовлено, но не отправлено в ядро
+  std::vector<io_uring_sqe> backlog_; ///< SQE, не поместившиеся в SQ; переносятся в нее по мере освобождения
+  bool reaping_ = false;         ///< Идет разбор CQE (повторный вход в complete() запрещен)
+
+  io_uring_buf *buf_ring_ = nullptr; ///< Кольцо буферов приема
+  size_t buf_ring_size_ = 0;         ///< Размер проекции кольца буферов
+  char *buffers_ = nullptr;          ///< Память буферов приема
+  uint16_t buf_tail_ = 0;            ///< Хвост кольца буферов
+
+  std::unordered_map<uint64_t, std::unique_ptr<Link>> links_; ///< Подключения по идентификатору
+  std::unordered_map<const Connection *, uint64_t> ids_;      ///< Идентификатор по подключению
+  uint64_t next_id_ = 1;                                      ///< Следующий идентификатор
+
+  UringBackend(EventLoop &loop, DataHandler on_data, CloseHandler on_close, WriteCoalescing coalescing);
+
+  /// @brief Настроить кольца; false если io_uring недоступен
+  bool setup();
+
+  /// @brief Проверить пробным запросом, что ядро поддерживает multishot recv
+  bool probe_multishot_recv();
+
+  /**
+   * @brief Получить свободный SQE
+   * @details При заполненной SQ сначала отправляет накопленное; если ядро
+   * не принимает SQE (переполнена CQ), SQE встает в backlog_ и уходит при
+   * следующем submit(). Не бросает исключений, кроме std::bad_alloc.
+   */
+  io_uring_sqe *get_sqe();
+
+  /**
+   * @brief Передать подготовленные SQE ядру (сначала перенеся backlog_ в SQ)
+   * @details На EBUSY/EAGAIN (ядро не может отложить завершения) разбирает
+   * CQE и повторяет; неотправленное остается до следующего вызова
+   */
+  void submit();
+
+  /// @brief Поставить отправки подключений из списка на запись и передать SQE ядру
+  void flushPending();
+
+  /// @brief Разобрать все готовые CQE; true, если разобран хотя бы один
+  bool complete();
+
+  /// @brief Взвести multishot recv
+  void arm_recv(uint64_t id, Link &link);
+
+  /// @brief Поставить в SQ отправку головы очереди
+  void send_next(uint64_t id, Link &link);
+
+  void handle_recv(uint64_t id, const io_uring_cqe &cqe);
+  void handle_send(uint64_t id, const io_uring_cqe &cqe);
+
+  /// @brief Вернуть буфер в кольцо
+  void recycle(uint16_t bid);
+
+  /// @brief Закрыть подключение, если оно ждало опустошения очереди
+  void close_if_drained(Link &link);
+
+  /// @brief Удалить состояние отсоединенного подключения без операций в ядре
+  void release_if_idle(uint64_t id);
+};
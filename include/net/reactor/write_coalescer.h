@@ -0,0 +1,117 @@
+/**
+ * @file write_coalescer.h
+ * @brief Список подключений на запись с ограничением задержки
+ * @ingroup ServerCore
+ */
+
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "../include/net/connection/connection.h"
+#include "../include/net/reactor/event_loop.h"
+
+/// Параметры объединения записей
+struct WriteCoalescing
+{
+  std::chrono::microseconds max_delay{200}; ///< Наибольшая задержка отправки ради объединения; 0 — каждую итерацию
+  size_t max_bytes = 16 * 1024;             ///< Очередь такого размера отправляется без ожидания
+};
+
+/**
+ * @class WriteCoalescer
+ * @brief Откладывает запись в сокет, чтобы отправить несколько сообщений одним вызовом
+ *
+ * @details Подключение с новыми данными попадает в список один раз. Список
+ * разбирается перед ожиданием событий: если подключению недавно (меньше
+ * max_delay назад) уже писали, а очередь меньше max_bytes, запись
+ * откладывается до истечения max_delay с момента прошлой записи. Первое
+ * сообщение после паузы уходит сразу, так что при редком трафике задержки
+ * нет, а при частом на одно подключение приходится не больше одной записи
+ * за max_delay. Пробуждение к сроку — через timerfd, зарегистрированный
+ * в цикле шарда; таймер перевзводится, только если срок стал раньше.
+ *
+ * @warning Используется только из потока цикла событий
+ */
+class WriteCoalescer
+{
+public:
+  /**
+   * @brief Конструктор
+   * @param loop Цикл событий шарда (для таймера)
+   * @param options Параметры объединения
+   * @throws runtime_error Если не удалось создать timerfd
+   */
+  WriteCoalescer(EventLoop &loop, WriteCoalescing options);
+
+  /// @brief Снимает таймер с цикла и закрывает его
+  ~WriteCoalescer();
+
+  WriteCoalescer(const WriteCoalescer &) = delete;
+  WriteCoalescer &operator=(const WriteCoalescer &) = delete;
+
+  /**
+   * @brief Запомнить подключение с новыми данными в очереди
+   * @param client Подключение
+   */
+  void add(const std::shared_ptr<Connection> &client)
+  {
+    if (client->schedule_flush())
+      dirty_.push_back(client);
+  }
+
+  /**
+   * @brief Записать подключения, чей срок наступил
+   * @param flush Действие void(const std::shared_ptr<Connection> &) — запись очереди
+   * @note Остальные подключения остаются в списке до своего срока
+   */
+  template <typename Fn>
+  void drain(Fn &&flush)
+  {
+    if (dirty_.empty())
+      return;
+
+    std::vector<std::shared_ptr<Connection>> dirty;
+    dirty.swap(dirty_);
+    auto now = std::chrono::steady_clock::now();
+    auto earliest = std::chrono::steady_clock::time_point::max();
+    for (auto &client : dirty)
+    {
+      auto due = client->last_flush() + options_.max_delay;
+      if (due > now && client->pending_bytes() < options_.max_bytes && client->socket()->is_valid())
+      {
+        // Подключение ждет своего срока, flush_scheduled остается взведенным
+        earliest = std::min(earliest, due);
+        dirty_.push_back(std::move(client));
+        continue;
+      }
+      client->clear_flush_scheduled();
+      client->set_last_flush(now);
+      flush(client);
+    }
+    if (earliest != std::chrono::steady_clock::time_point::max())
+      arm(earliest, now);
+
+    // Буфер списка переиспользуется между итерациями
+    dirty.clear();
+    if (dirty_.empty())
+      dirty_.swap(dirty);
+  }
+
+private:
+  EventLoop &loop_;                                ///< Цикл событий шарда
+  WriteCoalescing options_;                        ///< Параметры объединения
+  int timer_fd_ = -1;                              ///< timerfd для пробуждения к сроку
+  std::chrono::steady_clock::time_point armed_;    ///< Срок, на который взведен таймер
+  bool timer_armed_ = false;                       ///< Таймер взведен и еще не сработал
+  std::vector<std::shared_ptr<Connection>> dirty_; ///< Подключения с новыми данными в очереди
+
+  /**
+   * @brief Взвести таймер на срок, если он раньше уже взведенного
+   * @param deadline Срок
+   * @param now Текущее время
+   */
+  void arm(std::chrono::steady_clock::time_point deadline, std::chrono::steady_clock::time_point now);
+};
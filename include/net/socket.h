@@ -23,11 +23,15 @@
 class Socket
 {
 private:
-  int fd_ = -1;                ///< Дескриптор сокета (-1 если невалиден)
-  struct sockaddr_in servaddr; ///< Структура для хранения адреса сервера (IPv4)
+  int fd_ = -1; ///< Дескриптор сокета (-1 если невалиден)
 
-  struct sockaddr_in6 servaddr6; ///< Структура для хранения адреса сервера (IPv6)
-  SocketConfig config_;          ///< < Конфигурационные настройки сокета
+  /// Адрес сервера: используется только член семейства config_.domain_
+  union
+  {
+    struct sockaddr_in servaddr;   ///< Структура для хранения адреса сервера (IPv4)
+    struct sockaddr_in6 servaddr6; ///< Структура для хранения адреса сервера (IPv6)
+  };
+  SocketConfig config_; ///< < Конфигурационные настройки сокета
 
 public:
   /**
@@ -82,7 +86,7 @@ public:
    * @brief Переводит сокет в режим прослушивания входящих соединений.
    *
    * @param backlog Максимальное количество ожидающий подключений, которое сервер может принять (по умолчанию 5)
-   * @warning backlog не должен превышать 1024
+   * @note Ядро урезает backlog до net.core.somaxconn
    */
   void listen_socket(int backlog = 5);
 
@@ -97,6 +101,32 @@ public:
    */
   Socket accept_socket(struct sockaddr *addr = NULL, socklen_t *addrlen = NULL);
 
+  /**
+   * @brief Неблокирующий вариант accept без исключений
+   *
+   * Используется циклом событий: пустая очередь подключений — штатная ситуация.
+   * Принятый сокет сразу неблокирующий и закрывается при exec (accept4 с
+   * SOCK_NONBLOCK | SOCK_CLOEXEC), отдельный fcntl не нужен.
+   *
+   * @param addr Адрес клиента (по умолчанию NULL)
+   * @param addrlen Длина структуры адреса клиента
+   * @return Дескриптор принятого соединения или -1 (errno установлен, EAGAIN — очередь пуста)
+   */
+  int try_accept(struct sockaddr *addr = NULL, socklen_t *addrlen = NULL) noexcept;
+
+  /**
+   * @brief Переводит сокет в неблокирующий режим (O_NONBLOCK)
+   */
+  void set_nonblocking();
+
+  /**
+   * @brief Разрешает нескольким сокетам слушать один адрес и порт (SO_REUSEPORT)
+   *
+   * Ядро распределяет входящие подключения между такими сокетами.
+   * @warning Вызывается до bind_socket()
+   */
+  void set_reuseport();
+
   /**
    * @brief Осуществляет подключенние к удаленному серверу по заданному адресу и порту.
    */
@@ -0,0 +1,206 @@
+/**
+ * @file message_log.h
+ * @brief Долговременный журнал сообщений из сегментов только для дозаписи
+ * @defgroup Storage Хранение сообщений
+ */
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "../include/net/connection/message_buffer.h"
+
+/**
+ * @class MessageLog
+ * @brief Журнал сообщений на диске: запись отдельным потоком с групповой фиксацией
+ *
+ * @details Каждое сообщение получает порядковый номер (seq) и ставится в
+ * очередь без копирования (MessageRef) — вызывающий поток не касается диска.
+ * Поток записи забирает всю накопившуюся очередь, сериализует ее в один
+ * буфер, пишет одним pwrite и фиксирует одним fdatasync: пока идет
+ * fdatasync, копится следующая пачка, поэтому число синхронизаций
+ * подстраивается под нагрузку, а не под число сообщений.
+ *
+ * Журнал — каталог сегментов `<первый seq>.log` размером до segment_bytes.
+ * Запись сегмента: заголовок (размер, CRC32, seq, время), имя комнаты и
+ * тело. Рядом с сегментом лежит разреженный индекс `<первый seq>.idx`:
+ * пара (seq, смещение) на каждые index_interval байт. Чтение по номеру —
+ * выбор сегмента, двоичный поиск в индексе и просмотр не больше
+ * index_interval байт сегмента, отображенного через mmap.
+ *
+ * Восстановление после сбоя проверяет CRC только последнего сегмента,
+ * отрезает недописанный хвост и перестраивает его индекс; остальные
+ * сегменты закрыты и берутся как есть. Граница целых записей — неверный
+ * размер или CRC; пропуск номеров (сообщения, не записанные до остановки)
+ * границей не считается.
+ *
+ * Пачка, которую не удалось записать или зафиксировать (ENOSPC, EIO),
+ * не теряется: поток записи повторяет ее с нарастающей паузой, добавляя
+ * новые сообщения, а committed_seq() не сдвигается, пока она не
+ * зафиксирована. Повторяемая пачка входит в предел max_pending_bytes,
+ * поэтому при долгом сбое новые сообщения отбрасываются. Если журнал
+ * останавливают во время сбоя, после последней попытки незаписанные
+ * сообщения теряются, и sync() сообщает об этом.
+ *
+ * @threadsafe append(), sync() и read() можно вызывать из любого потока
+ */
+class MessageLog
+{
+public:
+  /// Параметры журнала
+  struct Options
+  {
+    size_t segment_bytes = 64 * 1024 * 1024;    ///< Размер сегмента, после которого начинается новый
+    size_t index_interval = 4096;               ///< Шаг разреженного индекса, байт сегмента
+    size_t max_pending_bytes = 64 * 1024 * 1024; ///< Предел очереди на запись; сверх него сообщения отбрасываются
+  };
+
+  /// Сообщение, прочитанное из журнала (участки действительны только внутри вызова посетителя)
+  struct Record
+  {
+    uint64_t seq = 0;      ///< Порядковый номер
+    uint64_t time_ns = 0;  ///< Время постановки в журнал (system_clock), нс
+    std::string_view room; ///< Комната (пусто — рассылка всем)
+    std::string_view body; ///< Текст сообщения
+  };
+
+  /// Посетитель прочитанных сообщений
+  using Visitor = std::function<void(const Record &record)>;
+
+  /**
+   * @brief Открыть журнал (и восстановить после сбоя) и запустить поток записи
+   * @param dir Каталог сегментов (создается, если его нет)
+   * @param options Параметры
+   * @throws std::runtime_error если каталог или сегмент не удалось открыть
+   */
+  MessageLog(std::string dir, Options options);
+
+  /// @brief Открыть журнал с параметрами по умолчанию
+  explicit MessageLog(std::string dir) : MessageLog(std::move(dir), Options()) {}
+
+  /// @brief Фиксирует оставшиеся сообщения и останавливает поток записи
+  ~MessageLog();
+
+  MessageLog(const MessageLog &) = delete;
+  MessageLog &operator=(const MessageLog &) = delete;
+
+  /**
+   * @brief Поставить сообщение в журнал
+   * @param room Имя комнаты (пустая ссылка — рассылка всем)
+   * @param body Текст сообщения
+   * @return false, если очередь на запись переполнена и сообщение отброшено
+   */
+  bool append(const MessageRef &room, const MessageRef &body);
+
+  /**
+   * @brief Дождаться фиксации всех сообщений, поставленных до вызова
+   * @return false, если журнал остановлен, так и не записав часть из них
+   */
+  bool sync();
+
+  /**
+   * @brief Прочитать зафиксированные сообщения начиная с номера
+   * @param from Первый номер
+   * @param max Наибольшее число сообщений
+   * @param visitor Вызывается для каждого сообщения по порядку
+   * @return Количество прочитанных сообщений
+   * @throws std::runtime_error если сегмент не удалось отобразить
+   */
+  size_t read(uint64_t from, size_t max, const Visitor &visitor) const;
+
+  /// @brief Номер первого сообщения в журнале
+  uint64_t first_seq() const;
+
+  /// @brief Все сообщения с меньшими номерами зафиксированы на диске
+  uint64_t committed_seq() const noexcept { return committed_.load(std::memory_order_acquire); }
+
+private:
+  /// Сообщение в очереди на запись
+  struct Pending
+  {
+    uint64_t seq;     ///< Номер
+    uint64_t time_ns; ///< Время постановки
+    MessageRef room;  ///< Комната
+    MessageRef body;  ///< Текст
+    size_t bytes;     ///< Размер записи (учет max_pending_bytes)
+  };
+
+  /// Запись разреженного индекса (в файле .idx — подряд, как в памяти)
+  struct IndexEntry
+  {
+    uint64_t seq;    ///< Номер сообщения
+    uint64_t offset; ///< Смещение его записи в сегменте
+  };
+
+  /// Сегмент журнала
+  struct Segment
+  {
+    uint64_t base = 0;             ///< Номер первого сообщения
+    std::string path;              ///< Файл сегмента
+    size_t size = 0;               ///< Зафиксированный размер, байт
+    std::vector<IndexEntry> index; ///< Записи с шагом index_interval
+  };
+
+  std::string dir_;  ///< Каталог журнала
+  Options options_;  ///< Параметры
+
+  mutable std::mutex segments_mutex_; ///< Защищает segments_ (читатели и поток записи)
+  std::vector<Segment> segments_;     ///< Сегменты по возрастанию base; последний — активный
+
+  std::mutex mutex_;                    ///< Защищает очередь, next_seq_ и stopping_
+  std::condition_variable ready_;       ///< Появились сообщения или запрошена остановка
+  std::condition_variable committed_cv_; ///< Продвинулся committed_
+  std::vector<Pending> pending_;        ///< Очередь на запись
+  size_t pending_bytes_ = 0;            ///< Размер очереди и повторяемой пачки, байт
+  uint64_t next_seq_ = 0;               ///< Номер следующего сообщения
+  bool stopping_ = false;               ///< Запрошена остановка
+  bool lost_ = false;                   ///< Поток записи остановлен с незафиксированными сообщениями
+  std::atomic<uint64_t> committed_{0};  ///< Граница зафиксированных номеров
+
+  int fd_ = -1;          ///< Файл активного сегмента (только поток записи)
+  int index_fd_ = -1;    ///< Файл индекса активного сегмента
+  size_t written_ = 0;   ///< Записано в активный сегмент, байт
+  size_t next_index_ = 0; ///< Смещение, с которого добавляется следующая запись индекса
+  std::string buffer_;   ///< Сериализованная пачка
+  std::vector<IndexEntry> new_index_; ///< Записи индекса пачки
+  std::thread writer_;   ///< Поток записи
+
+  /// @brief Найти сегменты, проверить последний и открыть его для дозаписи
+  void recover();
+
+  /**
+   * @brief Просмотреть сегмент и проверить записи
+   * @param segment Сегмент (заполняются size и index)
+   * @param data Содержимое файла
+   * @param len Длина файла
+   * @return Номер, следующий за последней целой записью
+   */
+  uint64_t scan(Segment &segment, const char *data, size_t len) const;
+
+  /// @brief Начать новый активный сегмент с номера base
+  void open_segment(uint64_t base);
+
+  /// @brief Открыть файлы активного (последнего) сегмента для дозаписи
+  void open_active();
+
+  /// @brief Цикл потока записи
+  void run();
+
+  /**
+   * @brief Сериализовать незафиксированные сообщения пачки и зафиксировать их
+   * @throws std::runtime_error при ошибке записи; зафиксированная часть учтена в committed_
+   */
+  void write_batch(const std::vector<Pending> &batch);
+
+  /// @brief Записать и зафиксировать сериализованную пачку; last — номер последнего сообщения в ней
+  void commit(uint64_t last);
+};
@@ -1,12 +1,22 @@
 #include <iostream>
 #include <memory>
+#include <algorithm>
 #include <csignal>
 #include <atomic>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
 
+#include "include/log/logger.h"
 #include "include/net/connection/connectionManager.h"
 #include "include/net/connection/chat_server.h"
 #include "include/handler/Messages/implementations/broadcast_handler.h"
-#include "include/handler/Messages/chain/chained_handler.h"
+#include "include/handler/Messages/implementations/room_handler.h"
+#include "include/handler/Messages/implementations/stats_handler.h"
+#include "include/handler/Messages/implementations/user_handler.h"
+#include "include/handler/Messages/router/command_router.h"
 
 std::atomic<bool> g_running(true);
 
@@ -16,29 +26,165 @@ void signal_handler(int signal)
   g_running = false;
 }
 
-int main()
+// Один поток обслуживает десятки тысяч сокетов: поднимаем мягкий лимит дескрипторов до жесткого
+void raise_fd_limit()
+{
+  rlimit rl{};
+  if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max)
+  {
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+  }
+}
+
+// Частота подключений из окружения: "скорость[:запас]", например CHAT_ACCEPT_RATE=5000:20000
+void read_rate(const char *variable, double &rate, size_t &burst)
+{
+  const char *value = std::getenv(variable);
+  if (!value)
+    return;
+  char *end = nullptr;
+  double parsed_rate = std::strtod(value, &end);
+  size_t parsed_burst = 0;
+  bool ok = end != value && parsed_rate >= 0;
+  if (ok && *end == ':')
+  {
+    const char *begin = end + 1;
+    parsed_burst = std::strtoul(begin, &end, 10);
+    ok = end != begin;
+  }
+  if (!ok || *end != '\0')
+  {
+    std::cerr << "Invalid " << variable << " '" << value << "', expected rate[:burst]\n";
+    return;
+  }
+  rate = parsed_rate;
+  burst = parsed_burst;
+}
+
+// Список через запятую без пустых элементов
+std::vector<std::string> split_list(const std::string &list)
+{
+  std::vector<std::string> items;
+  for (size_t begin = 0; begin < list.size();)
+  {
+    size_t end = std::min(list.find(',', begin), list.size());
+    if (end > begin)
+      items.push_back(list.substr(begin, end - begin));
+    begin = end + 1;
+  }
+  return items;
+}
+
+int main(int argc, char **argv)
 {
   std::signal(SIGINT, signal_handler);
   std::signal(SIGTERM, signal_handler);
+  raise_fd_limit();
+
+  // Уровень журнала: CHAT_LOG_LEVEL=debug|info|warn|error|off (по умолчанию info)
+  if (const char *name = std::getenv("CHAT_LOG_LEVEL"))
+  {
+    LogLevel level;
+    if (Log::parse_level(name, level))
+      Log::set_level(level);
+    else
+      std::cerr << "Unknown CHAT_LOG_LEVEL '" << name << "', using info\n";
+  }
 
   try
   {
-    auto chain = std::make_unique<ChainedHandler>();
+    auto router = std::make_unique<CommandRouter>();
 
-    auto manager = std::make_unique<connectionManager>(AF_INET, SOCK_STREAM, 0, std::move(chain));
+    // Параметры командной строки — пары "--имя значение", все необязательны:
+    //   --shards N             число шардов (0 — по ядрам)
+    //   --io epoll|io_uring    реализация ввода-вывода
+    //   --handler-threads N    потоки обработчиков (0 — в потоках шардов)
+    //   --metrics-port N       порт HTTP-метрик (0 — отключены)
+    //   --max-connections N    максимум подключений (0 — без ограничения)
+    //   --store DIR            каталог журнала сообщений (не задан — сообщения не сохраняются)
+    //   --port N               порт клиентов (8080)
+    //   --cluster-port N       порт кластера (0 — один процесс)
+    //   --cluster-ip ADDR      адрес порта кластера (по умолчанию адрес клиентов)
+    //   --peers LIST           узлы кластера через запятую: 127.0.0.1:9001,127.0.0.1:9002
+    //   --handshake-timeout S  срок первого кадра бинарного клиента, с (30; 0 — без ограничения)
+    //   --idle-timeout S       отключение клиента без входящих данных, с (0 — без ограничения)
+    //   --keepalive S          простой TCP до проб keepalive, с (60; 0 — выключен)
+    // Секрет кластера — только из окружения (CHAT_CLUSTER_SECRET): аргументы видны в списке процессов
+    ServerConfig config;
+    config.shards_ = 0;
+    int port = 8080;
+    for (int i = 1; i < argc; i += 2)
+    {
+      std::string name = argv[i];
+      if (i + 1 >= argc)
+        throw std::runtime_error("Missing value for " + name + "\n");
+      std::string value = argv[i + 1];
+      if (name == "--shards")
+        config.shards_ = std::stoul(value);
+      else if (name == "--io" && (value == "epoll" || value == "io_uring"))
+        config.io_backend_ = value == "io_uring" ? IoBackendKind::Uring : IoBackendKind::Epoll;
+      else if (name == "--handler-threads")
+        config.handler_threads_ = std::stoul(value);
+      else if (name == "--metrics-port")
+        config.admin_port_ = std::stoi(value);
+      else if (name == "--max-connections")
+        config.max_connections_ = std::stoul(value);
+      else if (name == "--store")
+        config.store_dir_ = value;
+      else if (name == "--port")
+        port = std::stoi(value);
+      else if (name == "--cluster-port")
+        config.cluster_port_ = std::stoi(value);
+      else if (name == "--cluster-ip")
+        config.cluster_ip_ = value;
+      else if (name == "--peers")
+        config.cluster_peers_ = split_list(value);
+      else if (name == "--handshake-timeout")
+        config.handshake_timeout_ = std::chrono::seconds(std::stoul(value));
+      else if (name == "--idle-timeout")
+        config.idle_timeout_ = std::chrono::seconds(std::stoul(value));
+      else if (name == "--keepalive")
+        config.keepalive_idle_ = std::chrono::seconds(std::stoul(value));
+      else
+        throw std::runtime_error("Unknown option " + name + " " + value + "\n");
+    }
+    if (const char *secret = std::getenv("CHAT_CLUSTER_SECRET"))
+      config.cluster_secret_ = secret;
+    // Прием подключений: CHAT_LISTEN_BACKLOG — очередь listen, CHAT_ACCEPT_RATE и
+    // CHAT_ACCEPT_RATE_PER_IP — ведра токенов на сервер и на IP-адрес (по умолчанию без ограничения)
+    if (const char *backlog = std::getenv("CHAT_LISTEN_BACKLOG"))
+      config.listen_backlog_ = std::stoi(backlog);
+    read_rate("CHAT_ACCEPT_RATE", config.accept_rate_, config.accept_burst_);
+    read_rate("CHAT_ACCEPT_RATE_PER_IP", config.accept_rate_per_ip_, config.accept_burst_per_ip_);
+    auto manager = std::make_unique<connectionManager>(AF_INET, SOCK_STREAM, 0, std::move(router), config);
 
-    if (auto *chain_ptr = manager->get_handler_as<ChainedHandler>())
+    if (auto *router_ptr = manager->get_handler_as<CommandRouter>())
     {
-      chain_ptr->add(std::make_unique<BroadcastHandler>(
-          manager->get_clients(),
-          manager->get_clients_mutex()));
+      // Команды находятся по имени за одно обращение к таблице, обычный текст сразу идет в рассылку
+      auto rooms = std::make_shared<RoomHandler>(*manager);
+      auto stats = std::make_shared<StatsHandler>(*manager);
+      auto users = std::make_shared<UserHandler>(*manager);
+      router_ptr->add("/join", [rooms](const std::shared_ptr<Socket> &sender, std::string_view args)
+                      { rooms->join(sender, args); });
+      router_ptr->add("/leave", [rooms](const std::shared_ptr<Socket> &sender, std::string_view args)
+                      { rooms->leave(sender, args); });
+      router_ptr->add("/nick", [users](const std::shared_ptr<Socket> &sender, std::string_view args)
+                      { users->nick(sender, args); });
+      router_ptr->add("/msg", [users](const std::shared_ptr<Socket> &sender, std::string_view args)
+                      { users->msg(sender, args); });
+      router_ptr->add("/stats", [stats](const std::shared_ptr<Socket> &sender, std::string_view)
+                      { stats->stats(sender); });
+      router_ptr->set_text(std::make_unique<BroadcastHandler>(*manager));
     }
 
+    size_t shards_started = manager->shard_count();
+    std::string io_backend = manager->io_backend_name();
     ChatServer server(std::move(manager));
 
-    server.start("0.0.0.0", 8080);
+    server.start("0.0.0.0", port);
 
-    std::cout << "Server started on 0.0.0.0:8080. Press Ctrl+C to stop...\n";
+    std::cout << "Server started on 0.0.0.0:" << port << " (" << shards_started << " shards, " << io_backend << "). Press Ctrl+C to stop...\n";
 
     while (g_running)
     {
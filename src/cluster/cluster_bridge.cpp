@@ -0,0 +1,526 @@
+/**
+ * @file cluster_bridge.cpp
+ * @brief Реализация методов ClusterBridge
+ */
+
+#include "../include/cluster/cluster_bridge.h"
+#include "../include/log/logger.h"
+#include "../include/metrics/metrics.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <stdexcept>
+#include <string_view>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+namespace
+{
+  constexpr char kHello[8] = {'C', 'H', 'A', 'T', 'N', 'O', 'D', 'E'}; ///< Начало приветствия
+  constexpr size_t kHelloSize = sizeof(kHello) + sizeof(uint64_t) + sizeof(uint16_t); ///< Приветствие без секрета
+  constexpr size_t kHeaderSize = 3 * sizeof(uint64_t) + sizeof(uint16_t); ///< Кадр без длины, комнаты и текста
+  constexpr size_t kMaxFrame = 16 * 1024 * 1024;                      ///< Предельная длина кадра
+  constexpr size_t kReadChunk = 64 * 1024;                            ///< Шаг чтения из сокета
+  constexpr std::chrono::milliseconds kTimerTick{100};                 ///< Точность повторных подключений
+
+  /// @brief Текущее время (system_clock), нс: сравнимо между процессами узла
+  uint64_t wall_ns() noexcept
+  {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::system_clock::now().time_since_epoch())
+                                     .count());
+  }
+
+  template <typename T>
+  void put(std::string &out, T value)
+  {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+
+  template <typename T>
+  T get(const char *data)
+  {
+    T value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+  }
+
+  /// @brief Случайный ненулевой идентификатор узла
+  uint64_t random_node_id()
+  {
+    std::random_device device;
+    uint64_t id = 0;
+    while (id == 0)
+    {
+      id = (static_cast<uint64_t>(device()) << 32) | device();
+    }
+    return id;
+  }
+
+  /// @brief Сравнить строки за время, не зависящее от позиции первого различия
+  bool same_secret(std::string_view a, std::string_view b) noexcept
+  {
+    if (a.size() != b.size())
+      return false;
+    unsigned char diff = 0;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+      diff |= static_cast<unsigned char>(a[i] ^ b[i]);
+    }
+    return diff == 0;
+  }
+
+  /// @brief Отключить алгоритм Нейгла: пачки уходят сразу, задержку задает только поток моста
+  void set_nodelay(int fd) noexcept
+  {
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  }
+}
+
+ClusterBridge::ClusterBridge(Options options, Deliver deliver)
+    : options_(std::move(options)), deliver_(std::move(deliver)), node_id_(random_node_id()), timers_(loop_, kTimerTick),
+      listener_(options_.ip.find(':') == std::string::npos ? AF_INET : AF_INET6, SOCK_STREAM, 0)
+{
+  if (options_.secret.size() > kMaxSecret)
+    throw std::runtime_error("Cluster secret is longer than " + std::to_string(kMaxSecret) + " bytes");
+  for (const auto &address : options_.peers)
+  {
+    auto peer = std::make_unique<Peer>();
+    peer->address = address;
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos || colon + 1 == address.size())
+      throw std::runtime_error("Invalid cluster peer address: " + address);
+    std::string host = address.substr(0, colon);
+    if (host.size() > 1 && host.front() == '[' && host.back() == ']')
+      host = host.substr(1, host.size() - 2);
+    int port = std::stoi(address.substr(colon + 1));
+
+    auto *v4 = reinterpret_cast<sockaddr_in *>(&peer->addr);
+    auto *v6 = reinterpret_cast<sockaddr_in6 *>(&peer->addr);
+    if (inet_pton(AF_INET, host.c_str(), &v4->sin_addr) == 1)
+    {
+      v4->sin_family = AF_INET;
+      v4->sin_port = htons(static_cast<uint16_t>(port));
+      peer->addr_len = sizeof(sockaddr_in);
+    }
+    else if (inet_pton(AF_INET6, host.c_str(), &v6->sin6_addr) == 1)
+    {
+      v6->sin6_family = AF_INET6;
+      v6->sin6_port = htons(static_cast<uint16_t>(port));
+      peer->addr_len = sizeof(sockaddr_in6);
+    }
+    else
+    {
+      throw std::runtime_error("Invalid cluster peer address: " + address);
+    }
+    Peer *raw = peer.get();
+    peer->retry.callback = [this, raw]
+    { dial(*raw); };
+    peers_.push_back(std::move(peer));
+  }
+
+  listener_.universal_struct_parameters(options_.ip, options_.port);
+  listener_.bind_socket();
+  listener_.listen_socket(64);
+  listener_.set_nonblocking();
+  loop_.add(listener_.fd(), EPOLLIN, [this](uint32_t)
+            { accept(); });
+
+  for (auto &peer : peers_)
+  {
+    dial(*peer);
+  }
+
+  Log::write(LogLevel::Info, "Cluster node %016llx listening on %s:%d, %zu peers", static_cast<unsigned long long>(node_id_),
+             options_.ip.c_str(), options_.port, peers_.size());
+  thread_ = std::thread([this]
+                        {
+    try
+    {
+      loop_.run();
+    }
+    catch (std::exception &e)
+    {
+      Log::write(LogLevel::Error, "Cluster event loop failed: %s", e.what());
+    } });
+}
+
+ClusterBridge::~ClusterBridge()
+{
+  loop_.stop();
+  if (thread_.joinable())
+    thread_.join();
+
+  // Поток моста остановлен: подключения закрываются из текущего потока
+  for (auto &link : links_)
+  {
+    loop_.remove(link.first);
+    ::close(link.first);
+  }
+  links_.clear();
+  loop_.remove(listener_.fd());
+}
+
+void ClusterBridge::publish(const MessageRef &room, const MessageRef &text)
+{
+  bool wake;
+  {
+    std::lock_guard<std::mutex> lock(outbox_mutex_);
+    wake = outbox_.empty();
+    outbox_.push_back(Outgoing{next_seq_++, wall_ns(), room, text});
+  }
+  // Поток моста будится один раз на пачку: следующие публикации застанут очередь непустой
+  if (wake)
+    loop_.post([this]
+               { flush(); });
+}
+
+void ClusterBridge::dial(Peer &peer)
+{
+  int fd = ::socket(peer.addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+  {
+    Log::write(LogLevel::Error, "Cluster: socket for %s failed: %s", peer.address.c_str(), strerror(errno));
+    timers_.arm(peer.retry, TimerWheel::Clock::now() + options_.reconnect_interval);
+    return;
+  }
+  set_nodelay(fd);
+  if (::connect(fd, reinterpret_cast<const sockaddr *>(&peer.addr), peer.addr_len) < 0 && errno != EINPROGRESS)
+  {
+    Log::write(LogLevel::Debug, "Cluster: connect to %s failed: %s", peer.address.c_str(), strerror(errno));
+    ::close(fd);
+    timers_.arm(peer.retry, TimerWheel::Clock::now() + options_.reconnect_interval);
+    return;
+  }
+
+  auto link = std::make_unique<Link>();
+  link->fd = fd;
+  link->peer = &peer;
+  link->greeted = true;
+  link->out.append(kHello, sizeof(kHello));
+  put<uint64_t>(link->out, node_id_);
+  put<uint16_t>(link->out, static_cast<uint16_t>(options_.secret.size()));
+  link->out.append(options_.secret);
+  link->writing = true;
+  peer.fd = fd;
+  links_.emplace(fd, std::move(link));
+  // EPOLLOUT сообщит о завершении connect
+  loop_.add(fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP, [this, fd](uint32_t events)
+            { serve(fd, events); });
+}
+
+void ClusterBridge::accept()
+{
+  for (;;)
+  {
+    sockaddr_storage from{};
+    socklen_t from_len = sizeof(from);
+    int fd = listener_.try_accept(reinterpret_cast<sockaddr *>(&from), &from_len);
+    if (fd < 0)
+    {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      return;
+    }
+    if (!known_peer(from))
+    {
+      char host[INET6_ADDRSTRLEN] = "?";
+      if (from.ss_family == AF_INET)
+        inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in &>(from).sin_addr, host, sizeof(host));
+      else if (from.ss_family == AF_INET6)
+        inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6 &>(from).sin6_addr, host, sizeof(host));
+      Log::write(LogLevel::Warn, "Cluster: rejected a connection from %s, which is not a listed peer", host);
+      Metrics::add(Counter::ClusterRejected);
+      ::close(fd);
+      continue;
+    }
+
+    set_nodelay(fd);
+    auto link = std::make_unique<Link>();
+    link->fd = fd;
+    links_.emplace(fd, std::move(link));
+    loop_.add(fd, EPOLLIN | EPOLLRDHUP, [this, fd](uint32_t events)
+              { serve(fd, events); });
+  }
+}
+
+bool ClusterBridge::known_peer(const sockaddr_storage &from) const noexcept
+{
+  // IPv4-узел, принятый IPv6-сокетом, приходит как ::ffff:a.b.c.d
+  const auto &from6 = reinterpret_cast<const sockaddr_in6 &>(from);
+  bool mapped = from.ss_family == AF_INET6 && IN6_IS_ADDR_V4MAPPED(&from6.sin6_addr);
+  for (const auto &peer : peers_)
+  {
+    if (peer->addr.ss_family == AF_INET)
+    {
+      const auto &want = reinterpret_cast<const sockaddr_in &>(peer->addr).sin_addr;
+      if (from.ss_family == AF_INET && reinterpret_cast<const sockaddr_in &>(from).sin_addr.s_addr == want.s_addr)
+        return true;
+      if (mapped && std::memcmp(from6.sin6_addr.s6_addr + 12, &want, sizeof(want)) == 0)
+        return true;
+    }
+    else if (from.ss_family == AF_INET6 &&
+             std::memcmp(&from6.sin6_addr, &reinterpret_cast<const sockaddr_in6 &>(peer->addr).sin6_addr, sizeof(in6_addr)) == 0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ClusterBridge::serve(int fd, uint32_t events)
+{
+  auto it = links_.find(fd);
+  if (it == links_.end())
+    return;
+  Link &link = *it->second;
+
+  if (link.peer && !link.peer->connected)
+  {
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0)
+      error = errno;
+    if (error != 0)
+    {
+      Log::write(LogLevel::Debug, "Cluster: connect to %s failed: %s", link.peer->address.c_str(), strerror(error));
+      drop(fd);
+      return;
+    }
+    if (!(events & EPOLLOUT))
+      return;
+    link.peer->connected = true;
+    connected_.fetch_add(1, std::memory_order_relaxed);
+    Log::write(LogLevel::Info, "Cluster: connected to %s", link.peer->address.c_str());
+  }
+
+  if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+  {
+    bool closed = false;
+    for (;;)
+    {
+      size_t used = link.in.size();
+      link.in.resize(used + kReadChunk);
+      ssize_t n = ::recv(fd, &link.in[used], kReadChunk, 0);
+      link.in.resize(used + (n > 0 ? static_cast<size_t>(n) : 0));
+      if (n > 0)
+        continue;
+      closed = n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+      if (n < 0 && errno == EINTR)
+        continue;
+      break;
+    }
+
+    bool valid = parse(link);
+    if (!received_.empty())
+    {
+      deliver_(std::move(received_));
+      received_.clear();
+    }
+    if (!valid || closed)
+    {
+      drop(fd);
+      return;
+    }
+  }
+
+  if ((events & EPOLLOUT) && !send(link))
+    drop(fd);
+}
+
+bool ClusterBridge::parse(Link &link)
+{
+  const char *data = link.in.data();
+  size_t size = link.in.size();
+  size_t pos = 0;
+
+  if (!link.greeted)
+  {
+    if (size < kHelloSize)
+      return true;
+    if (std::memcmp(data, kHello, sizeof(kHello)) != 0)
+    {
+      Log::write(LogLevel::Warn, "Cluster: rejected a connection without a node greeting");
+      return false;
+    }
+    uint16_t secret_len = get<uint16_t>(data + sizeof(kHello) + sizeof(uint64_t));
+    if (secret_len > kMaxSecret)
+    {
+      Log::write(LogLevel::Warn, "Cluster: rejected a node greeting with an oversized secret");
+      Metrics::add(Counter::ClusterRejected);
+      return false;
+    }
+    if (size < kHelloSize + secret_len)
+      return true;
+    if (!same_secret(std::string_view(data + kHelloSize, secret_len), options_.secret))
+    {
+      Log::write(LogLevel::Warn, "Cluster: rejected a node with a wrong cluster secret");
+      Metrics::add(Counter::ClusterRejected);
+      return false;
+    }
+    link.remote = get<uint64_t>(data + sizeof(kHello));
+    if (link.remote == node_id_)
+    {
+      Log::write(LogLevel::Warn, "Cluster: node is listed as its own peer, connection closed");
+      return false;
+    }
+    link.greeted = true;
+    pos = kHelloSize + secret_len;
+    Log::write(LogLevel::Info, "Cluster: node %016llx connected", static_cast<unsigned long long>(link.remote));
+  }
+
+  uint64_t now = wall_ns();
+  while (size - pos >= sizeof(uint32_t))
+  {
+    uint32_t len = get<uint32_t>(data + pos);
+    if (len < kHeaderSize || len > kMaxFrame)
+    {
+      Log::write(LogLevel::Warn, "Cluster: invalid frame length %u from node %016llx", len,
+                 static_cast<unsigned long long>(link.remote));
+      return false;
+    }
+    if (size - pos - sizeof(uint32_t) < len)
+      break;
+
+    const char *frame = data + pos + sizeof(uint32_t);
+    pos += sizeof(uint32_t) + len;
+    uint64_t origin = get<uint64_t>(frame);
+    uint64_t seq = get<uint64_t>(frame + 8);
+    uint64_t sent_ns = get<uint64_t>(frame + 16);
+    uint16_t room_len = get<uint16_t>(frame + 24);
+    if (room_len > len - kHeaderSize)
+      return false;
+
+    // Свои сообщения и повторы не доставляются: сообщение раздается клиентам не больше одного раза
+    if (origin == node_id_)
+    {
+      Metrics::add(Counter::ClusterRepeats);
+      continue;
+    }
+    auto last = last_seq_.try_emplace(origin, seq);
+    if (!last.second)
+    {
+      if (seq <= last.first->second)
+      {
+        Metrics::add(Counter::ClusterRepeats);
+        continue;
+      }
+      if (seq > last.first->second + 1)
+        Metrics::add(Counter::ClusterLost, seq - last.first->second - 1);
+      last.first->second = seq;
+    }
+
+    Metrics::add(Counter::ClusterReceived);
+    if (now > sent_ns)
+      Metrics::record(Latency::Cluster, now - sent_ns);
+    std::string_view room(frame + kHeaderSize, room_len);
+    std::string_view text(frame + kHeaderSize + room_len, len - kHeaderSize - room_len);
+    received_.push_back(Inbound{room.empty() ? MessageRef() : MessageBuffer::create({room}),
+                                MessageBuffer::create({text}, Metrics::now_ns())});
+  }
+  link.in.erase(0, pos);
+  return true;
+}
+
+void ClusterBridge::flush()
+{
+  {
+    std::lock_guard<std::mutex> lock(outbox_mutex_);
+    sending_.swap(outbox_);
+  }
+  if (sending_.empty())
+    return;
+
+  // Пачка сериализуется один раз и дописывается в очередь каждого узла
+  batch_.clear();
+  for (const Outgoing &message : sending_)
+  {
+    size_t room_len = message.room ? message.room->size() : 0;
+    put<uint32_t>(batch_, static_cast<uint32_t>(kHeaderSize + room_len + message.text->size()));
+    put<uint64_t>(batch_, node_id_);
+    put<uint64_t>(batch_, message.seq);
+    put<uint64_t>(batch_, message.time_ns);
+    put<uint16_t>(batch_, static_cast<uint16_t>(room_len));
+    if (room_len)
+      batch_.append(message.room->view());
+    batch_.append(message.text->view());
+  }
+  size_t count = sending_.size();
+  sending_.clear();
+
+  for (auto &peer : peers_)
+  {
+    auto it = peer->connected ? links_.find(peer->fd) : links_.end();
+    if (it == links_.end() || it->second->out.size() - it->second->out_offset + batch_.size() > options_.max_queued_bytes)
+    {
+      Metrics::add(Counter::ClusterDropped, count);
+      continue;
+    }
+    Link &link = *it->second;
+    link.out.append(batch_);
+    Metrics::add(Counter::ClusterSent, count);
+    if (!link.writing && !send(link))
+      drop(link.fd);
+  }
+}
+
+bool ClusterBridge::send(Link &link)
+{
+  while (link.out_offset < link.out.size())
+  {
+    ssize_t n = ::send(link.fd, link.out.data() + link.out_offset, link.out.size() - link.out_offset, MSG_NOSIGNAL);
+    if (n < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+        return false;
+      if (!link.writing)
+      {
+        link.writing = true;
+        loop_.modify(link.fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP);
+      }
+      return true;
+    }
+    link.out_offset += static_cast<size_t>(n);
+  }
+  link.out.clear();
+  link.out_offset = 0;
+  if (link.writing)
+  {
+    link.writing = false;
+    loop_.modify(link.fd, EPOLLIN | EPOLLRDHUP);
+  }
+  return true;
+}
+
+void ClusterBridge::drop(int fd)
+{
+  auto it = links_.find(fd);
+  if (it == links_.end())
+    return;
+  std::unique_ptr<Link> link = std::move(it->second);
+  links_.erase(it);
+  loop_.remove(fd);
+  ::close(fd);
+
+  if (Peer *peer = link->peer)
+  {
+    if (peer->connected)
+    {
+      connected_.fetch_sub(1, std::memory_order_relaxed);
+      Log::write(LogLevel::Warn, "Cluster: lost connection to %s, reconnecting", peer->address.c_str());
+    }
+    peer->fd = -1;
+    peer->connected = false;
+    timers_.arm(peer->retry, TimerWheel::Clock::now() + options_.reconnect_interval);
+  }
+  else if (link->greeted)
+  {
+    Log::write(LogLevel::Info, "Cluster: node %016llx disconnected", static_cast<unsigned long long>(link->remote));
+  }
+}
@@ -3,27 +3,15 @@
  * @brief Реализация методов BroadcastHandler
  */
 #include "../include/handler/Messages/implementations/broadcast_handler.h"
-#include <iostream>
 
-BroadcastHandler::BroadcastHandler(ClientContainer &clients, std::mutex &mutex)
-    : clients_(clients), mutex_(mutex) {}
+BroadcastHandler::BroadcastHandler(connectionManager &manager)
+    : manager_(manager) {}
 
-bool BroadcastHandler::handle(std::shared_ptr<Socket> sender, const std::string &msg)
+bool BroadcastHandler::handle(std::shared_ptr<Socket> sender, const MessageRef &msg)
 {
-  if (msg.empty())
+  if (msg->empty())
     return false;
 
-  std::lock_guard<std::mutex> lock(mutex_);
-
-  for (auto &client : clients_)
-  {
-    if (sender != client)
-    {
-      if (client->send(msg) < 0)
-      {
-        std::cerr << "Error sending to client (continuing with others)\n";
-      }
-    }
-  }
+  manager_.broadcast(sender, msg);
   return true;
-}
\ No newline at end of file
+}
@@ -10,7 +10,7 @@ void ChainedHandler::add(std::unique_ptr<IMessageHandler> handler)
   handlers_.emplace_back(std::move(handler));
 }
 
-bool ChainedHandler::handle(std::shared_ptr<Socket> sender, const std::string &msg)
+bool ChainedHandler::handle(std::shared_ptr<Socket> sender, const MessageRef &msg)
 {
   for (auto &handler : handlers_)
   {
@@ -0,0 +1,110 @@
+/**
+ * @file command_router.cpp
+ * @brief Реализация методов CommandRouter
+ */
+
+#include "../include/handler/Messages/router/command_router.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+  /// Попыток подобрать множитель, прежде чем удвоить таблицу
+  constexpr size_t kSeedAttempts = 4096;
+
+  /// @brief FNV-1a: хеш имени команды
+  uint64_t hash_name(std::string_view name) noexcept
+  {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char ch : name)
+    {
+      hash ^= ch;
+      hash *= 1099511628211ull;
+    }
+    return hash;
+  }
+
+  /// @brief Следующий кандидат в множители (splitmix64, всегда нечетный)
+  uint64_t next_multiplier(uint64_t &state) noexcept
+  {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return (z ^ (z >> 31)) | 1;
+  }
+}
+
+bool CommandRouter::handle(std::shared_ptr<Socket> sender, const MessageRef &msg)
+{
+  std::string_view text = msg->view();
+  if (!text.empty() && text.front() == '/' && !routes_.empty())
+  {
+    if (text.back() == '\n')
+      text.remove_suffix(1);
+    size_t end = text.find(' ');
+    std::string_view name = text.substr(0, end);
+    if (name.size() <= kMaxName)
+    {
+      const Route *route = table_[slot(name)];
+      if (route && route->name == name)
+      {
+        std::string_view args = end == std::string_view::npos ? std::string_view() : text.substr(end);
+        size_t begin = args.find_first_not_of(' ');
+        args = begin == std::string_view::npos ? std::string_view() : args.substr(begin, args.find_last_not_of(' ') - begin + 1);
+        route->command(sender, args);
+        return true;
+      }
+    }
+  }
+  return text_ && text_->handle(std::move(sender), msg);
+}
+
+void CommandRouter::add_command(std::string_view name, Command command)
+{
+  if (name.size() < 2 || name.size() > kMaxName || name.front() != '/' || name.find(' ') != std::string_view::npos)
+    throw std::runtime_error("Invalid command name: " + std::string(name));
+  for (const Route &route : routes_)
+  {
+    if (route.name == name)
+      throw std::runtime_error("Command already registered: " + std::string(name));
+  }
+  routes_.push_back(Route{std::string(name), std::move(command)});
+  rebuild();
+}
+
+size_t CommandRouter::slot(std::string_view name) const noexcept
+{
+  return static_cast<size_t>((hash_name(name) * multiplier_) >> shift_);
+}
+
+void CommandRouter::rebuild()
+{
+  unsigned bits = 1;
+  while ((size_t(1) << bits) < 2 * routes_.size())
+    ++bits;
+
+  uint64_t state = 0;
+  for (;; ++bits)
+  {
+    table_.assign(size_t(1) << bits, nullptr);
+    shift_ = 64 - bits;
+    for (size_t attempt = 0; attempt < kSeedAttempts; ++attempt)
+    {
+      multiplier_ = next_multiplier(state);
+      bool perfect = true;
+      for (const Route &route : routes_)
+      {
+        const Route *&cell = table_[slot(route.name)];
+        if (cell)
+        {
+          perfect = false;
+          break;
+        }
+        cell = &route;
+      }
+      if (perfect)
+        return;
+      std::fill(table_.begin(), table_.end(), nullptr);
+    }
+  }
+}
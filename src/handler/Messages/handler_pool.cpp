@@ -0,0 +1,114 @@
+/**
+ * @file handler_pool.cpp
+ * @brief Реализация методов HandlerPool
+ */
+
+#include "../include/handler/Messages/pool/handler_pool.h"
+#include <algorithm>
+
+HandlerPool::HandlerPool(size_t threads, size_t capacity, Executor executor)
+    : capacity_(std::max<size_t>(capacity, 1)), executor_(std::move(executor))
+{
+  threads = std::max<size_t>(threads, 1);
+  lanes_.reserve(threads);
+  for (size_t i = 0; i < threads; ++i)
+  {
+    lanes_.push_back(std::make_unique<Lane>());
+  }
+  for (auto &lane : lanes_)
+  {
+    Lane *raw = lane.get();
+    lane->thread = std::thread([this, raw]
+                               { run(*raw); });
+  }
+}
+
+HandlerPool::~HandlerPool()
+{
+  stop();
+}
+
+bool HandlerPool::submit(Job job)
+{
+  Lane &lane = *lanes_[static_cast<size_t>(job.client->fd()) % lanes_.size()];
+  {
+    std::lock_guard<std::mutex> lock(lane.mutex);
+    if (lane.stopping || lane.jobs.size() >= capacity_)
+    {
+      lane.rejected.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    job.queued = std::chrono::steady_clock::now();
+    lane.jobs.push_back(std::move(job));
+    lane.depth.store(lane.jobs.size(), std::memory_order_relaxed);
+  }
+  lane.ready.notify_one();
+  return true;
+}
+
+void HandlerPool::stop()
+{
+  for (auto &lane : lanes_)
+  {
+    {
+      std::lock_guard<std::mutex> lock(lane->mutex);
+      lane->stopping = true;
+    }
+    lane->ready.notify_one();
+  }
+  for (auto &lane : lanes_)
+  {
+    if (lane->thread.joinable())
+    {
+      lane->thread.join();
+    }
+  }
+}
+
+HandlerPool::Stats HandlerPool::stats() const noexcept
+{
+  Stats stats;
+  stats.threads = lanes_.size();
+  for (auto &lane : lanes_)
+  {
+    stats.queued += lane->depth.load(std::memory_order_relaxed);
+    stats.processed += lane->processed.load(std::memory_order_relaxed);
+    stats.rejected += lane->rejected.load(std::memory_order_relaxed);
+    stats.wait_ns_total += lane->wait_ns_total.load(std::memory_order_relaxed);
+    stats.wait_ns_max = std::max(stats.wait_ns_max, lane->wait_ns_max.load(std::memory_order_relaxed));
+  }
+  return stats;
+}
+
+void HandlerPool::run(Lane &lane)
+{
+  // Очередь и пачка меняются местами: после прогрева обе не выделяют память
+  std::vector<Job> batch;
+  for (;;)
+  {
+    {
+      std::unique_lock<std::mutex> lock(lane.mutex);
+      lane.ready.wait(lock, [&]
+                      { return lane.stopping || !lane.jobs.empty(); });
+      if (lane.jobs.empty())
+        return;
+      // Вся очередь забирается разом: поток ввода-вывода реже ждет мьютекс
+      batch.swap(lane.jobs);
+      lane.depth.store(0, std::memory_order_relaxed);
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    for (auto &job : batch)
+    {
+      uint64_t wait = static_cast<uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(now - job.queued).count());
+      lane.wait_ns_total.fetch_add(wait, std::memory_order_relaxed);
+      if (wait > lane.wait_ns_max.load(std::memory_order_relaxed))
+        lane.wait_ns_max.store(wait, std::memory_order_relaxed);
+
+      executor_(job);
+      lane.processed.fetch_add(1, std::memory_order_relaxed);
+    }
+    batch.clear();
+  }
+}
@@ -0,0 +1,62 @@
+/**
+ * @file room_handler.cpp
+ * @brief Реализация методов RoomHandler
+ */
+#include "../include/handler/Messages/implementations/room_handler.h"
+#include "../include/handler/Messages/implementations/command_args.h"
+
+namespace
+{
+  constexpr std::string_view kJoin = "/join";
+  constexpr std::string_view kLeave = "/leave";
+}
+
+RoomHandler::RoomHandler(connectionManager &manager)
+    : manager_(manager) {}
+
+bool RoomHandler::handle(std::shared_ptr<Socket> sender, const MessageRef &msg)
+{
+  std::string_view text = msg->view();
+  if (!text.empty() && text.back() == '\n')
+    text.remove_suffix(1);
+
+  std::string_view room;
+  if (match_command(text, kJoin, room))
+  {
+    join(sender, room);
+    return true;
+  }
+  if (match_command(text, kLeave, room))
+  {
+    leave(sender, room);
+    return true;
+  }
+  return false;
+}
+
+void RoomHandler::join(const std::shared_ptr<Socket> &sender, std::string_view room)
+{
+  if (!valid_name(room, kMaxRoomName))
+  {
+    manager_.reply(sender, MessageBuffer::create({"Usage: /join <room> (1-64 chars, no spaces)\n"}));
+    return;
+  }
+  // Ответ уходит из задачи подписки, вместе с историей комнаты
+  if (manager_.join(sender, room, MessageBuffer::create({"Joined #", room, "\n"})) == connectionManager::RoomChange::LimitReached)
+    manager_.reply(sender, MessageBuffer::create({"Too many rooms, /leave one first\n"}));
+}
+
+void RoomHandler::leave(const std::shared_ptr<Socket> &sender, std::string_view room)
+{
+  MessageRef name = room.empty() ? manager_.current_room(sender) : MessageBuffer::create({room});
+  if (!name || manager_.leave(sender, name->view()) != connectionManager::RoomChange::Done)
+  {
+    manager_.reply(sender, MessageBuffer::create({"You are not in that room\n"}));
+    return;
+  }
+  MessageRef current = manager_.current_room(sender);
+  if (current)
+    manager_.reply(sender, MessageBuffer::create({"Left #", name->view(), ", now in #", current->view(), "\n"}));
+  else
+    manager_.reply(sender, MessageBuffer::create({"Left #", name->view(), "\n"}));
+}
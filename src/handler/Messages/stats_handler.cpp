@@ -0,0 +1,32 @@
+/**
+ * @file stats_handler.cpp
+ * @brief Реализация методов StatsHandler
+ */
+#include "../include/handler/Messages/implementations/stats_handler.h"
+
+namespace
+{
+  constexpr std::string_view kStats = "/stats";
+}
+
+StatsHandler::StatsHandler(connectionManager &manager)
+    : manager_(manager) {}
+
+bool StatsHandler::handle(std::shared_ptr<Socket> sender, const MessageRef &msg)
+{
+  std::string_view text = msg->view();
+  if (!text.empty() && text.back() == '\n')
+    text.remove_suffix(1);
+  while (!text.empty() && text.back() == ' ')
+    text.remove_suffix(1);
+  if (text != kStats)
+    return false;
+
+  stats(sender);
+  return true;
+}
+
+void StatsHandler::stats(const std::shared_ptr<Socket> &sender)
+{
+  manager_.reply(sender, MessageBuffer::create({manager_.metrics_text()}));
+}
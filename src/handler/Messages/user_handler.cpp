@@ -0,0 +1,66 @@
+/**
+ * @file user_handler.cpp
+ * @brief Реализация методов UserHandler
+ */
+#include "../include/handler/Messages/implementations/user_handler.h"
+#include "../include/handler/Messages/implementations/command_args.h"
+
+namespace
+{
+  constexpr std::string_view kNick = "/nick";
+  constexpr std::string_view kMsg = "/msg";
+}
+
+UserHandler::UserHandler(connectionManager &manager)
+    : manager_(manager) {}
+
+bool UserHandler::handle(std::shared_ptr<Socket> sender, const MessageRef &msg)
+{
+  std::string_view text = msg->view();
+  if (!text.empty() && text.back() == '\n')
+    text.remove_suffix(1);
+
+  std::string_view args;
+  if (match_command(text, kNick, args))
+  {
+    nick(sender, args);
+    return true;
+  }
+  if (match_command(text, kMsg, args))
+  {
+    this->msg(sender, args);
+    return true;
+  }
+  return false;
+}
+
+void UserHandler::nick(const std::shared_ptr<Socket> &sender, std::string_view name)
+{
+  if (!valid_name(name, NameIndex::kMaxName))
+  {
+    manager_.reply(sender, MessageBuffer::create({"Usage: /nick <name> (1-32 chars, no spaces)\n"}));
+    return;
+  }
+  switch (manager_.set_nick(sender, name))
+  {
+  case connectionManager::NickChange::Taken:
+    manager_.reply(sender, MessageBuffer::create({"Nickname ", name, " is taken\n"}));
+    break;
+  default:
+    manager_.reply(sender, MessageBuffer::create({"You are now ", name, "\n"}));
+    break;
+  }
+}
+
+void UserHandler::msg(const std::shared_ptr<Socket> &sender, std::string_view args)
+{
+  size_t space = args.find(' ');
+  std::string_view name = args.substr(0, space);
+  std::string_view text = space == std::string_view::npos ? std::string_view() : args.substr(args.find_first_not_of(' ', space));
+  if (!valid_name(name, NameIndex::kMaxName) || text.empty())
+  {
+    manager_.reply(sender, MessageBuffer::create({"Usage: /msg <nick> <text>\n"}));
+    return;
+  }
+  manager_.direct(sender, name, text);
+}
@@ -0,0 +1,253 @@
+/**
+ * @file logger.cpp
+ * @brief Реализация методов Log
+ */
+
+#include "../include/log/logger.h"
+#include "../include/metrics/metrics.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+
+namespace
+{
+  constexpr const char *kLevelNames[] = {"DEBUG", "INFO", "WARN", "ERROR"};
+
+  /// @brief Записать строку в дескриптор целиком
+  void write_all(int fd, const std::string &out)
+  {
+    size_t written = 0;
+    while (written < out.size())
+    {
+      ssize_t n = ::write(fd, out.data() + written, out.size() - written);
+      if (n < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        return;
+      }
+      written += static_cast<size_t>(n);
+    }
+  }
+
+  /// @brief Текущее время (system_clock), нс
+  uint64_t wall_ns() noexcept
+  {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::system_clock::now().time_since_epoch())
+                                     .count());
+  }
+
+  /// @brief Дописать метку времени вида 2024-01-31 12:00:00.123456
+  /// @details Вызывается только потоком вывода; дата и время до секунды
+  /// форматируются один раз на секунду
+  void append_time(std::string &out, uint64_t time_ns)
+  {
+    static time_t cached_seconds = -1;
+    static char cached[32];
+    static size_t cached_len = 0;
+
+    time_t seconds = static_cast<time_t>(time_ns / 1000000000);
+    if (seconds != cached_seconds)
+    {
+      tm parts{};
+      localtime_r(&seconds, &parts);
+      cached_len = std::strftime(cached, sizeof(cached), "%Y-%m-%d %H:%M:%S", &parts);
+      cached_seconds = seconds;
+    }
+    out.append(cached, cached_len);
+    char micros[8];
+    int len = std::snprintf(micros, sizeof(micros), ".%06u", static_cast<unsigned>(time_ns % 1000000000 / 1000));
+    out.append(micros, static_cast<size_t>(len));
+  }
+}
+
+std::atomic<LogLevel> Log::level_{LogLevel::Info};
+
+bool Log::parse_level(const char *name, LogLevel &level) noexcept
+{
+  static constexpr struct
+  {
+    const char *name;
+    LogLevel level;
+  } kNames[] = {{"debug", LogLevel::Debug}, {"info", LogLevel::Info}, {"warn", LogLevel::Warn}, {"error", LogLevel::Error}, {"off", LogLevel::Off}};
+
+  for (const auto &entry : kNames)
+  {
+    if (std::strcmp(name, entry.name) == 0)
+    {
+      level = entry.level;
+      return true;
+    }
+  }
+  return false;
+}
+
+void Log::set_output(int fd) noexcept
+{
+  registry().fd.store(fd, std::memory_order_relaxed);
+}
+
+void Log::write(LogLevel level, const char *format, ...) noexcept
+{
+  if (!enabled(level))
+    return;
+  va_list args;
+  va_start(args, format);
+  append(level, format, args);
+  va_end(args);
+}
+
+void Log::sampled(LogSampler &sampler, LogLevel level, const char *format, ...) noexcept
+{
+  if (!enabled(level) || !sampler.take())
+    return;
+  va_list args;
+  va_start(args, format);
+  append(level, format, args);
+  va_end(args);
+}
+
+void Log::append(LogLevel level, const char *format, va_list args) noexcept
+{
+  ThreadRing &ring = local();
+  uint64_t head = ring.head.load(std::memory_order_relaxed);
+  // Индекс читателя перечитывается, только когда кольцо кажется полным
+  if (head - ring.cached_tail >= kRecords)
+    ring.cached_tail = ring.tail.load(std::memory_order_acquire);
+  if (head - ring.cached_tail >= kRecords)
+  {
+    // Писатель не ждет: запись теряется, поток вывода сообщит о потере
+    ring.dropped.store(ring.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    Metrics::add(Counter::LogDropped);
+    return;
+  }
+
+  Record &record = ring.records[head % kRecords];
+  record.time_ns = wall_ns();
+  record.level = level;
+  int len = std::vsnprintf(record.text, sizeof(record.text), format, args);
+  record.length = static_cast<uint16_t>(len < 0 ? 0 : std::min(static_cast<size_t>(len), sizeof(record.text) - 1));
+  ring.head.store(head + 1, std::memory_order_release);
+}
+
+void Log::flush()
+{
+  Registry &reg = registry();
+  std::unique_lock<std::mutex> lock(reg.mutex);
+  // Проход, уже идущий в момент вызова, мог пропустить свежие записи: ждем следующий целиком
+  uint64_t target = reg.passes + 2;
+  while (reg.passes < target && !reg.stop)
+  {
+    reg.wake.notify_one();
+    reg.done.wait(lock);
+  }
+}
+
+Log::Registry::Registry()
+{
+  flusher = std::thread([this]
+                        { run(*this); });
+}
+
+Log::Registry::~Registry()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  wake.notify_one();
+  if (flusher.joinable())
+    flusher.join();
+}
+
+Log::Registry &Log::registry()
+{
+  static Registry instance;
+  return instance;
+}
+
+Log::ThreadRing *Log::attach()
+{
+  auto ring = std::make_unique<ThreadRing>();
+  ThreadRing *raw = ring.get();
+  Registry &reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  raw->index = reg.rings.size();
+  reg.rings.push_back(std::move(ring));
+  return raw;
+}
+
+void Log::run(Registry &reg)
+{
+  std::vector<Record> batch;
+  std::string out;
+  std::unique_lock<std::mutex> lock(reg.mutex);
+  for (;;)
+  {
+    bool stopping = reg.stop;
+    drain(reg, batch, out);
+
+    // Вывод без мьютекса: attach и flush не ждут медленного дескриптора
+    if (!out.empty())
+    {
+      lock.unlock();
+      write_all(reg.fd.load(std::memory_order_relaxed), out);
+      out.clear();
+      lock.lock();
+    }
+    ++reg.passes;
+    reg.done.notify_all();
+
+    if (stopping)
+      return;
+    reg.wake.wait_for(lock, kFlushInterval);
+  }
+}
+
+bool Log::drain(Registry &reg, std::vector<Record> &batch, std::string &out)
+{
+  batch.clear();
+  for (const auto &ring : reg.rings)
+  {
+    uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    for (; tail != head; ++tail)
+    {
+      batch.push_back(ring->records[tail % kRecords]);
+    }
+    ring->tail.store(tail, std::memory_order_release);
+
+    uint64_t dropped = ring->dropped.load(std::memory_order_relaxed);
+    if (dropped != ring->dropped_seen)
+    {
+      Record note{};
+      note.time_ns = wall_ns();
+      note.level = LogLevel::Warn;
+      int len = std::snprintf(note.text, sizeof(note.text), "log: thread %zu dropped %llu records (ring full)", ring->index,
+                              static_cast<unsigned long long>(dropped - ring->dropped_seen));
+      note.length = static_cast<uint16_t>(std::min(static_cast<size_t>(len), sizeof(note.text) - 1));
+      ring->dropped_seen = dropped;
+      batch.push_back(note);
+    }
+  }
+  if (batch.empty())
+    return false;
+
+  // Кольца разных потоков перемежаются по времени записи
+  std::stable_sort(batch.begin(), batch.end(), [](const Record &a, const Record &b)
+                   { return a.time_ns < b.time_ns; });
+  for (const Record &record : batch)
+  {
+    append_time(out, record.time_ns);
+    out += ' ';
+    out += kLevelNames[static_cast<size_t>(record.level)];
+    out += ' ';
+    out.append(record.text, record.length);
+    out += '\n';
+  }
+  return true;
+}
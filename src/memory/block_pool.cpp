@@ -0,0 +1,236 @@
+/**
+ * @file block_pool.cpp
+ * @brief Реализация методов BlockPool
+ */
+
+#include "../include/memory/block_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+namespace
+{
+  constexpr size_t kClasses = 35;           ///< 32..128 с шагом 16 и по четыре на удвоение до kMaxBlock
+  constexpr size_t kSlabSize = 64 * 1024;   ///< Слаб, нарезаемый на блоки
+  constexpr size_t kBatchBytes = 16 * 1024; ///< Объем пачки между потоком и общим списком
+
+  /// Свободный блок; голова пачки в общем списке хранит ее длину и следующую пачку
+  struct Block
+  {
+    Block *next;       ///< Следующий блок списка
+    Block *next_batch; ///< Следующая пачка общего списка
+    size_t count;      ///< Блоков в пачке
+  };
+
+  constexpr size_t class_size(size_t c)
+  {
+    return c < 7 ? 32 + 16 * c : (size_t(128) << ((c - 7) / 4)) + (size_t(32) << ((c - 7) / 4)) * ((c - 7) % 4 + 1);
+  }
+
+  static_assert(class_size(kClasses - 1) == BlockPool::kMaxBlock, "last size class must be kMaxBlock");
+  static_assert(sizeof(Block) <= class_size(0), "smallest block must hold the free-list header");
+
+  size_t class_of(size_t bytes) noexcept
+  {
+    if (bytes <= 128)
+      return bytes <= 32 ? 0 : (bytes - 17) / 16;
+    size_t b = bytes - 1;
+    size_t p = 63 - static_cast<size_t>(__builtin_clzll(b));
+    return 7 + (p - 7) * 4 + ((b - (size_t(1) << p)) >> (p - 2));
+  }
+
+  /// Блоков в пачке: списки мелких классов длиннее, крупных — короче
+  constexpr size_t batch_of(size_t c)
+  {
+    return std::clamp<size_t>(kBatchBytes / class_size(c), 2, 32);
+  }
+
+  /// Общий список класса: пачки блоков от всех потоков
+  struct Central
+  {
+    std::mutex mutex;         ///< Защищает batches
+    Block *batches = nullptr; ///< Первая пачка
+  };
+
+  /// Списки никогда не разрушаются: блоки освобождаются и при разрушении статических объектов
+  Central *centrals()
+  {
+    static Central *central = new Central[kClasses];
+    return central;
+  }
+
+  std::atomic<uint64_t> slabs{0};
+  std::atomic<uint64_t> slab_bytes{0};
+  std::atomic<uint64_t> direct{0};
+
+  /// Свободные блоки одного класса в потоке
+  struct FreeList
+  {
+    Block *head;  ///< Первый блок
+    size_t count; ///< Длина списка
+  };
+
+  /// Кэш потока; тривиален, поэтому доступен и после завершения потока (dead)
+  struct ThreadCache
+  {
+    FreeList lists[kClasses]; ///< Списки по классам
+    bool ready;               ///< Возврат кэша при завершении потока подготовлен
+    bool dead;                ///< Поток завершается: блоки идут сразу в общие списки
+  };
+
+  thread_local ThreadCache cache;
+
+  void push_batch(size_t c, Block *head, size_t count) noexcept
+  {
+    head->count = count;
+    Central &central = centrals()[c];
+    std::lock_guard<std::mutex> lock(central.mutex);
+    head->next_batch = central.batches;
+    central.batches = head;
+  }
+
+  Block *pop_batch(size_t c, size_t &count) noexcept
+  {
+    Central &central = centrals()[c];
+    std::lock_guard<std::mutex> lock(central.mutex);
+    Block *head = central.batches;
+    if (head)
+    {
+      central.batches = head->next_batch;
+      count = head->count;
+    }
+    return head;
+  }
+
+  /// Отдать пачку из начала списка потока в общий список
+  void spill(FreeList &list, size_t c) noexcept
+  {
+    size_t count = std::min(batch_of(c), list.count);
+    Block *head = list.head;
+    Block *tail = head;
+    for (size_t i = 1; i < count; ++i)
+    {
+      tail = tail->next;
+    }
+    list.head = tail->next;
+    list.count -= count;
+    tail->next = nullptr;
+    push_batch(c, head, count);
+  }
+
+  /// Возвращает кэш потока в общие списки при завершении потока
+  struct Reaper
+  {
+    ~Reaper()
+    {
+      for (size_t c = 0; c < kClasses; ++c)
+      {
+        FreeList &list = cache.lists[c];
+        if (list.head)
+          push_batch(c, list.head, list.count);
+        list = FreeList{nullptr, 0};
+      }
+      cache.dead = true;
+    }
+  };
+
+  void prepare() noexcept
+  {
+    static thread_local Reaper reaper;
+    (void)reaper;
+    cache.ready = true;
+  }
+
+  /// Пополнить пустой список потока: пачка из общего списка или новый слаб
+  void refill(FreeList &list, size_t c)
+  {
+    size_t count = 0;
+    if (Block *batch = pop_batch(c, count))
+    {
+      list = FreeList{batch, count};
+      return;
+    }
+
+    char *slab = static_cast<char *>(::operator new(kSlabSize));
+    slabs.fetch_add(1, std::memory_order_relaxed);
+    slab_bytes.fetch_add(kSlabSize, std::memory_order_relaxed);
+    size_t size = class_size(c);
+    size_t blocks = kSlabSize / size;
+    for (size_t i = blocks; i-- > 0;)
+    {
+      auto *block = reinterpret_cast<Block *>(slab + i * size);
+      block->next = list.head;
+      list.head = block;
+    }
+    list.count = blocks;
+    // Список потока не длиннее двух пачек; остальное — в общий список
+    while (list.count > 2 * batch_of(c))
+    {
+      spill(list, c);
+    }
+  }
+}
+
+void *BlockPool::allocate(size_t bytes)
+{
+  if (bytes > kMaxBlock)
+  {
+    direct.fetch_add(1, std::memory_order_relaxed);
+    return ::operator new(bytes);
+  }
+
+  size_t c = class_of(bytes);
+  if (cache.dead)
+  {
+    // Блок вернется уже в пул, это безопасно: память слабов не освобождается
+    direct.fetch_add(1, std::memory_order_relaxed);
+    return ::operator new(class_size(c));
+  }
+  if (!cache.ready)
+    prepare();
+
+  FreeList &list = cache.lists[c];
+  if (!list.head)
+    refill(list, c);
+  Block *block = list.head;
+  list.head = block->next;
+  --list.count;
+  return block;
+}
+
+void BlockPool::deallocate(void *block, size_t bytes) noexcept
+{
+  if (!block)
+    return;
+  if (bytes > kMaxBlock)
+  {
+    ::operator delete(block);
+    return;
+  }
+
+  size_t c = class_of(bytes);
+  auto *freed = static_cast<Block *>(block);
+  if (cache.dead)
+  {
+    freed->next = nullptr;
+    push_batch(c, freed, 1);
+    return;
+  }
+  if (!cache.ready)
+    prepare();
+
+  FreeList &list = cache.lists[c];
+  freed->next = list.head;
+  list.head = freed;
+  if (++list.count > 2 * batch_of(c))
+    spill(list, c);
+}
+
+BlockPool::Stats BlockPool::stats() noexcept
+{
+  Stats stats;
+  stats.slabs = slabs.load(std::memory_order_relaxed);
+  stats.slab_bytes = slab_bytes.load(std::memory_order_relaxed);
+  stats.direct = direct.load(std::memory_order_relaxed);
+  return stats;
+}
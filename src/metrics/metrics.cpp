@@ -0,0 +1,167 @@
+/**
+ * @file metrics.cpp
+ * @brief Реализация методов Metrics и Histogram
+ */
+
+#include "../include/metrics/metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <iterator>
+
+namespace
+{
+  /// Имя и описание счетчика в Prometheus (в порядке Counter)
+  struct CounterInfo
+  {
+    const char *name;
+    const char *help;
+  };
+
+  constexpr CounterInfo kCounters[] = {
+      {"chat_accepts_total", "Accepted client connections"},
+      {"chat_rejected_connections_total", "Connections refused over the connection limit"},
+      {"chat_accept_rate_limited_total", "Connections reset over the server-wide connection rate"},
+      {"chat_source_rate_limited_total", "Connections reset over the per-address connection rate"},
+      {"chat_disconnects_total", "Closed client connections"},
+      {"chat_bytes_received_total", "Bytes read from client sockets"},
+      {"chat_bytes_sent_total", "Bytes written to client sockets"},
+      {"chat_messages_framed_total", "Messages parsed from client input"},
+      {"chat_deliveries_total", "Messages queued to recipients"},
+      {"chat_direct_messages_total", "Direct messages sent with /msg"},
+      {"chat_send_errors_total", "Failed socket writes"},
+      {"chat_dropped_messages_total", "Messages dropped for slow consumers"},
+      {"chat_dropped_bytes_total", "Bytes dropped for slow consumers"},
+      {"chat_slow_consumer_disconnects_total", "Clients disconnected as slow consumers"},
+      {"chat_timeouts_total", "Clients disconnected by handshake, idle or ping timeouts"},
+      {"chat_log_dropped_total", "Log records dropped because a thread's log ring was full"},
+      {"chat_store_appended_total", "Messages queued to the durable message log"},
+      {"chat_store_dropped_total", "Messages dropped because the message log write queue was full"},
+      {"chat_store_commits_total", "Group commits (fdatasync) of the message log"},
+      {"chat_store_bytes_total", "Bytes written to message log segments"},
+      {"chat_store_errors_total", "Failed message log batch write attempts (each retry counts)"},
+      {"chat_cluster_sent_total", "Messages forwarded to other cluster nodes (one per node)"},
+      {"chat_cluster_received_total", "Messages received from other cluster nodes"},
+      {"chat_cluster_duplicates_total", "Duplicate or looped-back cluster messages discarded"},
+      {"chat_cluster_lost_total", "Gaps in per-origin cluster sequence numbers"},
+      {"chat_cluster_dropped_total", "Messages not forwarded because a node was unreachable or its queue was full"},
+      {"chat_cluster_rejected_total", "Incoming cluster connections refused: unlisted address or wrong secret"},
+  };
+  static_assert(std::size(kCounters) == static_cast<size_t>(Counter::Count), "every counter needs a name");
+
+  constexpr CounterInfo kLatencies[] = {
+      {"chat_delivery_latency_seconds", "Time from reading a message to queueing it for its last subscriber across all shards"},
+      {"chat_handler_seconds", "Time spent in the message handler chain per message"},
+      {"chat_store_commit_seconds", "Time to write and fdatasync one message log batch"},
+      {"chat_cluster_latency_seconds", "Time from publishing on the origin node to receiving on another node"},
+  };
+  static_assert(std::size(kLatencies) == static_cast<size_t>(Latency::Count), "every latency needs a name");
+
+  constexpr double kQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+  void append(std::string &out, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+  void append(std::string &out, const char *format, ...)
+  {
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    int len = std::vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (len > 0)
+      out.append(line, std::min(static_cast<size_t>(len), sizeof(line) - 1));
+  }
+}
+
+uint64_t Histogram::Snapshot::quantile(double q) const noexcept
+{
+  if (count == 0)
+    return 0;
+  uint64_t rank = static_cast<uint64_t>(std::ceil(q * static_cast<double>(count)));
+  rank = std::max<uint64_t>(rank, 1);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBuckets; ++i)
+  {
+    seen += buckets[i];
+    if (seen >= rank)
+      return i + 1 < kBuckets ? bucket_floor(i + 1) - 1 : bucket_floor(i);
+  }
+  return bucket_floor(kBuckets - 1);
+}
+
+void Histogram::merge_into(Snapshot &out) const noexcept
+{
+  for (size_t i = 0; i < kBuckets; ++i)
+  {
+    out.buckets[i] += buckets_[i].load(std::memory_order_relaxed);
+  }
+  out.count += count_.load(std::memory_order_relaxed);
+  out.sum += sum_.load(std::memory_order_relaxed);
+}
+
+Metrics::Registry &Metrics::registry()
+{
+  static Registry instance;
+  return instance;
+}
+
+Metrics::ThreadSlot *Metrics::attach()
+{
+  auto slot = std::make_unique<ThreadSlot>();
+  ThreadSlot *raw = slot.get();
+  Registry &reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  reg.slots.push_back(std::move(slot));
+  return raw;
+}
+
+Metrics::Snapshot Metrics::snapshot()
+{
+  Snapshot result;
+  Registry &reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  for (const auto &slot : reg.slots)
+  {
+    for (size_t i = 0; i < result.counters.size(); ++i)
+    {
+      result.counters[i] += slot->counters[i].load(std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < result.latencies.size(); ++i)
+    {
+      slot->latencies[i].merge_into(result.latencies[i]);
+    }
+  }
+  return result;
+}
+
+void Metrics::write_prometheus(std::string &out, const Snapshot &snapshot)
+{
+  for (size_t i = 0; i < snapshot.counters.size(); ++i)
+  {
+    append(out, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", kCounters[i].name, kCounters[i].help,
+           kCounters[i].name, kCounters[i].name, static_cast<unsigned long long>(snapshot.counters[i]));
+  }
+  for (size_t i = 0; i < snapshot.latencies.size(); ++i)
+  {
+    const auto &histogram = snapshot.latencies[i];
+    const char *name = kLatencies[i].name;
+    append(out, "# HELP %s %s\n# TYPE %s summary\n", name, kLatencies[i].help, name);
+    for (double q : kQuantiles)
+    {
+      append(out, "%s{quantile=\"%g\"} %.9f\n", name, q, static_cast<double>(histogram.quantile(q)) / 1e9);
+    }
+    append(out, "%s_sum %.9f\n%s_count %llu\n", name, static_cast<double>(histogram.sum) / 1e9,
+           name, static_cast<unsigned long long>(histogram.count));
+  }
+}
+
+void Metrics::write_counter(std::string &out, const char *name, const char *help, uint64_t value)
+{
+  append(out, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", name, help, name, name, static_cast<unsigned long long>(value));
+}
+
+void Metrics::write_gauge(std::string &out, const char *name, const char *help, double value)
+{
+  append(out, "# HELP %s %s\n# TYPE %s gauge\n%s %.17g\n", name, help, name, name, value);
+}
@@ -0,0 +1,105 @@
+/**
+ * @file metrics_listener.cpp
+ * @brief Реализация методов MetricsListener
+ */
+
+#include "../include/metrics/metrics_listener.h"
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+  constexpr size_t kMaxRequest = 8 * 1024; ///< Предельный размер заголовков запроса
+}
+
+MetricsListener::MetricsListener(EventLoop &loop, int domain, const std::string &ip, int port, Source source)
+    : loop_(loop), listener_(domain, SOCK_STREAM, 0), source_(std::move(source))
+{
+  listener_.universal_struct_parameters(ip, port);
+  listener_.bind_socket();
+  listener_.listen_socket(16);
+  listener_.set_nonblocking();
+  loop_.add(listener_.fd(), EPOLLIN, [this](uint32_t)
+            { accept(); });
+}
+
+MetricsListener::~MetricsListener()
+{
+  for (auto &peer : peers_)
+  {
+    loop_.remove(peer.first);
+  }
+  loop_.remove(listener_.fd());
+}
+
+void MetricsListener::accept()
+{
+  for (;;)
+  {
+    int fd = listener_.try_accept(NULL, NULL);
+    if (fd < 0)
+    {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      return;
+    }
+
+    auto peer = std::make_unique<Peer>(Peer{Socket(fd), {}, {}});
+    peers_.emplace(fd, std::move(peer));
+    loop_.add(fd, EPOLLIN | EPOLLRDHUP, [this, fd](uint32_t events)
+              { serve(fd, events); });
+  }
+}
+
+void MetricsListener::serve(int fd, uint32_t events)
+{
+  auto it = peers_.find(fd);
+  if (it == peers_.end())
+    return;
+  Peer &peer = *it->second;
+
+  if (peer.reply.empty())
+  {
+    char buf[1024];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+    {
+      peer.request.append(buf, static_cast<size_t>(n));
+    }
+    bool closed = n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
+    if (peer.request.find("\r\n\r\n") == std::string::npos && peer.request.find("\n\n") == std::string::npos)
+    {
+      if (closed || (events & (EPOLLERR | EPOLLHUP)) || peer.request.size() > kMaxRequest)
+        drop(fd);
+      return;
+    }
+
+    std::string body = source_();
+    peer.reply = "HTTP/1.0 200 OK\r\n"
+                 "Content-Type: text/plain; version=0.0.4\r\n"
+                 "Content-Length: " +
+                 std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+    loop_.modify(fd, EPOLLOUT);
+  }
+
+  while (!peer.reply.empty())
+  {
+    ssize_t n = send(fd, peer.reply.data(), peer.reply.size(), MSG_NOSIGNAL);
+    if (n < 0)
+    {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return;
+      break;
+    }
+    peer.reply.erase(0, static_cast<size_t>(n));
+  }
+  drop(fd);
+}
+
+void MetricsListener::drop(int fd)
+{
+  loop_.remove(fd);
+  peers_.erase(fd);
+}
@@ -0,0 +1,145 @@
+/**
+ * @file accept_limiter.cpp
+ * @brief Реализация методов AcceptLimiter
+ */
+
+#include "../include/net/connection/accept_limiter.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <netinet/in.h>
+
+AcceptLimiter::Bucket::Bucket(Rate rate)
+{
+  if (rate.per_second <= 0)
+    return;
+  interval = std::max<int64_t>(1, static_cast<int64_t>(1e9 / rate.per_second));
+  size_t burst = rate.burst > 0 ? rate.burst : std::max<size_t>(1, static_cast<size_t>(rate.per_second));
+  tolerance = interval * static_cast<int64_t>(burst - 1);
+}
+
+int64_t AcceptLimiter::Bucket::take(int64_t tat, int64_t now) const noexcept
+{
+  if (now < tat - tolerance)
+    return -1;
+  return std::max(tat, now) + interval;
+}
+
+size_t AcceptLimiter::SourceHash::operator()(const SourceKey &key) const noexcept
+{
+  // Перемешивание (splitmix64): у соседних адресов различаются младшие байты
+  uint64_t x = key.hi * 0x9E3779B97F4A7C15ull ^ key.lo;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return static_cast<size_t>(x ^ (x >> 31));
+}
+
+AcceptLimiter::AcceptLimiter(Rate global, Rate per_source, size_t max_sources)
+    : global_(global), source_(per_source), stripe_limit_(std::max<size_t>(1, max_sources / kStripes))
+{
+  if (source_.enabled())
+    stripes_ = std::make_unique<Stripe[]>(kStripes);
+}
+
+AcceptLimiter::Verdict AcceptLimiter::admit(const sockaddr *peer, Clock::time_point now) noexcept
+{
+  int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+  if (source_.enabled() && peer)
+  {
+    SourceKey key;
+    bool known = true;
+    if (peer->sa_family == AF_INET)
+    {
+      const auto *in = reinterpret_cast<const sockaddr_in *>(peer);
+      key.lo = 0xFFFF00000000ull | ntohl(in->sin_addr.s_addr);
+    }
+    else if (peer->sa_family == AF_INET6)
+    {
+      const auto *in6 = reinterpret_cast<const sockaddr_in6 *>(peer);
+      memcpy(&key.hi, in6->sin6_addr.s6_addr, 8);
+      memcpy(&key.lo, in6->sin6_addr.s6_addr + 8, 8);
+    }
+    else
+    {
+      known = false;
+    }
+    if (known && !admit_source(key, ns))
+      return Verdict::SourceLimit;
+  }
+  if (global_.enabled() && !admit_global(ns))
+    return Verdict::GlobalLimit;
+  return Verdict::Accept;
+}
+
+bool AcceptLimiter::admit_global(int64_t now) noexcept
+{
+  int64_t tat = global_tat_.load(std::memory_order_relaxed);
+  for (;;)
+  {
+    int64_t next = global_.take(tat, now);
+    if (next < 0)
+      return false;
+    if (global_tat_.compare_exchange_weak(tat, next, std::memory_order_relaxed))
+      return true;
+  }
+}
+
+bool AcceptLimiter::admit_source(const SourceKey &key, int64_t now) noexcept
+{
+  size_t hash = SourceHash()(key);
+  Stripe &stripe = stripes_[hash % kStripes];
+  std::lock_guard<std::mutex> lock(stripe.mutex);
+
+  auto it = stripe.tats.find(key);
+  if (it != stripe.tats.end())
+  {
+    int64_t next = source_.take(it->second, now);
+    if (next < 0)
+      return false;
+    it->second = next;
+    return true;
+  }
+
+  if (stripe.tats.size() >= stripe_limit_)
+  {
+    if (now < stripe.sweep_at)
+      return true;
+    // Полные ведра ничего не помнят: их записи можно выбросить
+    int64_t earliest = INT64_MAX;
+    for (auto drop = stripe.tats.begin(); drop != stripe.tats.end();)
+    {
+      if (drop->second <= now)
+      {
+        drop = stripe.tats.erase(drop);
+        continue;
+      }
+      earliest = std::min(earliest, drop->second);
+      ++drop;
+    }
+    stripe.sweep_at = earliest;
+    if (stripe.tats.size() >= stripe_limit_)
+      return true;
+  }
+  try
+  {
+    stripe.tats.emplace(key, source_.take(0, now));
+  }
+  catch (std::exception &)
+  {
+    // Без записи адрес ограничивает только общее ведро
+  }
+  return true;
+}
+
+size_t AcceptLimiter::sources() const noexcept
+{
+  size_t count = 0;
+  if (!stripes_)
+    return count;
+  for (size_t i = 0; i < kStripes; ++i)
+  {
+    std::lock_guard<std::mutex> lock(stripes_[i].mutex);
+    count += stripes_[i].tats.size();
+  }
+  return count;
+}
@@ -0,0 +1,55 @@
+/**
+ * @file client_registry.cpp
+ * @brief Реализация методов ClientRegistry
+ */
+
+#include "../include/net/connection/client_registry.h"
+
+namespace
+{
+  const std::shared_ptr<Connection> kNoClient; ///< Результат find() для неизвестного дескриптора
+}
+
+void ClientRegistry::add(std::shared_ptr<Connection> client)
+{
+  size_t fd = static_cast<size_t>(client->fd());
+  if (fd >= slots_.size())
+  {
+    slots_.resize(fd + 1, kNoSlot);
+  }
+  slots_[fd] = static_cast<uint32_t>(clients_.size());
+  clients_.push_back(std::move(client));
+  count_.store(clients_.size(), std::memory_order_relaxed);
+}
+
+bool ClientRegistry::remove(int fd)
+{
+  if (fd < 0 || static_cast<size_t>(fd) >= slots_.size() || slots_[fd] == kNoSlot)
+    return false;
+
+  // Последний элемент занимает место удаляемого
+  uint32_t slot = slots_[fd];
+  slots_[fd] = kNoSlot;
+  if (slot != clients_.size() - 1)
+  {
+    clients_[slot] = std::move(clients_.back());
+    slots_[clients_[slot]->fd()] = slot;
+  }
+  clients_.pop_back();
+  count_.store(clients_.size(), std::memory_order_relaxed);
+  return true;
+}
+
+const std::shared_ptr<Connection> &ClientRegistry::find(int fd) const noexcept
+{
+  if (fd < 0 || static_cast<size_t>(fd) >= slots_.size() || slots_[fd] == kNoSlot)
+    return kNoClient;
+  return clients_[slots_[fd]];
+}
+
+void ClientRegistry::clear()
+{
+  clients_.clear();
+  slots_.clear();
+  count_.store(0, std::memory_order_relaxed);
+}
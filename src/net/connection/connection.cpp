@@ -0,0 +1,141 @@
+/**
+ * @file connection.cpp
+ * @brief Реализация методов Connection
+ */
+
+#include "../include/net/connection/connection.h"
+#include "../include/metrics/metrics.h"
+#include <algorithm>
+#include <cerrno>
+#include <sys/socket.h>
+
+Connection::Connection(std::shared_ptr<Socket> socket, size_t max_frame_size)
+    : socket_(std::move(socket)), framer_(max_frame_size) {}
+
+bool Connection::select_room(std::string_view room) noexcept
+{
+  auto it = std::find_if(rooms_.begin(), rooms_.end(), [&](const Subscription &joined)
+                         { return joined.room->view() == room; });
+  if (it == rooms_.end())
+    return false;
+  room_ = it->room;
+  return true;
+}
+
+void Connection::subscribe(MessageRef room, uint32_t slot)
+{
+  rooms_.push_back({room, slot});
+  room_ = std::move(room);
+}
+
+bool Connection::unsubscribe(std::string_view room, Subscription &removed)
+{
+  auto it = std::find_if(rooms_.begin(), rooms_.end(), [&](const Subscription &joined)
+                         { return joined.room->view() == room; });
+  if (it == rooms_.end())
+    return false;
+
+  // room может ссылаться на удаляемое имя: переносим подписку до erase
+  removed = std::move(*it);
+  rooms_.erase(it);
+  if (room_.get() == removed.room.get())
+  {
+    room_ = rooms_.empty() ? MessageRef() : rooms_.back().room;
+  }
+  return true;
+}
+
+void Connection::set_slot(const MessageBuffer *room, uint32_t slot) noexcept
+{
+  for (auto &joined : rooms_)
+  {
+    if (joined.room.get() == room)
+    {
+      joined.slot = slot;
+      return;
+    }
+  }
+}
+
+void Connection::enqueue(Payload data)
+{
+  if (data->empty())
+    return;
+  pending_bytes_ += data->size();
+  outbound_.push_back(std::move(data));
+}
+
+void Connection::consume(size_t bytes)
+{
+  pending_bytes_ -= bytes;
+  while (bytes > 0 && !outbound_.empty())
+  {
+    size_t left = outbound_.front()->size() - front_offset_;
+    if (bytes < left)
+    {
+      front_offset_ += bytes;
+      return;
+    }
+    bytes -= left;
+    outbound_.pop_front();
+    front_offset_ = 0;
+    if (in_flight_ > 0)
+      --in_flight_;
+  }
+}
+
+size_t Connection::drop_oldest(size_t target, size_t &bytes)
+{
+  bytes = 0;
+  // Частично отправленное и уже переданные ядру сообщения должны дойти целиком
+  size_t keep = std::max(in_flight_, front_offset_ > 0 ? size_t(1) : size_t(0));
+  size_t dropped = 0;
+  while (pending_bytes_ > target && keep + dropped < outbound_.size())
+  {
+    size_t size = outbound_[keep + dropped]->size();
+    bytes += size;
+    pending_bytes_ -= size;
+    ++dropped;
+  }
+  // Отброшенные сообщения идут подряд: очередь сдвигается один раз
+  outbound_.erase(keep, dropped);
+  return dropped;
+}
+
+size_t Connection::gather(iovec *iov, size_t max) const noexcept
+{
+  size_t count = std::min(max, outbound_.size());
+  size_t offset = front_offset_;
+  for (size_t i = 0; i < count; ++i)
+  {
+    const MessageRef &message = outbound_[i];
+    iov[i].iov_base = const_cast<char *>(message->data() + offset);
+    iov[i].iov_len = message->size() - offset;
+    offset = 0;
+  }
+  return count;
+}
+
+bool Connection::flush()
+{
+  iovec iov[kMaxIov];
+  msghdr hdr{};
+  hdr.msg_iov = iov;
+  while (has_pending_output())
+  {
+    hdr.msg_iovlen = gather(iov, kMaxIov);
+    ssize_t sent = ::sendmsg(socket_->fd(), &hdr, MSG_NOSIGNAL);
+    if (sent < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return true; // Дождемся EPOLLOUT
+      Metrics::add(Counter::SendErrors);
+      return false;
+    }
+    Metrics::add(Counter::BytesOut, static_cast<uint64_t>(sent));
+    consume(static_cast<size_t>(sent));
+  }
+  return true;
+}
@@ -4,11 +4,125 @@
  */
 
 #include <string>
-#include <iostream>
 #include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
 #include "../include/net/connection/connectionManager.h"
+#include "../include/log/logger.h"
+#include "../include/memory/block_pool.h"
+#include "../include/metrics/metrics.h"
 
-connectionManager::connectionManager(int domain, int type, int protocol, std::unique_ptr<IMessageHandler> handler) : serverSocket_(domain, type, protocol), handler_(std::move(handler)), running_(true) {}
+namespace
+{
+  const std::string kExitCommand = "/quit"; ///< Команда отключения клиента
+
+  const IIoBackend::Payload kWelcome =
+      MessageBuffer::create({"Welcome to chat! Commands: /join <room>, /leave [room], /nick <name>, /msg <nick> <text>, /stats, ", kExitCommand, "\n"});
+  const IIoBackend::Payload kNoNick = MessageBuffer::create({"Set a nickname first: /nick <name>\n"});
+  const IIoBackend::Payload kNoRoom = MessageBuffer::create({"You are not in a room. Use /join <room>\n"});
+  const IIoBackend::Payload kGoodbye = MessageBuffer::create({"Goodbye! Disconnecting...\n"});
+  const IIoBackend::Payload kBusy = MessageBuffer::create({"Server is busy, message dropped\n"});
+  constexpr std::string_view kFull = "Server is full, try again later\n";
+
+  /// Шаг колеса таймеров: точность сроков подключений
+  constexpr std::chrono::milliseconds kTimerTick{100};
+
+  /// В журнал (уровень debug) попадает одно входящее сообщение из стольких
+  constexpr uint32_t kReceivedLogEvery = 100;
+
+  /// Сообщения, которые не обработал ни один обработчик, в журнале прореживаются так же
+  LogSampler unhandled(kReceivedLogEvery);
+
+  /// Собрать бинарный кадр из двух участков тела
+  MessageRef make_frame(FrameType type, std::string_view head, std::string_view tail = std::string_view())
+  {
+    unsigned char header[kMaxVarintSize + 1];
+    size_t len = encode_varint(static_cast<uint32_t>(head.size() + tail.size() + 1), header);
+    header[len++] = static_cast<unsigned char>(type);
+    return MessageBuffer::create({std::string_view(reinterpret_cast<const char *>(header), len), head, tail});
+  }
+
+  /// Перекодировать текстовое сообщение (с "\n" на конце) в бинарный кадр
+  MessageRef to_binary(const MessageBuffer &text)
+  {
+    std::string_view body = text.view();
+    if (!body.empty() && body.back() == '\n')
+      body.remove_suffix(1);
+    return make_frame(FrameType::Message, body);
+  }
+
+  const IIoBackend::Payload kGoodbyeBinary = to_binary(*kGoodbye);
+  const IIoBackend::Payload kPing = make_frame(FrameType::Ping, std::string_view());
+
+  /**
+   * @brief Включить TCP keepalive
+   * @details Полуоткрытое подключение (клиент пропал без FIN) обнаруживает ядро:
+   * после idle простоя шлются пробы, без ответа на probes из них подключение
+   * рвется. TCP_USER_TIMEOUT тем же сроком ограничивает неподтвержденные
+   * данные, чтобы запись исчезнувшему клиенту не висела минутами повторов.
+   * Ошибки игнорируются: без keepalive подключение работает как прежде.
+   */
+  void set_keepalive(int fd, std::chrono::seconds idle, std::chrono::seconds interval, int probes) noexcept
+  {
+    int on = 1;
+    int idle_s = static_cast<int>(idle.count());
+    int interval_s = std::max(1, static_cast<int>(interval.count()));
+    unsigned user_timeout_ms = static_cast<unsigned>((idle_s + interval_s * probes) * 1000);
+    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &idle_s, sizeof(idle_s));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &interval_s, sizeof(interval_s));
+    setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &probes, sizeof(probes));
+    setsockopt(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, &user_timeout_ms, sizeof(user_timeout_ms));
+  }
+}
+
+thread_local connectionManager::HandlerScope connectionManager::handlerScope_;
+
+connectionManager::connectionManager(int domain, int type, int protocol, std::unique_ptr<IMessageHandler> handler, ServerConfig config) : handler_(std::move(handler)), running_(true), config_(config),
+      accept_limiter_({config.accept_rate_, config.accept_burst_}, {config.accept_rate_per_ip_, config.accept_burst_per_ip_},
+                      config.accept_sources_)
+{
+  size_t shards = config.shards_;
+  if (shards == 0)
+  {
+    shards = std::max(1u, std::thread::hardware_concurrency());
+  }
+  shards_.reserve(shards);
+  for (size_t i = 0; i < shards; ++i)
+  {
+    auto shard = std::make_unique<Shard>(i, domain, type, protocol, kTimerTick, config_);
+    Shard *raw = shard.get();
+    shard->io = make_io_backend(
+        config.io_backend_, shard->loop,
+        [this, raw](const std::shared_ptr<Connection> &client)
+        { handleClient(*raw, client); },
+        [this, raw](const std::shared_ptr<Connection> &client)
+        { closeClient(*raw, client); },
+        WriteCoalescing{config.write_coalesce_delay_, config.write_coalesce_bytes_});
+    shards_.push_back(std::move(shard));
+  }
+
+  if (config.handler_threads_ > 0)
+  {
+    handlers_ = std::make_unique<HandlerPool>(
+        config.handler_threads_, config.handler_queue_capacity_,
+        [this](HandlerPool::Job &job)
+        { runHandler(job); });
+  }
+
+  if (!config.store_dir_.empty())
+  {
+    store_ = std::make_unique<MessageLog>(config.store_dir_);
+  }
+}
 connectionManager::~connectionManager()
 {
   // Остановка
@@ -19,12 +133,78 @@ void connectionManager::start(const std::string &ip, const int port)
 {
   try
   {
-    serverSocket_.universal_struct_parameters(ip, port);
-    serverSocket_.bind_socket();
-    serverSocket_.listen_socket(5);
+    for (auto &shard : shards_)
+    {
+      // Каждый шард слушает тот же адрес, ядро распределяет подключения между ними
+      shard->serverSocket.set_reuseport();
+      shard->serverSocket.universal_struct_parameters(ip, port);
+      shard->serverSocket.bind_socket();
+      shard->serverSocket.listen_socket(config_.listen_backlog_);
+      shard->serverSocket.set_nonblocking();
 
-    // Запуск потока для приема подключений
-    thread_accept_ = std::thread(&connectionManager::acceptClients, this);
+      Shard *raw = shard.get();
+      shard->loop.add(shard->serverSocket.fd(), EPOLLIN | EPOLLET, [this, raw](uint32_t)
+                      { acceptClients(*raw); });
+    }
+
+    if (config_.admin_port_ != 0)
+    {
+      admin_ = std::make_unique<MetricsListener>(
+          shards_.front()->loop, ip.find(':') == std::string::npos ? AF_INET : AF_INET6, ip, config_.admin_port_,
+          [this]
+          { return metrics_text(); });
+    }
+
+    if (config_.cluster_port_ != 0)
+    {
+      ClusterBridge::Options options;
+      options.ip = config_.cluster_ip_.empty() ? ip : config_.cluster_ip_;
+      options.port = config_.cluster_port_;
+      options.peers = config_.cluster_peers_;
+      options.secret = config_.cluster_secret_;
+      cluster_ = std::make_unique<ClusterBridge>(
+          std::move(options), [this](std::vector<ClusterBridge::Inbound> &&batch)
+          {
+            // Одна задача на шард для всей пачки, принятой за одно чтение
+            for (const auto &message : batch)
+            {
+              message.text->set_fanout(static_cast<uint32_t>(shards_.size()));
+            }
+            auto shared = std::make_shared<const std::vector<ClusterBridge::Inbound>>(std::move(batch));
+            for_each_shard([this, shared](Shard &shard)
+                           {
+              for (const auto &message : *shared)
+              {
+                deliverLocal(shard, nullptr, message.room, message.text);
+              } }); });
+    }
+
+    // Запуск потоков циклов событий
+    for (auto &shard : shards_)
+    {
+      Shard *raw = shard.get();
+      shard->thread = std::thread([raw]
+                                  {
+        try
+        {
+          raw->loop.run();
+        }
+        catch (std::exception &e)
+        {
+          // Остановившийся шард бросил бы своих клиентов, слушающий сокет
+          // (ядро продолжало бы отдавать ему подключения) и потоки пула,
+          // ждущие его задач: процесс завершается, а не работает без шарда
+          Log::write(LogLevel::Error, "Shard %zu event loop failed, terminating: %s", raw->index, e.what());
+          Log::flush();
+          std::abort();
+        }
+        catch (...)
+        {
+          Log::write(LogLevel::Error, "Shard %zu event loop failed, terminating", raw->index);
+          Log::flush();
+          std::abort();
+        } });
+    }
   }
   catch (...)
   {
@@ -38,121 +218,772 @@ void connectionManager::stop()
     return;
   running_ = false;
 
-  if (thread_accept_.joinable())
+  // Сначала пул: его потоки могут ждать задачи, выполняемые циклами шардов
+  if (handlers_)
   {
-    serverSocket_.shutdown();
-    thread_accept_.join();
+    handlers_->stop();
   }
-
+  for (auto &shard : shards_)
+  {
+    shard->loop.stop();
+  }
+  for (auto &shard : shards_)
   {
-    std::lock_guard<std::mutex> lock(clientsMutex_);
-    for (auto &client : active_clients_)
+    if (shard->thread.joinable())
     {
-      client->shutdown();
+      shard->thread.join();
     }
-    active_clients_.clear();
+    shard->serverSocket.shutdown();
+
+    // Поток шарда остановлен, подключения можно закрывать из текущего потока
+    shard->clients.for_each([](const std::shared_ptr<Connection> &client)
+                            { client->socket()->shutdown(); });
+    shard->clients.clear();
   }
+  // Задачи, которые мост успеет передать остановленным шардам, уже не выполнятся
+  cluster_.reset();
+  admin_.reset();
+  // Потоки шардов остановлены: новых сообщений нет, журнал фиксирует остаток очереди
+  store_.reset();
+}
 
-  for (auto &thread_client : thread_connection_clients_)
+const std::shared_ptr<Connection> *connectionManager::localClient(const std::shared_ptr<Socket> &socket, Shard *&shard) const
+{
+  for (auto &candidate : shards_)
   {
-    if (thread_client.joinable())
-    {
-      thread_client.join();
-    }
+    if (!candidate->loop.in_loop_thread())
+      continue;
+    const auto &client = candidate->clients.find(socket->fd());
+    if (!client || client->socket() != socket)
+      break;
+    shard = candidate.get();
+    return &client;
+  }
+
+  // Поток пула: клиент известен по обрабатываемому сообщению
+  if (handlerScope_.client && handlerScope_.client->socket() == socket)
+  {
+    shard = handlerScope_.shard;
+    return nullptr;
   }
-  thread_connection_clients_.clear();
+  throw std::logic_error("Client is not served by the current thread");
 }
-void connectionManager::acceptClients()
+
+template <typename Fn>
+void connectionManager::runOnClient(const std::shared_ptr<Socket> &socket, Fn fn)
 {
-  while (running_)
+  Shard *shard = nullptr;
+  if (const auto *client = localClient(socket, shard))
   {
+    fn(*shard, *client);
+    return;
+  }
+  shard->loop.post([shard, socket, fn]
+                   {
+    const auto &client = shard->clients.find(socket->fd());
+    if (client && client->socket() == socket)
+      fn(*shard, client); });
+}
+
+template <typename R, typename Fn>
+R connectionManager::callOnClient(const std::shared_ptr<Socket> &socket, R fallback, Fn fn)
+{
+  Shard *shard = nullptr;
+  if (const auto *client = localClient(socket, shard))
+    return fn(*shard, *client);
+
+  std::promise<R> result;
+  shard->loop.post([&]
+                   {
     try
     {
-      Socket client = serverSocket_.accept_socket(NULL, NULL);
+      const auto &client = shard->clients.find(socket->fd());
+      result.set_value(client && client->socket() == socket ? fn(*shard, client) : fallback);
+    }
+    catch (...)
+    {
+      result.set_exception(std::current_exception());
+    } });
+  return result.get_future().get();
+}
 
-      if (!running_)
-      {
-        client.close_socket();
-        break;
-      }
+void connectionManager::broadcast(const std::shared_ptr<Socket> &sender, const MessageRef &msg)
+{
+  if (!sender)
+  {
+    if (store_)
+      store_->append(MessageRef(), msg);
+    if (cluster_)
+      cluster_->publish(MessageRef(), msg);
+    msg->set_fanout(static_cast<uint32_t>(shards_.size()));
+    for_each_shard([this, msg](Shard &shard)
+                   { deliverLocal(shard, nullptr, MessageRef(), msg); });
+    return;
+  }
 
-      auto client_ptr = std::make_shared<Socket>(std::move(client));
-      {
-        std::lock_guard<std::mutex> lock(clientsMutex_);
-        active_clients_.push_back(client_ptr);
-      }
-      auto worker_ = std::thread(&connectionManager::handleClient, this, client_ptr);
-      thread_connection_clients_.emplace_back(std::move(worker_));
+  runOnClient(sender, [this, sender, msg](Shard &shard, const std::shared_ptr<Connection> &client)
+              {
+    MessageRef room = client->room();
+    if (!room)
+    {
+      MessageRef binary;
+      deliver(shard, client, kNoRoom, binary);
+      return;
     }
-    catch (std::system_error &e)
+
+    // Один буфер на все шарды, всех получателей, журнал на диске и другие узлы
+    if (store_)
+      store_->append(room, msg);
+    if (cluster_)
+      cluster_->publish(room, msg);
+    msg->set_fanout(static_cast<uint32_t>(shards_.size()));
+    for_each_shard([this, sender, room, msg](Shard &target)
+                   { deliverLocal(target, sender, room, msg); }); });
+}
+
+connectionManager::RoomChange connectionManager::join(const std::shared_ptr<Socket> &socket, std::string_view room,
+                                                     const MessageRef &confirmation)
+{
+  return callOnClient(socket, RoomChange::Unchanged, [this, room, &confirmation](Shard &shard, const std::shared_ptr<Connection> &client)
+                      {
+    bool joined = client->select_room(room);
+    if (!joined)
     {
-      if (running_)
-        std::cerr << "Accept failed: " << e.what() << '\n';
-      break;
+      if (client->rooms().size() >= config_.max_rooms_per_client_)
+        return RoomChange::LimitReached;
+      // Всё с номером от этой отметки клиент получит рассылкой, а не из истории;
+      // до конца задачи шард не разошлет ничего нового, поэтому ответ и история идут первыми
+      client->set_history_mark(shard.history.sequence());
+      joinRoom(shard, *client, room);
     }
-    catch (...)
+    MessageRef binary;
+    deliver(shard, client, confirmation, binary);
+    if (joined)
+      return RoomChange::Unchanged;
+    sendHistory(shard, client, room);
+    return RoomChange::Done; });
+}
+
+connectionManager::RoomChange connectionManager::leave(const std::shared_ptr<Socket> &socket, std::string_view room)
+{
+  return callOnClient(socket, RoomChange::Unchanged, [this, room](Shard &shard, const std::shared_ptr<Connection> &client)
+                      {
+    std::string_view name = room;
+    if (name.empty())
     {
-      if (running_)
-        std::cerr << "Unknown accept failed\n";
-      break;
+      if (!client->room())
+        return RoomChange::Unchanged;
+      name = client->room()->view();
+    }
+    Connection::Subscription removed;
+    if (!client->unsubscribe(name, removed))
+      return RoomChange::Unchanged;
+    leaveRoom(shard, removed);
+    return RoomChange::Done; });
+}
+
+MessageRef connectionManager::current_room(const std::shared_ptr<Socket> &socket) const
+{
+  // Константность сохраняется: действие только читает подписку клиента
+  auto *self = const_cast<connectionManager *>(this);
+  return self->callOnClient(socket, MessageRef(), [](Shard &, const std::shared_ptr<Connection> &client)
+                            { return client->room(); });
+}
+
+connectionManager::NickChange connectionManager::set_nick(const std::shared_ptr<Socket> &socket, std::string_view nick)
+{
+  return callOnClient(socket, NickChange::Unchanged, [this, nick](Shard &shard, const std::shared_ptr<Connection> &client)
+                      {
+    if (client->nick() == nick)
+      return NickChange::Unchanged;
+    uint64_t token = client->nick_token() != 0 ? client->nick_token() : names_.next_token();
+    NameIndex::Target target{static_cast<uint32_t>(shard.index), client->fd(), token};
+    if (!names_.claim(nick, target, client->nick()))
+      return NickChange::Taken;
+    client->set_nick(nick, token);
+    return NickChange::Done; });
+}
+
+void connectionManager::direct(const std::shared_ptr<Socket> &socket, std::string_view nick, std::string_view text)
+{
+  runOnClient(socket, [this, nick = std::string(nick), text = std::string(text)](Shard &shard, const std::shared_ptr<Connection> &client)
+              {
+    MessageRef binary;
+    NameIndex::Target target;
+    if (client->nick().empty())
+    {
+      deliver(shard, client, kNoNick, binary);
+      return;
+    }
+    if (!names_.find(nick, target) || target.shard >= shards_.size())
+    {
+      deliver(shard, client, MessageBuffer::create({"No such user: ", nick, "\n"}), binary);
+      return;
+    }
+
+    MessageRef msg = MessageBuffer::create({"[", client->nick(), " -> ", nick, "] ", text, "\n"});
+    Metrics::add(Counter::DirectMessages);
+    Shard *owner = shards_[target.shard].get();
+    auto enqueue = [this, owner, target, msg]
+    {
+      // Метка отличает владельца имени от нового подключения с тем же дескриптором
+      const auto &recipient = owner->clients.find(target.fd);
+      if (!recipient || recipient->nick_token() != target.token)
+        return;
+      MessageRef binary;
+      deliver(*owner, recipient, msg, binary);
+    };
+    if (owner == &shard)
+      enqueue();
+    else
+      owner->loop.post(enqueue); });
+}
+
+void connectionManager::reply(const std::shared_ptr<Socket> &socket, const MessageRef &msg)
+{
+  runOnClient(socket, [this, msg](Shard &shard, const std::shared_ptr<Connection> &client)
+              {
+    MessageRef binary;
+    deliver(shard, client, msg, binary); });
+}
+
+void connectionManager::joinRoom(Shard &shard, Connection &client, std::string_view room)
+{
+  uint32_t slot = 0;
+  MessageRef name = shard.rooms.join(room, client.fd(), slot);
+  client.subscribe(std::move(name), slot);
+}
+
+void connectionManager::leaveRoom(Shard &shard, const Connection::Subscription &subscription)
+{
+  int moved = shard.rooms.leave(subscription.room->view(), subscription.slot);
+  if (moved < 0)
+    return;
+  if (const auto &member = shard.clients.find(moved))
+    member->set_slot(subscription.room.get(), subscription.slot);
+}
+
+void connectionManager::sendHistory(Shard &shard, const std::shared_ptr<Connection> &client, std::string_view room)
+{
+  // Бинарная форма строится не больше одного раза на сообщение и остается в истории.
+  // Сообщения после подписки уже пришли рассылкой и не повторяются
+  uint64_t mark = client->history_mark();
+  shard.history.for_each(room, [&](RoomHistory::Entry &entry)
+                         {
+    if (entry.seq < mark)
+      deliver(shard, client, entry.text, entry.binary); });
+}
+
+HandlerPool::Stats connectionManager::handler_stats() const noexcept
+{
+  return handlers_ ? handlers_->stats() : HandlerPool::Stats();
+}
+
+connectionManager::SlowConsumerStats connectionManager::slow_consumer_stats() const noexcept
+{
+  Metrics::Snapshot metrics = Metrics::snapshot();
+  SlowConsumerStats stats;
+  stats.dropped_messages = metrics[Counter::DroppedMessages];
+  stats.dropped_bytes = metrics[Counter::DroppedBytes];
+  stats.disconnects = metrics[Counter::SlowDisconnects];
+  return stats;
+}
+
+std::string connectionManager::metrics_text() const
+{
+  std::string out;
+  Metrics::write_prometheus(out, Metrics::snapshot());
+  Metrics::write_gauge(out, "chat_connected_clients", "Connected clients", static_cast<double>(client_count()));
+  Metrics::write_gauge(out, "chat_nicknames", "Clients with a nickname", static_cast<double>(names_.size()));
+
+  HandlerPool::Stats handlers = handler_stats();
+  Metrics::write_gauge(out, "chat_handler_queue_depth", "Messages waiting in the handler pool",
+                       static_cast<double>(handlers.queued));
+  Metrics::write_gauge(out, "chat_handler_queue_wait_seconds_max", "Longest wait in the handler pool queue",
+                       static_cast<double>(handlers.wait_ns_max) / 1e9);
+  Metrics::write_counter(out, "chat_handler_processed_total", "Messages processed by the handler pool",
+                         handlers.processed);
+  Metrics::write_counter(out, "chat_handler_rejected_total", "Messages rejected by a full handler pool lane",
+                         handlers.rejected);
+
+  BlockPool::Stats pool = BlockPool::stats();
+  Metrics::write_gauge(out, "chat_pool_slab_bytes", "Memory reserved by the block pool",
+                       static_cast<double>(pool.slab_bytes));
+  Metrics::write_counter(out, "chat_pool_system_allocations_total", "Block pool allocations served by the system allocator",
+                         pool.slabs + pool.direct);
+  if (accept_limiter_.enabled())
+    Metrics::write_gauge(out, "chat_accept_rate_sources", "Client addresses tracked by the per-address connection rate limit",
+                         static_cast<double>(accept_limiter_.sources()));
+  if (cluster_)
+    Metrics::write_gauge(out, "chat_cluster_peers_connected", "Cluster nodes this node is connected to",
+                         static_cast<double>(cluster_->connected_peers()));
+  return out;
+}
+
+bool connectionManager::admit(Shard &shard, const std::shared_ptr<Connection> &client, size_t size)
+{
+  size_t pending = client->pending_bytes();
+  if (client->congested() && pending <= config_.low_water_mark_)
+  {
+    client->set_congested(false, {});
+  }
+  if (!client->congested() && pending + size <= config_.high_water_mark_)
+    return true;
+  if (client->closing())
+    return false;
+
+  auto now = std::chrono::steady_clock::now();
+  if (!client->congested() && config_.slow_consumer_policy_ == SlowConsumerPolicy::Disconnect)
+  {
+    // Отключение по сроку, даже если новых сообщений клиенту больше не будет
+    shard.timers.arm_before(client->timer(), now + config_.slow_consumer_timeout_);
+  }
+  client->set_congested(true, now);
+  switch (config_.slow_consumer_policy_)
+  {
+  case SlowConsumerPolicy::DropOldest:
+  {
+    size_t bytes = 0;
+    size_t target = config_.low_water_mark_ > size ? config_.low_water_mark_ - size : 0;
+    size_t dropped = client->drop_oldest(target, bytes);
+    Metrics::add(Counter::DroppedMessages, dropped);
+    Metrics::add(Counter::DroppedBytes, bytes);
+    if (client->pending_bytes() <= config_.low_water_mark_)
+      client->set_congested(false, now);
+    return true;
+  }
+  case SlowConsumerPolicy::Disconnect:
+    if (now - client->congested_since() >= config_.slow_consumer_timeout_)
+    {
+      disconnectSlow(shard, client);
+      return false;
     }
+    [[fallthrough]];
+  case SlowConsumerPolicy::DropNewest:
+    Metrics::add(Counter::DroppedMessages);
+    Metrics::add(Counter::DroppedBytes, size);
+    return false;
   }
+  return false;
 }
 
-void connectionManager::handleClient(std::shared_ptr<Socket> client)
+void connectionManager::deliver(Shard &shard, const std::shared_ptr<Connection> &client, const MessageRef &text, MessageRef &binary)
 {
-  try
+  if (!admit(shard, client, text->size()))
+    return;
+  Metrics::add(Counter::Deliveries);
+
+  if (client->protocol() == Protocol::Binary)
+  {
+    if (!binary)
+      binary = to_binary(*text);
+    shard.io->send(client, binary);
+  }
+  else
+  {
+    shard.io->send(client, text);
+  }
+}
+
+void connectionManager::for_each_client(ClientVisitor visitor)
+{
+  for_each_shard([visitor](Shard &shard)
+                 { shard.clients.for_each([&](const std::shared_ptr<Connection> &client)
+                                          { visitor(*shard.io, client); }); });
+}
+
+size_t connectionManager::client_count() const noexcept
+{
+  size_t count = 0;
+  for (auto &shard : shards_)
   {
-    const std::string exit_cmd = "/quit";
-    client->send("Welcome to chat! Type '" + exit_cmd + "' to disconnect.\n");
+    count += shard->clients.size();
+  }
+  return count;
+}
+
 
-    while (running_)
+void connectionManager::acceptClients(Shard &shard)
+{
+  while (running_)
+  {
+    bool reserved = reserveConnection();
+    if (!reserved && config_.connection_limit_policy_ == ConnectionLimitPolicy::Queue)
     {
-      std::string msg;
-      ssize_t len = client->recv(msg);
+      // Подключения остаются в очереди listen; прием возобновит releaseConnection()
+      shard.accept_paused = true;
+      shard.loop.modify(shard.serverSocket.fd(), 0);
+      return;
+    }
 
-      msg.erase(std::remove(msg.begin(), msg.end(), '\r'), msg.end());
-      while (!msg.empty() && msg.back() == '\n')
-      {
-        msg.pop_back();
-      }
+    sockaddr_storage peer;
+    socklen_t peer_len = sizeof(peer);
+    int fd = shard.serverSocket.try_accept(reinterpret_cast<sockaddr *>(&peer), &peer_len);
+    if (fd < 0)
+    {
+      int error = errno;
+      // Пока место было занято, другой шард мог увидеть полный сервер и
+      // приостановить прием: вернуть место нужно с его возобновлением
+      if (reserved)
+        releaseConnection();
+      if (error == EINTR || error == ECONNABORTED)
+        continue;
+      if (error != EAGAIN && error != EWOULDBLOCK && running_)
+        Log::write(LogLevel::Error, "Accept failed: %s", strerror(error));
+      return;
+    }
 
-      if (len <= 0 || msg.empty())
+    if (accept_limiter_.enabled())
+    {
+      AcceptLimiter::Verdict verdict = accept_limiter_.admit(reinterpret_cast<sockaddr *>(&peer), std::chrono::steady_clock::now());
+      if (verdict != AcceptLimiter::Verdict::Accept)
       {
+        if (reserved)
+          releaseConnection();
+        Metrics::add(verdict == AcceptLimiter::Verdict::SourceLimit ? Counter::SourceRateLimited : Counter::AcceptRateLimited);
+        // RST вместо FIN: ни записи, ни TIME_WAIT на стороне сервера
+        linger reset{1, 0};
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+        ::close(fd);
         continue;
       }
+    }
 
-      std::cout << "Received: " << msg << std::endl;
+    if (!reserved)
+    {
+      // Отказ без Connection и регистрации в цикле: одна попытка записи и закрытие
+      Metrics::add(Counter::Rejects);
+      ::send(fd, kFull.data(), kFull.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+      ::close(fd);
+      continue;
+    }
+
+    try
+    {
+      // Сокет и подключение — блоки пула потока шарда, а не malloc
+      if (config_.keepalive_idle_.count() > 0)
+        set_keepalive(fd, config_.keepalive_idle_, config_.keepalive_interval_, config_.keepalive_probes_);
+      auto client_ptr = std::allocate_shared<Socket>(PoolAllocator<Socket>(), fd);
+      auto client = std::allocate_shared<Connection>(PoolAllocator<Connection>(), client_ptr, config_.max_frame_size_);
+      Metrics::add(Counter::Accepts);
+      client->touch(std::chrono::steady_clock::now());
+      Shard *raw = &shard;
+      Connection *connection = client.get();
+      client->timer().callback = [this, raw, connection]
+      { checkTimeouts(*raw, *connection); };
 
-      if (msg == exit_cmd)
+      shard.clients.add(client);
+      shard.io->attach(client);
+      shard.io->send(client, kWelcome);
+      if (!config_.default_room_.empty())
       {
-        client->send("Goodbye! Disconnecting...\n");
-        break;
+        client->set_history_mark(shard.history.sequence());
+        joinRoom(shard, *client, config_.default_room_);
       }
-      std::string response = msg + "\n";
-      if (!handler_->handle(client, response))
+      scheduleTimeouts(shard, *client);
+    }
+    catch (std::exception &e)
+    {
+      Log::write(LogLevel::Error, "Accept failed: %s", e.what());
+      std::shared_ptr<Connection> client = shard.clients.find(fd);
+      if (client)
+        closeClient(shard, client);
+      else
+        releaseConnection();
+    }
+  }
+}
+
+void connectionManager::disconnectSlow(Shard &shard, const std::shared_ptr<Connection> &client)
+{
+  Metrics::add(Counter::SlowDisconnects);
+  Log::write(LogLevel::Warn, "Slow consumer disconnected (%zu bytes queued)", client->pending_bytes());
+  // Закрытие откладывается: deliver() может вызываться во время обхода реестра
+  client->close_after_flush();
+  shard.loop.post([this, &shard, client]
+                  { closeClient(shard, client); });
+}
+
+void connectionManager::checkTimeouts(Shard &shard, Connection &connection)
+{
+  std::shared_ptr<Connection> client = shard.clients.find(connection.fd());
+  if (client.get() != &connection || client->closing())
+    return;
+
+  auto now = shard.timers.now();
+  auto idle = now - client->last_active();
+  bool binary = client->protocol() == Protocol::Binary;
+  bool ping = binary && config_.ping_interval_.count() > 0;
+
+  if (client->congested() && config_.slow_consumer_policy_ == SlowConsumerPolicy::Disconnect &&
+      now - client->congested_since() >= config_.slow_consumer_timeout_)
+  {
+    disconnectSlow(shard, client);
+    return;
+  }
+
+  const char *reason = nullptr;
+  if (client->handshake_pending() && config_.handshake_timeout_.count() > 0 && idle >= config_.handshake_timeout_)
+    reason = "handshake";
+  else if (config_.idle_timeout_.count() > 0 && idle >= config_.idle_timeout_)
+    reason = "idle";
+  else if (ping && client->ping_sent() && idle >= 2 * config_.ping_interval_)
+    reason = "ping";
+  if (reason)
+  {
+    Metrics::add(Counter::Timeouts);
+    Log::write(LogLevel::Info, "Client timed out (%s)", reason);
+    closeClient(shard, client);
+    return;
+  }
+
+  if (ping && !client->ping_sent() && idle >= config_.ping_interval_)
+  {
+    shard.io->send(client, kPing);
+    client->set_ping_sent();
+  }
+  scheduleTimeouts(shard, *client);
+}
+
+void connectionManager::scheduleTimeouts(Shard &shard, Connection &client)
+{
+  using Clock = std::chrono::steady_clock;
+  auto deadline = Clock::time_point::max();
+  auto since = client.last_active();
+
+  if (client.handshake_pending() && config_.handshake_timeout_.count() > 0)
+    deadline = std::min(deadline, since + config_.handshake_timeout_);
+  if (config_.idle_timeout_.count() > 0)
+    deadline = std::min(deadline, since + config_.idle_timeout_);
+  if (client.protocol() == Protocol::Binary && config_.ping_interval_.count() > 0)
+    deadline = std::min(deadline, since + (client.ping_sent() ? 2 : 1) * config_.ping_interval_);
+  if (client.congested() && config_.slow_consumer_policy_ == SlowConsumerPolicy::Disconnect)
+    deadline = std::min(deadline, client.congested_since() + config_.slow_consumer_timeout_);
+
+  if (deadline == Clock::time_point::max())
+    client.timer().cancel();
+  else
+    shard.timers.arm(client.timer(), deadline);
+}
+
+bool connectionManager::reserveConnection() noexcept
+{
+  size_t limit = config_.max_connections_;
+  size_t current = connections_.load(std::memory_order_relaxed);
+  do
+  {
+    if (limit != 0 && current >= limit)
+      return false;
+  } while (!connections_.compare_exchange_weak(current, current + 1, std::memory_order_relaxed));
+  return true;
+}
+
+void connectionManager::releaseConnection()
+{
+  size_t previous = connections_.fetch_sub(1, std::memory_order_relaxed);
+  if (previous != config_.max_connections_ || config_.connection_limit_policy_ != ConnectionLimitPolicy::Queue)
+    return;
+
+  // Через очередь задач даже для своего шарда: closeClient может выполняться во время обхода реестра
+  for (auto &shard : shards_)
+  {
+    Shard *raw = shard.get();
+    raw->loop.post([this, raw]
+                   { resumeAccept(*raw); });
+  }
+}
+
+void connectionManager::resumeAccept(Shard &shard)
+{
+  if (!shard.accept_paused || !running_)
+    return;
+  shard.accept_paused = false;
+  // MOD перевзводит edge-triggered ожидание: очередь listen уже не пуста
+  shard.loop.modify(shard.serverSocket.fd(), EPOLLIN | EPOLLET);
+  acceptClients(shard);
+}
+
+void connectionManager::handleClient(Shard &shard, const std::shared_ptr<Connection> &client)
+{
+  try
+  {
+    // Одна отметка времени на пачку прочитанных данных: и для простоя, и для метрик
+    auto now = std::chrono::steady_clock::now();
+    client->touch(now);
+    uint64_t received_at = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count());
+    Framer::Frame frame;
+    bool greeted = client->protocol() != Protocol::Unknown;
+    // Сроки зависят от протокола и рукопожатия: пока они меняются, таймер перевзводится
+    bool reschedule = client->handshake_pending();
+    while (!client->reading_stopped())
+    {
+      bool complete = client->framer().next(frame);
+      if (!greeted && client->protocol() != Protocol::Unknown)
       {
-        std::cout << "No handler for message\n";
+        // Протокол известен с первого байта: история комнаты по умолчанию
+        // уходит раньше ответов на сообщения клиента
+        greeted = true;
+        reschedule = true;
+        if (client->room())
+          sendHistory(shard, client, client->room()->view());
       }
+      if (!complete)
+        break;
+      client->mark_framed();
+      processMessage(shard, client, frame, received_at);
     }
+    if (reschedule && client->socket()->is_valid() && !client->closing())
+      scheduleTimeouts(shard, *client);
   }
   catch (std::exception &e)
   {
-    std::cerr << "Client error: " << e.what() << '\n';
+    Log::write(LogLevel::Warn, "Client error: %s", e.what());
+    closeClient(shard, client);
   }
   catch (...)
   {
-    std::cerr << "Client handler error!";
+    Log::write(LogLevel::Error, "Client handler error");
+    closeClient(shard, client);
+  }
+}
+
+void connectionManager::processMessage(Shard &shard, const std::shared_ptr<Connection> &client, const Framer::Frame &frame, uint64_t received_at)
+{
+  if (frame.type == FrameType::Ping)
+  {
+    shard.io->send(client, make_frame(FrameType::Pong, frame.parts[0], frame.parts[1]));
+    return;
+  }
+  if (frame.empty() || frame.type == FrameType::Pong)
+  {
+    return;
+  }
+  Metrics::add(Counter::MessagesFramed);
+
+  static LogSampler received(kReceivedLogEvery);
+  Log::sampled(received, LogLevel::Debug, "Received: %.*s%.*s", static_cast<int>(frame.parts[0].size()), frame.parts[0].data(),
+               static_cast<int>(frame.parts[1].size()), frame.parts[1].data());
+
+  bool quit = frame.equals(kExitCommand);
+  if (!handlers_)
+  {
+    if (quit)
+    {
+      quitClient(shard, client);
+      return;
+    }
+    // Единственная аллокация сообщения: дальше буфер только разделяется.
+    // Обработчики видят текстовую форму независимо от протокола отправителя
+    MessageRef response = MessageBuffer::create({frame.parts[0], frame.parts[1], "\n"}, received_at);
+    uint64_t started = Metrics::now_ns();
+    if (!handler_->handle(client->socket(), response))
+    {
+      Log::sampled(unhandled, LogLevel::Warn, "No handler for message");
+    }
+    Metrics::record(Latency::Handler, Metrics::now_ns() - started);
+    return;
+  }
+
+  // Отключение тоже идет через дорожку клиента: прощание уходит после
+  // ответов на все предыдущие сообщения
+  HandlerPool::Job job;
+  job.client = client;
+  job.context = &shard;
+  if (quit)
+    client->stop_reading();
+  else
+    job.msg = MessageBuffer::create({frame.parts[0], frame.parts[1], "\n"}, received_at);
+
+  if (!handlers_->submit(std::move(job)))
+  {
+    if (quit)
+    {
+      quitClient(shard, client);
+      return;
+    }
+    MessageRef binary;
+    deliver(shard, client, kBusy, binary);
+  }
+}
+
+void connectionManager::runHandler(HandlerPool::Job &job)
+{
+  handlerScope_ = {static_cast<Shard *>(job.context), job.client.get()};
+  try
+  {
+    if (!job.msg)
+    {
+      runOnClient(job.client->socket(), [this](Shard &shard, const std::shared_ptr<Connection> &client)
+                  { quitClient(shard, client); });
+    }
+    else
+    {
+      uint64_t started = Metrics::now_ns();
+      if (!handler_->handle(job.client->socket(), job.msg))
+      {
+        Log::sampled(unhandled, LogLevel::Warn, "No handler for message");
+      }
+      Metrics::record(Latency::Handler, Metrics::now_ns() - started);
+    }
+  }
+  catch (std::exception &e)
+  {
+    Log::write(LogLevel::Error, "Handler error: %s", e.what());
   }
+  handlerScope_ = {};
+}
 
-  cleanupDisconnectedClients(client);
+void connectionManager::quitClient(Shard &shard, const std::shared_ptr<Connection> &client)
+{
+  MessageRef binary = kGoodbyeBinary;
+  deliver(shard, client, kGoodbye, binary);
+  client->close_after_flush();
 }
 
-void connectionManager::cleanupDisconnectedClients(std::shared_ptr<Socket> client)
+void connectionManager::deliverLocal(Shard &shard, const std::shared_ptr<Socket> &sender, const MessageRef &room, const IIoBackend::Payload &msg)
 {
-  client->shutdown();
-  std::lock_guard<std::mutex> lock(clientsMutex_);
-  active_clients_.erase(
-      std::remove(active_clients_.begin(), active_clients_.end(), client),
-      active_clients_.end());
-}
\ No newline at end of file
+  MessageRef binary; // Создается при первом бинарном получателе
+  if (!room)
+  {
+    shard.clients.for_each([&](const std::shared_ptr<Connection> &client)
+                           {
+      if (client->socket() != sender)
+        deliver(shard, client, msg, binary); });
+  }
+  else
+  {
+    // Обходятся только подписчики комнаты, остальные клиенты шарда не затрагиваются
+    shard.rooms.for_each_member(room->view(), [&](int fd)
+                                {
+      const auto &client = shard.clients.find(fd);
+      if (client && client->socket() != sender)
+        deliver(shard, client, msg, binary); });
+    shard.history.append(room->view(), msg, binary);
+  }
+
+  // Задержка до постановки в очередь последнему получателю во всех шардах:
+  // одно измерение на сообщение, его делает шард, закончивший рассылку последним
+  if (msg->received_at() != 0 && msg->finish_fanout())
+    Metrics::record(Latency::Delivery, Metrics::now_ns() - msg->received_at());
+}
+
+void connectionManager::closeClient(Shard &shard, const std::shared_ptr<Connection> &client)
+{
+  if (!client->socket()->is_valid())
+    return;
+
+  int fd = client->fd();
+  Metrics::add(Counter::Disconnects);
+  client->timer().cancel();
+  if (client->nick_token() != 0)
+    names_.release(client->nick(), client->nick_token());
+  for (const auto &subscription : client->rooms())
+  {
+    leaveRoom(shard, subscription);
+  }
+  shard.io->detach(client);
+  client->socket()->shutdown();
+  shard.clients.remove(fd);
+  releaseConnection();
+}
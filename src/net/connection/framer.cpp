@@ -0,0 +1,136 @@
+/**
+ * @file framer.cpp
+ * @brief Реализация методов Framer
+ */
+
+#include "../include/net/connection/framer.h"
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+  [[noreturn]] void throw_oversized(size_t limit)
+  {
+    throw std::runtime_error("Frame exceeds " + std::to_string(limit) + " bytes");
+  }
+}
+
+Framer::Framer(size_t max_frame_size)
+    : max_frame_size_(max_frame_size),
+      // Сообщение максимальной длины вместе с "\r\n" или заголовком кадра должно помещаться целиком
+      max_capacity_(std::max(kInitialCapacity, max_frame_size + kMaxVarintSize + 1)) {}
+
+ssize_t Framer::read_from(int fd)
+{
+  if (buffer_.space() == 0)
+  {
+    size_t capacity = buffer_.capacity() == 0 ? kInitialCapacity : buffer_.capacity() * 2;
+    if (buffer_.capacity() >= max_capacity_)
+    {
+      errno = EMSGSIZE;
+      return -1;
+    }
+    buffer_.reserve(capacity);
+  }
+
+  iovec iov[2];
+  int count = static_cast<int>(buffer_.write_regions(iov));
+  ssize_t bytes = ::readv(fd, iov, count);
+  if (bytes > 0)
+  {
+    buffer_.commit(static_cast<size_t>(bytes));
+  }
+  return bytes;
+}
+
+void Framer::append(const char *data, size_t len)
+{
+  if (buffer_.capacity() == 0)
+  {
+    buffer_.reserve(std::max(kInitialCapacity, len));
+  }
+  buffer_.append(data, len);
+}
+
+bool Framer::next(Frame &frame)
+{
+  if (protocol_ == Protocol::Unknown)
+  {
+    if (buffer_.empty())
+      return false;
+    if (buffer_.at(0) == kBinaryHandshake)
+    {
+      protocol_ = Protocol::Binary;
+      buffer_.consume(1);
+    }
+    else
+    {
+      protocol_ = Protocol::Text;
+    }
+  }
+  return protocol_ == Protocol::Binary ? next_binary(frame) : next_line(frame);
+}
+
+bool Framer::next_line(Frame &frame)
+{
+  size_t pos = buffer_.find('\n', scanned_);
+  size_t len = pos;
+  if (pos == buffer_.size())
+  {
+    // Строка еще не завершена: повторно просматривать проверенное не нужно
+    scanned_ = pos;
+    if (len > max_frame_size_)
+      throw_oversized(max_frame_size_);
+    return false;
+  }
+
+  if (len > 0 && buffer_.at(len - 1) == '\r')
+    --len;
+  if (len > max_frame_size_)
+    throw_oversized(max_frame_size_);
+
+  frame.type = FrameType::Message;
+  buffer_.peek(len, frame.parts);
+  // Данные остаются на месте до следующей записи, поэтому участки frame действительны
+  buffer_.consume(pos + 1);
+  scanned_ = 0;
+  return true;
+}
+
+bool Framer::next_binary(Frame &frame)
+{
+  // Заголовок: varint длины (тип + тело), затем байт типа
+  uint32_t length = 0;
+  size_t header = 0;
+  for (;;)
+  {
+    if (header == buffer_.size())
+      return false;
+    if (header == kMaxVarintSize)
+      throw std::runtime_error("Malformed frame length");
+
+    unsigned char byte = buffer_.at(header);
+    length |= static_cast<uint32_t>(byte & 0x7F) << (7 * header);
+    ++header;
+    if (!(byte & 0x80))
+      break;
+  }
+
+  if (length == 0)
+    throw std::runtime_error("Empty frame");
+  if (length - 1 > max_frame_size_)
+    throw_oversized(max_frame_size_);
+  if (buffer_.size() < header + length)
+    return false;
+
+  unsigned char type = buffer_.at(header);
+  if (type < static_cast<unsigned char>(FrameType::Message) || type > static_cast<unsigned char>(FrameType::Pong))
+    throw std::runtime_error("Unknown frame type " + std::to_string(type));
+
+  frame.type = static_cast<FrameType>(type);
+  buffer_.peek(length - 1, frame.parts, header + 1);
+  buffer_.consume(header + length);
+  return true;
+}
@@ -0,0 +1,39 @@
+/**
+ * @file message_buffer.cpp
+ * @brief Реализация методов MessageBuffer
+ */
+
+#include "../include/net/connection/message_buffer.h"
+#include "../include/memory/block_pool.h"
+#include <cstring>
+#include <new>
+
+MessageRef MessageBuffer::create(std::initializer_list<std::string_view> parts, uint64_t received_at)
+{
+  size_t size = 0;
+  for (std::string_view part : parts)
+  {
+    size += part.size();
+  }
+
+  // Заголовок и данные — один блок памяти из пула потока
+  void *block = BlockPool::allocate(sizeof(MessageBuffer) + size);
+  auto *buffer = new (block) MessageBuffer(size, received_at);
+  char *out = reinterpret_cast<char *>(buffer + 1);
+  for (std::string_view part : parts)
+  {
+    std::memcpy(out, part.data(), part.size());
+    out += part.size();
+  }
+  return MessageRef(buffer);
+}
+
+void MessageBuffer::release() const noexcept
+{
+  if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+  {
+    size_t size = size_;
+    this->~MessageBuffer();
+    BlockPool::deallocate(const_cast<MessageBuffer *>(this), sizeof(MessageBuffer) + size);
+  }
+}
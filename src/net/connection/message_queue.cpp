@@ -0,0 +1,59 @@
+/**
+ * @file message_queue.cpp
+ * @brief Реализация методов MessageQueue
+ */
+
+#include "../include/net/connection/message_queue.h"
+#include "../include/memory/block_pool.h"
+
+MessageQueue::~MessageQueue()
+{
+  while (size_ > 0)
+  {
+    pop_front();
+  }
+  BlockPool::deallocate(slots_, capacity_ * sizeof(MessageRef));
+}
+
+void MessageQueue::drained() noexcept
+{
+  head_ = 0;
+  if (capacity_ > kKeepCapacity)
+  {
+    BlockPool::deallocate(slots_, capacity_ * sizeof(MessageRef));
+    slots_ = nullptr;
+    capacity_ = 0;
+  }
+}
+
+void MessageQueue::erase(size_t index, size_t count) noexcept
+{
+  if (count == 0)
+    return;
+  size_t mask = capacity_ - 1;
+  // Хвост сдвигается к началу удаленного участка
+  for (size_t i = index; i + count < size_; ++i)
+  {
+    slots_[(head_ + i) & mask] = std::move(slots_[(head_ + i + count) & mask]);
+  }
+  for (size_t i = size_ - count; i < size_; ++i)
+  {
+    slots_[(head_ + i) & mask].~MessageRef();
+  }
+  size_ -= count;
+}
+
+void MessageQueue::reallocate(size_t capacity)
+{
+  auto *slots = static_cast<MessageRef *>(BlockPool::allocate(capacity * sizeof(MessageRef)));
+  for (size_t i = 0; i < size_; ++i)
+  {
+    MessageRef &from = slots_[(head_ + i) & (capacity_ - 1)];
+    new (&slots[i]) MessageRef(std::move(from));
+    from.~MessageRef();
+  }
+  BlockPool::deallocate(slots_, capacity_ * sizeof(MessageRef));
+  slots_ = slots;
+  capacity_ = capacity;
+  head_ = 0;
+}
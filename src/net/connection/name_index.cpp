@@ -0,0 +1,243 @@
+/**
+ * @file name_index.cpp
+ * @brief Реализация методов NameIndex
+ */
+
+#include "../include/net/connection/name_index.h"
+#include <cstring>
+
+namespace
+{
+  constexpr size_t kInitialCapacity = 1024; ///< Начальный размер таблицы
+
+  /// @brief Хеш имени (FNV-1a с перемешиванием, чтобы младшие биты зависели от всех байт)
+  uint64_t hash_name(std::string_view name) noexcept
+  {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char ch : name)
+    {
+      hash ^= ch;
+      hash *= 1099511628211ull;
+    }
+    return hash ^ (hash >> 29);
+  }
+
+  uint64_t pack_address(uint32_t shard, int fd) noexcept
+  {
+    return (static_cast<uint64_t>(shard) << 32) | static_cast<uint32_t>(fd);
+  }
+
+  /// Писатель: счетчик версий нечетный, пока изменяется таблица
+  class WriteSection
+  {
+  public:
+    explicit WriteSection(std::atomic<uint64_t> &version) : version_(version)
+    {
+      version_.store(version_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    ~WriteSection() { version_.store(version_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+  private:
+    std::atomic<uint64_t> &version_;
+  };
+}
+
+NameIndex::NameIndex()
+{
+  tables_.push_back(std::make_unique<Table>(kInitialCapacity));
+  table_.store(tables_.back().get(), std::memory_order_release);
+}
+
+bool NameIndex::make_key(std::string_view name, Key &key) noexcept
+{
+  if (name.empty() || name.size() > kMaxName)
+    return false;
+  key.length = name.size();
+  std::memcpy(key.words, name.data(), name.size());
+  key.hash = hash_name(name);
+  return true;
+}
+
+NameIndex::Key NameIndex::key_of(const Slot &slot) noexcept
+{
+  Key key;
+  key.length = slot.length.load(std::memory_order_relaxed);
+  for (size_t w = 0; w < kWords; ++w)
+  {
+    key.words[w] = slot.words[w].load(std::memory_order_relaxed);
+  }
+  key.hash = hash_name(std::string_view(reinterpret_cast<const char *>(key.words), key.length));
+  return key;
+}
+
+long NameIndex::locate(const Table &table, const Key &key) noexcept
+{
+  size_t index = key.hash & table.mask;
+  // Не больше размера таблицы: при гонке с писателем цикл все равно конечен
+  for (size_t probes = 0; probes <= table.mask; ++probes, index = (index + 1) & table.mask)
+  {
+    const Slot &slot = table.slots[index];
+    if (slot.token.load(std::memory_order_relaxed) == 0)
+      return -1;
+    if (slot.length.load(std::memory_order_relaxed) != key.length)
+      continue;
+    bool equal = true;
+    for (size_t w = 0; w < kWords && equal; ++w)
+    {
+      equal = slot.words[w].load(std::memory_order_relaxed) == key.words[w];
+    }
+    if (equal)
+      return static_cast<long>(index);
+  }
+  return -1;
+}
+
+bool NameIndex::find(std::string_view name, Target &target) const noexcept
+{
+  Key key;
+  if (!make_key(name, key))
+    return false;
+
+  for (;;)
+  {
+    uint64_t version = version_.load(std::memory_order_acquire);
+    if (version & 1)
+      continue;
+
+    const Table &table = *table_.load(std::memory_order_acquire);
+    long index = locate(table, key);
+    uint64_t token = 0;
+    uint64_t address = 0;
+    if (index >= 0)
+    {
+      token = table.slots[index].token.load(std::memory_order_relaxed);
+      address = table.slots[index].address.load(std::memory_order_relaxed);
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (version_.load(std::memory_order_relaxed) != version)
+      continue;
+    if (index < 0)
+      return false;
+    target.shard = static_cast<uint32_t>(address >> 32);
+    target.fd = static_cast<int>(static_cast<uint32_t>(address));
+    target.token = token;
+    return true;
+  }
+}
+
+bool NameIndex::claim(std::string_view name, const Target &target, std::string_view previous)
+{
+  Key key;
+  if (!make_key(name, key))
+    return false;
+  Key old;
+  bool has_old = make_key(previous, old);
+
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  Table *table = table_.load(std::memory_order_relaxed);
+  long existing = locate(*table, key);
+  if (existing >= 0)
+    return table->slots[existing].token.load(std::memory_order_relaxed) == target.token;
+
+  WriteSection section(version_);
+  if (has_old)
+  {
+    long index = locate(*table, old);
+    if (index >= 0 && table->slots[index].token.load(std::memory_order_relaxed) == target.token)
+    {
+      erase(*table, static_cast<size_t>(index));
+      count_.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+  if (2 * (count_.load(std::memory_order_relaxed) + 1) > table->mask + 1)
+  {
+    grow();
+    table = table_.load(std::memory_order_relaxed);
+  }
+  put(*table, key, target.token, pack_address(target.shard, target.fd));
+  count_.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void NameIndex::release(std::string_view name, uint64_t token)
+{
+  Key key;
+  if (!make_key(name, key))
+    return;
+
+  std::lock_guard<std::mutex> lock(write_mutex_);
+  Table &table = *table_.load(std::memory_order_relaxed);
+  long index = locate(table, key);
+  if (index < 0 || table.slots[index].token.load(std::memory_order_relaxed) != token)
+    return;
+  WriteSection section(version_);
+  erase(table, static_cast<size_t>(index));
+  count_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void NameIndex::put(Table &table, const Key &key, uint64_t token, uint64_t address) noexcept
+{
+  size_t index = key.hash & table.mask;
+  while (table.slots[index].token.load(std::memory_order_relaxed) != 0)
+  {
+    index = (index + 1) & table.mask;
+  }
+  Slot &slot = table.slots[index];
+  slot.address.store(address, std::memory_order_relaxed);
+  slot.length.store(key.length, std::memory_order_relaxed);
+  for (size_t w = 0; w < kWords; ++w)
+  {
+    slot.words[w].store(key.words[w], std::memory_order_relaxed);
+  }
+  slot.token.store(token, std::memory_order_relaxed);
+}
+
+void NameIndex::erase(Table &table, size_t index) noexcept
+{
+  // Сдвиг назад: каждая следующая ячейка цепочки, чей домашний индекс не
+  // лежит между освобожденной ячейкой и ею самой, переезжает на место дыры
+  size_t hole = index;
+  for (size_t next = (hole + 1) & table.mask;; next = (next + 1) & table.mask)
+  {
+    Slot &slot = table.slots[next];
+    uint64_t token = slot.token.load(std::memory_order_relaxed);
+    if (token == 0)
+      break;
+
+    Key key = key_of(slot);
+    size_t home = key.hash & table.mask;
+    if (((next - home) & table.mask) < ((next - hole) & table.mask))
+      continue;
+
+    Slot &target = table.slots[hole];
+    target.address.store(slot.address.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    target.length.store(key.length, std::memory_order_relaxed);
+    for (size_t w = 0; w < kWords; ++w)
+    {
+      target.words[w].store(key.words[w], std::memory_order_relaxed);
+    }
+    target.token.store(token, std::memory_order_relaxed);
+    hole = next;
+  }
+  table.slots[hole].token.store(0, std::memory_order_relaxed);
+}
+
+void NameIndex::grow()
+{
+  const Table &current = *table_.load(std::memory_order_relaxed);
+  auto bigger = std::make_unique<Table>(2 * (current.mask + 1));
+  for (size_t i = 0; i <= current.mask; ++i)
+  {
+    const Slot &slot = current.slots[i];
+    uint64_t token = slot.token.load(std::memory_order_relaxed);
+    if (token == 0)
+      continue;
+    Key key = key_of(slot);
+    put(*bigger, key, token, slot.address.load(std::memory_order_relaxed));
+  }
+  table_.store(bigger.get(), std::memory_order_release);
+  tables_.push_back(std::move(bigger));
+}
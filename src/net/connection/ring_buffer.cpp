@@ -0,0 +1,147 @@
+/**
+ * @file ring_buffer.cpp
+ * @brief Реализация методов RingBuffer
+ */
+
+#include "../include/net/connection/ring_buffer.h"
+#include "../include/memory/block_pool.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+  size_t round_up_pow2(size_t value)
+  {
+    size_t result = 1;
+    while (result < value)
+    {
+      result <<= 1;
+    }
+    return result;
+  }
+}
+
+RingBuffer::RingBuffer(size_t capacity)
+{
+  reserve(capacity);
+}
+
+RingBuffer::~RingBuffer()
+{
+  BlockPool::deallocate(data_, capacity_);
+}
+
+void RingBuffer::reserve(size_t capacity)
+{
+  if (capacity == 0 || capacity <= capacity_)
+    return;
+
+  capacity = round_up_pow2(capacity);
+  auto *data = static_cast<char *>(BlockPool::allocate(capacity));
+  // Переносим непрочитанные данные в начало нового хранилища
+  std::string_view parts[2];
+  size_t len = size();
+  peek(len, parts);
+  if (len > 0)
+  {
+    std::memcpy(data, parts[0].data(), parts[0].size());
+    std::memcpy(data + parts[0].size(), parts[1].data(), parts[1].size());
+  }
+
+  BlockPool::deallocate(data_, capacity_);
+  data_ = data;
+  capacity_ = capacity;
+  head_ = 0;
+  tail_ = len;
+}
+
+void RingBuffer::release() noexcept
+{
+  if (!empty())
+    return;
+  BlockPool::deallocate(data_, capacity_);
+  data_ = nullptr;
+  capacity_ = 0;
+  head_ = tail_ = 0;
+}
+
+size_t RingBuffer::write_regions(iovec iov[2]) noexcept
+{
+  size_t free = space();
+  if (free == 0)
+    return 0;
+
+  size_t start = index(tail_);
+  size_t first = std::min(free, capacity_ - start);
+  iov[0].iov_base = data_ + start;
+  iov[0].iov_len = first;
+  if (first == free)
+    return 1;
+
+  iov[1].iov_base = data_;
+  iov[1].iov_len = free - first;
+  return 2;
+}
+
+void RingBuffer::append(const char *data, size_t len)
+{
+  if (len == 0)
+    return;
+  if (len > space())
+  {
+    reserve(size() + len);
+  }
+
+  iovec iov[2] = {};
+  size_t count = write_regions(iov);
+  size_t first = std::min(len, iov[0].iov_len);
+  std::memcpy(iov[0].iov_base, data, first);
+  if (count > 1 && first < len)
+  {
+    std::memcpy(iov[1].iov_base, data + first, len - first);
+  }
+  commit(len);
+}
+
+size_t RingBuffer::find(char ch, size_t from) const noexcept
+{
+  size_t len = size();
+  if (from >= len)
+    return len;
+
+  std::string_view parts[2];
+  peek(len, parts);
+  if (from < parts[0].size())
+  {
+    size_t pos = parts[0].find(ch, from);
+    if (pos != std::string_view::npos)
+      return pos;
+    from = parts[0].size();
+  }
+  size_t pos = parts[1].find(ch, from - parts[0].size());
+  return pos == std::string_view::npos ? len : parts[0].size() + pos;
+}
+
+void RingBuffer::peek(size_t len, std::string_view parts[2], size_t offset) const noexcept
+{
+  if (len == 0)
+  {
+    parts[0] = parts[1] = std::string_view();
+    return;
+  }
+
+  size_t start = index(head_ + offset);
+  size_t first = std::min(len, capacity_ - start);
+  parts[0] = std::string_view(data_ + start, first);
+  parts[1] = std::string_view(data_, len - first);
+}
+
+void RingBuffer::consume(size_t bytes) noexcept
+{
+  head_ += bytes;
+  if (head_ == tail_)
+  {
+    // Пустой буфер: следующая запись снова начнется с непрерывного участка
+    head_ = tail_ = 0;
+  }
+}
@@ -0,0 +1,62 @@
+/**
+ * @file room_history.cpp
+ * @brief Реализация методов RoomHistory
+ */
+
+#include "../include/net/connection/room_history.h"
+#include <algorithm>
+
+RoomHistory::RoomHistory(size_t max_messages, size_t max_bytes, size_t max_rooms)
+    : max_messages_(max_messages), max_bytes_(max_bytes), max_rooms_(std::max<size_t>(max_rooms, 1)) {}
+
+void RoomHistory::append(std::string_view room, const MessageRef &text, const MessageRef &binary)
+{
+  if (max_messages_ == 0 || text->size() > max_bytes_)
+    return;
+
+  auto it = index_.find(room);
+  if (it == index_.end())
+  {
+    if (index_.size() >= max_rooms_)
+    {
+      index_.erase(order_.back()->name);
+      order_.pop_back();
+    }
+    auto created = std::make_unique<Room>();
+    created->name.assign(room);
+    created->ring.resize(max_messages_);
+    order_.push_front(std::move(created));
+    it = index_.emplace(order_.front()->name, order_.begin()).first;
+  }
+  else if (it->second != order_.begin())
+  {
+    order_.splice(order_.begin(), order_, it->second);
+  }
+
+  Room &history = **it->second;
+  while (history.count == history.ring.size() || (history.count > 0 && history.bytes + text->size() > max_bytes_))
+  {
+    pop_oldest(history);
+  }
+  Entry &entry = history.ring[(history.head + history.count) % history.ring.size()];
+  entry.text = text;
+  entry.binary = binary;
+  entry.seq = next_seq_++;
+  history.bytes += text->size();
+  ++history.count;
+}
+
+size_t RoomHistory::size(std::string_view room) const noexcept
+{
+  auto it = index_.find(room);
+  return it == index_.end() ? 0 : (*it->second)->count;
+}
+
+void RoomHistory::pop_oldest(Room &room) noexcept
+{
+  Entry &oldest = room.ring[room.head];
+  room.bytes -= oldest.text->size();
+  oldest = Entry();
+  room.head = (room.head + 1) % room.ring.size();
+  --room.count;
+}
@@ -0,0 +1,54 @@
+/**
+ * @file room_index.cpp
+ * @brief Реализация методов RoomIndex
+ */
+
+#include "../include/net/connection/room_index.h"
+
+MessageRef RoomIndex::join(std::string_view room, int fd, uint32_t &slot)
+{
+  auto it = rooms_.find(room);
+  if (it == rooms_.end())
+  {
+    auto created = std::make_unique<Room>();
+    created->name = MessageBuffer::create({room});
+    created->members.push_back(fd);
+    std::string_view key = created->name->view();
+    it = rooms_.emplace(key, std::move(created)).first;
+    slot = 0;
+    return it->second->name;
+  }
+
+  Room &entry = *it->second;
+  slot = static_cast<uint32_t>(entry.members.size());
+  entry.members.push_back(fd);
+  return entry.name;
+}
+
+int RoomIndex::leave(std::string_view room, uint32_t slot) noexcept
+{
+  auto it = rooms_.find(room);
+  if (it == rooms_.end())
+    return -1;
+
+  // Порядок подписчиков не важен: переставляем последнего на место ушедшего
+  Room &entry = *it->second;
+  int last = entry.members.back();
+  entry.members.pop_back();
+  if (static_cast<size_t>(slot) < entry.members.size())
+  {
+    entry.members[slot] = last;
+    return last;
+  }
+  if (entry.members.empty())
+  {
+    rooms_.erase(it);
+  }
+  return -1;
+}
+
+size_t RoomIndex::member_count(std::string_view room) const noexcept
+{
+  auto it = rooms_.find(room);
+  return it == rooms_.end() ? 0 : it->second->members.size();
+}
@@ -1,5 +1,7 @@
 #include "../include/net/socket.h"
+#include <algorithm>
 #include <utility>
+#include <fcntl.h>
 
 /**
  * @throws runtime_error В случае ошибок конфигурации или неудачи при создании сокета
@@ -10,7 +12,7 @@ Socket::Socket(int domain, int type, int protocol) : config_(domain, type, proto
   {
     throw std::runtime_error("Invalid socket configuration");
   }
-  fd_ = socket(domain, type, protocol);
+  fd_ = socket(domain, type | SOCK_CLOEXEC, protocol);
   int yes = 1;
   if (setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes))) // Помогает перезапустить сервер после падения(без тайм аутов)
   {
@@ -34,9 +36,9 @@ Socket::~Socket()
 }
 
 Socket::Socket(Socket &&other) noexcept
-    : fd_(std::exchange(other.fd_, -1)), servaddr(other.servaddr), servaddr6(other.servaddr6), config_(std::move(other.config_))
+    : fd_(std::exchange(other.fd_, -1)), servaddr6(other.servaddr6), config_(std::move(other.config_))
 {
-  memset(&other.servaddr, 0, sizeof(other.servaddr));   // Обнуляем старое содержимое
+  // servaddr6 — наибольший член объединения: копия и обнуление захватывают и servaddr
   memset(&other.servaddr6, 0, sizeof(other.servaddr6)); // Обнуляем старое содержимое
 }
 Socket &Socket::operator=(Socket &&other) noexcept
@@ -49,11 +51,9 @@ Socket &Socket::operator=(Socket &&other) noexcept
     }
 
     fd_ = std::exchange(other.fd_, -1); // Меняем дескрипторы
-    servaddr = other.servaddr;          // Копируем адрес IPv4
-    servaddr6 = other.servaddr6;        // Копируем адрес IPv6
+    servaddr6 = other.servaddr6;        // Копируем адрес (весь union)
     config_ = std::move(other.config_); // Перемещаем конфигурацию
 
-    memset(&other.servaddr, 0, sizeof(other.servaddr));   // Обнуляем старое содержимое
     memset(&other.servaddr6, 0, sizeof(other.servaddr6)); // Обнуляем старое содержимое
   }
   return *this;
@@ -134,6 +134,50 @@ Socket Socket::accept_socket(struct sockaddr *addr, socklen_t *addrlen)
   return Socket(connfd);
 }
 
+int Socket::try_accept(struct sockaddr *addr, socklen_t *addrlen) noexcept
+{
+  if (fd_ == -1)
+  {
+    errno = EBADF;
+    return -1;
+  }
+  return accept4(fd_, addr, addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+}
+
+/**
+ * @throws runtime_error Если сокет не действителен или fcntl завершился ошибкой
+ */
+void Socket::set_nonblocking()
+{
+  if (!is_valid())
+  {
+    throw std::runtime_error("Socket is not valid");
+  }
+
+  int flags = fcntl(fd_, F_GETFL, 0);
+  if (flags < 0 || fcntl(fd_, F_SETFL, flags | O_NONBLOCK) < 0)
+  {
+    throw std::runtime_error(std::string("fcntl(O_NONBLOCK) failed: ") + strerror(errno));
+  }
+}
+
+/**
+ * @throws runtime_error Если сокет не действителен или setsockopt завершился ошибкой
+ */
+void Socket::set_reuseport()
+{
+  if (!is_valid())
+  {
+    throw std::runtime_error("Socket is not valid");
+  }
+
+  int yes = 1;
+  if (setsockopt(fd_, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) < 0)
+  {
+    throw std::runtime_error(std::string("setsockopt(SO_REUSEPORT) failed: ") + strerror(errno));
+  }
+}
+
 /**
  * @throws runtime_error Если сокет не действителен или попытка подключения завершилась ошибкой
  */
@@ -218,14 +262,11 @@ ssize_t Socket::recv(std::string &buffer)
     return -1;
   }
 
-  char buf[1024];                                   // Временный буфер для приёма данных
-  ssize_t bytes = ::recv(fd_, buf, sizeof(buf), 0); // Получаем данные
-
-  if (bytes > 0)
-  {
-    buffer.clear();            // Очистка буфера перед записью новых данных
-    buffer.assign(buf, bytes); // Добавляем полученные данные в буфер
-  }
+  // Принимаем прямо в буфер вызывающего, без промежуточной копии
+  const size_t chunk = std::max<size_t>(buffer.capacity(), 4096);
+  buffer.resize(chunk);
+  ssize_t bytes = ::recv(fd_, &buffer[0], chunk, 0); // Получаем данные
+  buffer.resize(bytes > 0 ? static_cast<size_t>(bytes) : 0);
   // bytes == 0 — соединение закрыто, errno не трогаем
   // bytes < 0 — ошибка, errno уже установлен системой
   return bytes;
@@ -0,0 +1,124 @@
+/**
+ * @file epoll_backend.cpp
+ * @brief Реализация методов EpollBackend
+ */
+
+#include "../include/net/reactor/epoll_backend.h"
+#include "../include/metrics/metrics.h"
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+namespace
+{
+  /// Прочитать и выбросить входящие данные: буфер приема клиента не растет
+  ssize_t discard_input(int fd)
+  {
+    char sink[4096];
+    return ::recv(fd, sink, sizeof(sink), 0);
+  }
+}
+
+EpollBackend::EpollBackend(EventLoop &loop, DataHandler on_data, CloseHandler on_close, WriteCoalescing coalescing)
+    : loop_(loop), on_data_(std::move(on_data)), on_close_(std::move(on_close)), dirty_(loop, coalescing)
+{
+  loop_.set_before_poll([this]
+                        { flushPending(); });
+}
+
+EpollBackend::~EpollBackend()
+{
+  loop_.set_before_poll(nullptr);
+}
+
+void EpollBackend::attach(const std::shared_ptr<Connection> &client)
+{
+  // Сбой обработки закрывает только это подключение
+  loop_.add(
+      client->fd(), EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, [this, client](uint32_t events)
+      { handleEvents(client, events); },
+      [this, client]
+      { on_close_(client); });
+}
+
+void EpollBackend::detach(const std::shared_ptr<Connection> &client)
+{
+  loop_.remove(client->fd());
+}
+
+void EpollBackend::send(const std::shared_ptr<Connection> &client, Payload data)
+{
+  if (!client->socket()->is_valid())
+    return;
+
+  client->enqueue(std::move(data));
+  dirty_.add(client);
+}
+
+void EpollBackend::flushPending()
+{
+  dirty_.drain([this](const std::shared_ptr<Connection> &client)
+               {
+    if (!client->socket()->is_valid())
+      return;
+
+    if (!client->flush() || (client->closing() && !client->has_pending_output()))
+    {
+      on_close_(client);
+    } });
+}
+
+void EpollBackend::handleEvents(const std::shared_ptr<Connection> &client, uint32_t events)
+{
+  if (!client->socket()->is_valid())
+    return;
+
+  if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+  {
+    // Edge-triggered: читаем до EAGAIN, иначе новых уведомлений не будет.
+    // После /quit данные больше не разбираются, но сокет дочитывается впустую:
+    // иначе буфер приема переполнится и подключение закроется раньше, чем
+    // уйдут прощание и ответы на предыдущие сообщения; закрытие клиентом
+    // по-прежнему замечается
+    for (;;)
+    {
+      bool discard = client->reading_stopped();
+      ssize_t len = discard ? discard_input(client->fd()) : client->framer().read_from(client->fd());
+      if (len > 0)
+      {
+        Metrics::add(Counter::BytesIn, static_cast<uint64_t>(len));
+        if (discard)
+          continue;
+        on_data_(client);
+        if (!client->socket()->is_valid())
+          return;
+        continue;
+      }
+      if (len < 0 && errno == EINTR)
+        continue;
+      if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        break;
+      // Клиент закрыл свою сторону после /quit: подключение закроется после прощания
+      if (len == 0 && discard)
+        break;
+
+      // len == 0 — клиент закрыл соединение, иначе ошибка чтения
+      on_close_(client);
+      return;
+    }
+    // Данные сокета кончились: простаивающее подключение не держит буфер приема
+    client->framer().release();
+  }
+
+  // Подключение из списка на запись пишется в свой срок; здесь дописывается
+  // только остаток, ожидавший EPOLLOUT
+  if (!client->flush_scheduled() && !client->flush())
+  {
+    on_close_(client);
+    return;
+  }
+  if (client->closing() && !client->has_pending_output())
+  {
+    on_close_(client);
+  }
+}
@@ -0,0 +1,215 @@
+/**
+ * @file event_loop.cpp
+ * @brief Реализация методов EventLoop
+ */
+
+#include "../include/net/reactor/event_loop.h"
+#include "../include/log/logger.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace
+{
+  constexpr int kMaxEvents = 256; ///< Максимум событий за один вызов epoll_wait
+}
+
+EventLoop::EventLoop() : running_(true)
+{
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd_ < 0)
+  {
+    throw std::runtime_error(std::string("epoll_create1 failed: ") + strerror(errno));
+  }
+
+  wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wake_fd_ < 0)
+  {
+    close(epoll_fd_);
+    throw std::runtime_error(std::string("eventfd failed: ") + strerror(errno));
+  }
+
+  epoll_event ev{};
+  ev.events = EPOLLIN;
+  ev.data.ptr = nullptr; // nullptr зарезервирован за eventfd
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev) < 0)
+  {
+    close(wake_fd_);
+    close(epoll_fd_);
+    throw std::runtime_error(std::string("epoll_ctl(eventfd) failed: ") + strerror(errno));
+  }
+}
+
+EventLoop::~EventLoop()
+{
+  close(wake_fd_);
+  close(epoll_fd_);
+}
+
+void EventLoop::add(int fd, uint32_t events, Callback callback, FailureHandler on_failure)
+{
+  auto watch = std::make_unique<Watch>(Watch{fd, std::move(callback), std::move(on_failure)});
+
+  epoll_event ev{};
+  ev.events = events;
+  ev.data.ptr = watch.get();
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0)
+  {
+    throw std::runtime_error(std::string("epoll_ctl(ADD) failed: ") + strerror(errno));
+  }
+  watches_[fd] = std::move(watch);
+}
+
+void EventLoop::modify(int fd, uint32_t events)
+{
+  auto it = watches_.find(fd);
+  if (it == watches_.end())
+  {
+    throw std::runtime_error("epoll_ctl(MOD): descriptor is not registered");
+  }
+
+  epoll_event ev{};
+  ev.events = events;
+  ev.data.ptr = it->second.get();
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev) < 0)
+  {
+    throw std::runtime_error(std::string("epoll_ctl(MOD) failed: ") + strerror(errno));
+  }
+}
+
+void EventLoop::remove(int fd)
+{
+  auto it = watches_.find(fd);
+  if (it == watches_.end())
+    return;
+
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+
+  // Память регистрации освобождается после текущей пачки событий:
+  // в ней еще могут лежать указатели на этот Watch
+  it->second->fd = -1;
+  retired_.push_back(std::move(it->second));
+  watches_.erase(it);
+}
+
+void EventLoop::post(Task task)
+{
+  {
+    std::lock_guard<std::mutex> lock(tasksMutex_);
+    tasks_.push_back(std::move(task));
+  }
+  wakeup();
+}
+
+void EventLoop::run()
+{
+  owner_ = std::this_thread::get_id();
+  epoll_event events[kMaxEvents];
+
+  while (running_)
+  {
+    if (before_poll_)
+    {
+      try
+      {
+        before_poll_();
+      }
+      catch (std::exception &e)
+      {
+        Log::write(LogLevel::Error, "Event loop hook failed: %s", e.what());
+      }
+    }
+
+    int n = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+    if (n < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      throw std::runtime_error(std::string("epoll_wait failed: ") + strerror(errno));
+    }
+
+    for (int i = 0; i < n; ++i)
+    {
+      auto *watch = static_cast<Watch *>(events[i].data.ptr);
+      if (watch == nullptr)
+      {
+        uint64_t value;
+        while (read(wake_fd_, &value, sizeof(value)) > 0)
+        {
+        }
+        continue;
+      }
+      if (watch->fd != -1)
+      {
+        dispatch(*watch, events[i].events);
+      }
+    }
+    retired_.clear();
+
+    run_pending_tasks();
+  }
+  run_pending_tasks();
+}
+
+void EventLoop::stop()
+{
+  running_ = false;
+  wakeup();
+}
+
+void EventLoop::wakeup()
+{
+  uint64_t one = 1;
+  ssize_t rc = write(wake_fd_, &one, sizeof(one));
+  (void)rc; // Переполнение счетчика eventfd означает, что цикл уже разбужен
+}
+
+void EventLoop::run_pending_tasks()
+{
+  // Два буфера меняются местами и сохраняют емкость: постановка задач не выделяет память
+  {
+    std::lock_guard<std::mutex> lock(tasksMutex_);
+    batch_.swap(tasks_);
+  }
+  for (auto &task : batch_)
+  {
+    // Сбой одной задачи не отменяет остальные: их могут ждать другие потоки
+    try
+    {
+      task();
+    }
+    catch (std::exception &e)
+    {
+      Log::write(LogLevel::Error, "Event loop task failed: %s", e.what());
+    }
+    catch (...)
+    {
+      Log::write(LogLevel::Error, "Event loop task failed");
+    }
+  }
+  batch_.clear();
+}
+
+void EventLoop::dispatch(Watch &watch, uint32_t events)
+{
+  try
+  {
+    watch.callback(events);
+    return;
+  }
+  catch (std::exception &e)
+  {
+    Log::write(LogLevel::Error, "Handler of descriptor %d failed: %s", watch.fd, e.what());
+  }
+  catch (...)
+  {
+    Log::write(LogLevel::Error, "Handler of descriptor %d failed", watch.fd);
+  }
+  // Исключение обработчика сбоя выходит из run(): цикл больше нельзя считать исправным
+  if (watch.on_failure)
+    watch.on_failure();
+}
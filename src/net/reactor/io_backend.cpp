@@ -0,0 +1,25 @@
+/**
+ * @file io_backend.cpp
+ * @brief Выбор реализации IIoBackend
+ */
+
+#include "../include/net/reactor/io_backend.h"
+#include "../include/net/reactor/epoll_backend.h"
+#include "../include/net/reactor/uring_backend.h"
+#include "../include/log/logger.h"
+
+std::unique_ptr<IIoBackend> make_io_backend(IoBackendKind kind, EventLoop &loop,
+                                            IIoBackend::DataHandler on_data,
+                                            IIoBackend::CloseHandler on_close,
+                                            WriteCoalescing coalescing)
+{
+  if (kind == IoBackendKind::Uring)
+  {
+    if (auto backend = UringBackend::create(loop, on_data, on_close, coalescing))
+    {
+      return backend;
+    }
+    Log::write(LogLevel::Warn, "io_uring with multishot recv is not supported by the kernel (6.0+ required), falling back to epoll");
+  }
+  return std::make_unique<EpollBackend>(loop, std::move(on_data), std::move(on_close), coalescing);
+}
@@ -0,0 +1,198 @@
+/**
+ * @file timer_wheel.cpp
+ * @brief Реализация методов Timer и TimerWheel
+ */
+
+#include "../include/net/reactor/timer_wheel.h"
+#include "../include/log/logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+void Timer::cancel() noexcept
+{
+  if (!next_)
+    return;
+  prev_->next_ = next_;
+  next_->prev_ = prev_;
+  prev_ = next_ = nullptr;
+  if (wheel_)
+  {
+    --wheel_->count_;
+    wheel_ = nullptr;
+  }
+}
+
+TimerWheel::TimerWheel(EventLoop &loop, std::chrono::milliseconds tick)
+    : loop_(loop), tick_(std::max(tick, std::chrono::milliseconds(1))), origin_(Clock::now()), now_(origin_)
+{
+  // Головы ячеек — пустые кольцевые списки
+  for (auto &level : slots_)
+  {
+    for (Timer &head : level)
+    {
+      head.prev_ = head.next_ = &head;
+    }
+  }
+
+  timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timer_fd_ < 0)
+  {
+    throw std::runtime_error(std::string("timerfd_create failed: ") + strerror(errno));
+  }
+  loop_.add(timer_fd_, EPOLLIN, [this](uint32_t)
+            {
+    uint64_t expirations;
+    while (read(timer_fd_, &expirations, sizeof(expirations)) > 0)
+    {
+    }
+    advance(Clock::now()); });
+}
+
+TimerWheel::~TimerWheel()
+{
+  for (auto &level : slots_)
+  {
+    for (Timer &head : level)
+    {
+      while (head.next_ != &head)
+        head.next_->cancel();
+      head.prev_ = head.next_ = nullptr;
+    }
+  }
+  loop_.remove(timer_fd_);
+  close(timer_fd_);
+}
+
+uint64_t TimerWheel::tick_of(Clock::time_point when) const noexcept
+{
+  if (when <= origin_)
+    return 0;
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(when - origin_);
+  return static_cast<uint64_t>((elapsed.count() + tick_.count() - 1) / tick_.count());
+}
+
+void TimerWheel::arm(Timer &timer, Clock::time_point deadline)
+{
+  timer.cancel();
+  // Срок не раньше следующего тика и не дальше охвата колеса
+  constexpr uint64_t kRange = (uint64_t(1) << (kSlotBits * kLevels)) - 1;
+  timer.expires_ = std::min(std::max(tick_of(deadline), current_ + 1), current_ + kRange);
+  timer.wheel_ = this;
+  insert(timer);
+  if (++count_ == 1)
+    set_ticking(true);
+}
+
+void TimerWheel::arm_before(Timer &timer, Clock::time_point deadline)
+{
+  if (!timer.armed() || tick_of(deadline) < timer.expires_)
+    arm(timer, deadline);
+}
+
+void TimerWheel::insert(Timer &timer) noexcept
+{
+  uint64_t delta = timer.expires_ - current_;
+  size_t level = 0;
+  while (level + 1 < kLevels && delta >= (uint64_t(1) << (kSlotBits * (level + 1))))
+    ++level;
+  Timer &head = slots_[level][(timer.expires_ >> (kSlotBits * level)) & (kSlots - 1)];
+
+  timer.prev_ = head.prev_;
+  timer.next_ = &head;
+  head.prev_->next_ = &timer;
+  head.prev_ = &timer;
+}
+
+void TimerWheel::advance(Clock::time_point now)
+{
+  now_ = now;
+  uint64_t target = tick_of(now);
+  if (count_ == 0)
+  {
+    // Пустое колесо просто переставляется на текущий тик
+    current_ = std::max(current_, target);
+    set_ticking(false);
+    return;
+  }
+  while (current_ < target && count_ > 0)
+    step();
+  current_ = std::max(current_, target);
+  if (count_ == 0)
+    set_ticking(false);
+}
+
+void TimerWheel::step()
+{
+  ++current_;
+
+  // Когда нижний уровень проходит круг, ячейка следующего уровня раскладывается вниз
+  for (size_t level = 1; level < kLevels; ++level)
+  {
+    if ((current_ & ((uint64_t(1) << (kSlotBits * level)) - 1)) != 0)
+      break;
+    Timer &head = slots_[level][(current_ >> (kSlotBits * level)) & (kSlots - 1)];
+    while (head.next_ != &head)
+    {
+      Timer &timer = *head.next_;
+      head.next_ = timer.next_;
+      timer.next_->prev_ = &head;
+      insert(timer);
+    }
+  }
+
+  // Список наступившей ячейки переносится в локальную голову: обработчики
+  // могут перевзводить и снимать любые таймеры, в том числе из этого списка
+  Timer &head = slots_[0][current_ & (kSlots - 1)];
+  if (head.next_ == &head)
+    return;
+  Timer due;
+  due.next_ = head.next_;
+  due.prev_ = head.prev_;
+  due.next_->prev_ = &due;
+  due.prev_->next_ = &due;
+  head.prev_ = head.next_ = &head;
+
+  while (due.next_ != &due)
+  {
+    Timer &timer = *due.next_;
+    timer.cancel();
+    if (!timer.callback)
+      continue;
+    // Исключение не должно оставить список due на стеке недоразобранным
+    try
+    {
+      timer.callback();
+    }
+    catch (std::exception &e)
+    {
+      Log::write(LogLevel::Error, "Timer callback failed: %s", e.what());
+    }
+    catch (...)
+    {
+      Log::write(LogLevel::Error, "Timer callback failed");
+    }
+  }
+  due.prev_ = due.next_ = nullptr;
+}
+
+void TimerWheel::set_ticking(bool ticking)
+{
+  if (ticking == ticking_)
+    return;
+  itimerspec spec{};
+  if (ticking)
+  {
+    auto ns = tick_.count();
+    spec.it_interval.tv_sec = static_cast<time_t>(ns / 1000000000);
+    spec.it_interval.tv_nsec = static_cast<long>(ns % 1000000000);
+    spec.it_value = spec.it_interval;
+  }
+  if (timerfd_settime(timer_fd_, 0, &spec, nullptr) == 0)
+    ticking_ = ticking;
+}
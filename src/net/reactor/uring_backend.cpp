@@ -0,0 +1,559 @@
+/**
+ * @file uring_backend.cpp
+ * @brief Реализация методов UringBackend
+ */
+
+#include "../include/net/reactor/uring_backend.h"
+#include "../include/log/logger.h"
+#include "../include/metrics/metrics.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+  constexpr unsigned kQueueDepth = 1024;  ///< Размер SQ
+  constexpr unsigned kCqEntries = 8192;   ///< Размер CQ (multishot recv дает много CQE)
+  constexpr unsigned kBufferCount = 1024; ///< Буферов в кольце (степень двойки)
+  constexpr unsigned kBufferSize = 4096;  ///< Размер одного буфера приема
+  constexpr uint16_t kBufferGroup = 0;    ///< Идентификатор группы буферов
+  constexpr unsigned kOpBits = 8;         ///< Бит под тип операции в user_data
+
+  int io_uring_setup(unsigned entries, io_uring_params *params)
+  {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+  }
+
+  int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+  {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+  }
+
+  int io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args)
+  {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+  }
+
+  unsigned *at(void *base, uint32_t offset)
+  {
+    return reinterpret_cast<unsigned *>(static_cast<char *>(base) + offset);
+  }
+
+  uint64_t encode(uint64_t id, uint64_t op) { return (id << kOpBits) | op; }
+}
+
+std::unique_ptr<UringBackend> UringBackend::create(EventLoop &loop, DataHandler on_data, CloseHandler on_close,
+                                                   WriteCoalescing coalescing)
+{
+  std::unique_ptr<UringBackend> backend(new UringBackend(loop, std::move(on_data), std::move(on_close), coalescing));
+  if (!backend->setup())
+  {
+    return nullptr;
+  }
+  return backend;
+}
+
+UringBackend::UringBackend(EventLoop &loop, DataHandler on_data, CloseHandler on_close, WriteCoalescing coalescing)
+    : loop_(loop), on_data_(std::move(on_data)), on_close_(std::move(on_close)), dirty_(loop, coalescing) {}
+
+UringBackend::~UringBackend()
+{
+  if (ring_fd_ != -1)
+  {
+    loop_.set_before_poll(nullptr);
+    loop_.remove(ring_fd_);
+    close(ring_fd_);
+  }
+  if (sqes_)
+    munmap(sqes_, sqes_size_);
+  if (ring_ptr_)
+    munmap(ring_ptr_, ring_size_);
+  if (buf_ring_)
+    munmap(buf_ring_, buf_ring_size_);
+  delete[] buffers_;
+}
+
+bool UringBackend::setup()
+{
+  io_uring_params params{};
+  params.flags = IORING_SETUP_CQSIZE;
+  params.cq_entries = kCqEntries;
+
+  ring_fd_ = io_uring_setup(kQueueDepth, &params);
+  if (ring_fd_ < 0)
+  {
+    ring_fd_ = -1;
+    return false;
+  }
+  if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP))
+  {
+    return false;
+  }
+
+  // SQ и CQ живут в одной проекции (IORING_FEAT_SINGLE_MMAP)
+  ring_size_ = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+  void *ring = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+  if (ring == MAP_FAILED)
+  {
+    return false;
+  }
+  ring_ptr_ = ring;
+
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  void *sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED)
+  {
+    return false;
+  }
+  sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+  sq_head_ = at(ring_ptr_, params.sq_off.head);
+  sq_tail_ = at(ring_ptr_, params.sq_off.tail);
+  sq_flags_ = at(ring_ptr_, params.sq_off.flags);
+  sq_array_ = at(ring_ptr_, params.sq_off.array);
+  sq_mask_ = *at(ring_ptr_, params.sq_off.ring_mask);
+  sq_entries_ = params.sq_entries;
+  cq_head_ = at(ring_ptr_, params.cq_off.head);
+  cq_tail_ = at(ring_ptr_, params.cq_off.tail);
+  cq_mask_ = *at(ring_ptr_, params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe *>(static_cast<char *>(ring_ptr_) + params.cq_off.cqes);
+  sq_local_tail_ = *sq_tail_;
+
+  // Кольцо буферов приема: ядро само выбирает буфер под каждый multishot recv
+  buf_ring_size_ = kBufferCount * sizeof(io_uring_buf);
+  void *buf_ring = mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buf_ring == MAP_FAILED)
+  {
+    return false;
+  }
+  buf_ring_ = static_cast<io_uring_buf *>(buf_ring);
+
+  io_uring_buf_reg reg{};
+  reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+  reg.ring_entries = kBufferCount;
+  reg.bgid = kBufferGroup;
+  if (io_uring_register(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+  {
+    return false;
+  }
+
+  buffers_ = new char[static_cast<size_t>(kBufferCount) * kBufferSize];
+  for (unsigned i = 0; i < kBufferCount; ++i)
+  {
+    recycle(static_cast<uint16_t>(i));
+  }
+
+  // Кольца буферов есть с 5.19, а multishot recv — только с 6.0
+  if (!probe_multishot_recv())
+  {
+    return false;
+  }
+
+  loop_.add(ring_fd_, EPOLLIN, [this](uint32_t)
+            { complete(); });
+  loop_.set_before_poll([this]
+                        { flushPending(); });
+  return true;
+}
+
+bool UringBackend::probe_multishot_recv()
+{
+  int pair[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, pair) < 0)
+  {
+    return false;
+  }
+
+  // Пробный recv на паре сокетов с уже записанным байтом: ядро с поддержкой
+  // multishot отдает байт и оставляет запрос активным (IORING_CQE_F_MORE),
+  // старое отклоняет флаг или завершает запрос после первого приема
+  char byte = 0;
+  bool supported = false;
+  if (::write(pair[1], &byte, 1) == 1)
+  {
+    Link probe;
+    probe.fd = pair[0];
+    arm_recv(0, probe);
+    submit();
+
+    bool armed = true;
+    bool first = true;
+    while (armed)
+    {
+      if (*cq_head_ == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE) &&
+          io_uring_enter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+      {
+        break;
+      }
+      unsigned head = *cq_head_;
+      if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE))
+        continue;
+      io_uring_cqe cqe = cqes_[head & cq_mask_];
+      __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+      if (cqe.flags & IORING_CQE_F_BUFFER)
+        recycle(static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+      armed = (cqe.flags & IORING_CQE_F_MORE) != 0;
+      if (first)
+      {
+        supported = cqe.res > 0 && armed;
+        first = false;
+        // Закрытый собеседник завершает запрос: ядро пришлет последний CQE
+        ::close(pair[1]);
+        pair[1] = -1;
+      }
+    }
+  }
+
+  if (pair[1] != -1)
+    ::close(pair[1]);
+  ::close(pair[0]);
+  return supported;
+}
+
+void UringBackend::attach(const std::shared_ptr<Connection> &client)
+{
+  uint64_t id = next_id_++;
+  auto link = std::make_unique<Link>();
+  link->client = client;
+  link->fd = client->fd();
+
+  Link &ref = *link;
+  links_.emplace(id, std::move(link));
+  ids_[client.get()] = id;
+  arm_recv(id, ref);
+}
+
+void UringBackend::detach(const std::shared_ptr<Connection> &client)
+{
+  auto it = ids_.find(client.get());
+  if (it == ids_.end())
+    return;
+
+  uint64_t id = it->second;
+  ids_.erase(it);
+  Link &link = *links_.at(id);
+  // Очередь подключения (и буфер отправки, уже переданной ядру) живет
+  // вместе с link.client до release_if_idle
+  link.detached = true;
+
+  if (link.receiving)
+  {
+    io_uring_sqe *sqe = get_sqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = encode(id, OpRecv);
+    sqe->user_data = encode(id, OpCancel);
+  }
+
+  // Все SQE с этим дескриптором должны попасть в ядро до его закрытия,
+  // иначе номер может достаться новому подключению
+  submit();
+  loop_.post([this, id]
+             { release_if_idle(id); });
+}
+
+void UringBackend::send(const std::shared_ptr<Connection> &client, Payload data)
+{
+  auto it = ids_.find(client.get());
+  if (it == ids_.end())
+    return;
+
+  client->enqueue(std::move(data));
+  dirty_.add(client);
+}
+
+io_uring_sqe *UringBackend::get_sqe()
+{
+  unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+  if (!backlog_.empty() || sq_local_tail_ - head >= sq_entries_)
+  {
+    submit();
+    head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    // Пока backlog_ не пуст, новые SQE встают за ним: порядок операций сохраняется
+    if (!backlog_.empty() || sq_local_tail_ - head >= sq_entries_)
+    {
+      backlog_.emplace_back();
+      return &backlog_.back();
+    }
+  }
+
+  unsigned index = sq_local_tail_ & sq_mask_;
+  io_uring_sqe *sqe = &sqes_[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sq_array_[index] = index;
+  ++sq_local_tail_;
+  ++to_submit_;
+  return sqe;
+}
+
+void UringBackend::submit()
+{
+  for (;;)
+  {
+    // Отложенные SQE занимают места, освобожденные ядром
+    size_t moved = 0;
+    unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    while (moved < backlog_.size() && sq_local_tail_ - head < sq_entries_)
+    {
+      unsigned index = sq_local_tail_ & sq_mask_;
+      sqes_[index] = backlog_[moved++];
+      sq_array_[index] = index;
+      ++sq_local_tail_;
+      ++to_submit_;
+    }
+    backlog_.erase(backlog_.begin(), backlog_.begin() + static_cast<std::ptrdiff_t>(moved));
+    if (to_submit_ == 0)
+      return;
+
+    // Без SQPOLL ядро читает SQE только внутри io_uring_enter
+    __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+    int ret = io_uring_enter(ring_fd_, to_submit_, 0, 0);
+    if (ret < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      if (errno == EBUSY || errno == EAGAIN)
+      {
+        // Ядру некуда класть завершения: после разбора CQE отправка повторяется.
+        // Внутри разбора (или если разбирать нечего) SQE ждут следующего submit()
+        if (!reaping_ && complete())
+          continue;
+        return;
+      }
+      Log::write(LogLevel::Error, "io_uring_enter failed: %s", strerror(errno));
+      return;
+    }
+    if (ret == 0)
+      return;
+    to_submit_ -= std::min<unsigned>(to_submit_, static_cast<unsigned>(ret));
+    if (to_submit_ == 0 && backlog_.empty())
+      return;
+  }
+}
+
+void UringBackend::flushPending()
+{
+  dirty_.drain([this](const std::shared_ptr<Connection> &client)
+               {
+    auto it = ids_.find(client.get());
+    if (it != ids_.end())
+      send_next(it->second, *links_.at(it->second)); });
+  submit();
+}
+
+bool UringBackend::complete()
+{
+  if (reaping_)
+    return false;
+  // Обработчики CQE ставят новые SQE, и submit() может захотеть разобрать CQ
+  // еще раз: вложенный разбор перечитал бы уже разобранные CQE
+  reaping_ = true;
+  struct Reaping
+  {
+    bool &flag;
+    ~Reaping() { flag = false; }
+  } reaping{reaping_};
+  bool reaped = false;
+  for (;;)
+  {
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    if (head == tail)
+    {
+      // CQ переполнялась: ядро держит CQE у себя до GETEVENTS
+      if (__atomic_load_n(sq_flags_, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW)
+      {
+        io_uring_enter(ring_fd_, 0, 0, IORING_ENTER_GETEVENTS);
+        if (*cq_head_ != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE))
+          continue;
+      }
+      return reaped;
+    }
+
+    for (; head != tail; ++head)
+    {
+      io_uring_cqe cqe = cqes_[head & cq_mask_];
+      __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+      reaped = true;
+
+      uint64_t id = cqe.user_data >> kOpBits;
+      try
+      {
+        switch (cqe.user_data & ((1u << kOpBits) - 1))
+        {
+        case OpRecv:
+          handle_recv(id, cqe);
+          break;
+        case OpSend:
+          handle_send(id, cqe);
+          break;
+        default:
+          break;
+        }
+      }
+      catch (std::exception &e)
+      {
+        // Сбой одного завершения закрывает только его подключение, остальные CQE разбираются дальше
+        Log::write(LogLevel::Error, "io_uring completion failed: %s", e.what());
+        auto it = links_.find(id);
+        if (it != links_.end() && !it->second->detached)
+          on_close_(it->second->client);
+      }
+      release_if_idle(id);
+    }
+  }
+}
+
+void UringBackend::arm_recv(uint64_t id, Link &link)
+{
+  io_uring_sqe *sqe = get_sqe();
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = link.fd;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = kBufferGroup;
+  sqe->user_data = encode(id, OpRecv);
+  link.receiving = true;
+}
+
+void UringBackend::send_next(uint64_t id, Link &link)
+{
+  if (link.sending || !link.client->has_pending_output())
+    return;
+
+  // Несколько сообщений очереди уходят одной операцией; iov и hdr живут в Link
+  // до завершения отправки
+  link.hdr.msg_iov = link.iov;
+  link.hdr.msg_iovlen = link.client->gather(link.iov, Connection::kMaxIov);
+  link.client->set_in_flight(link.hdr.msg_iovlen);
+  io_uring_sqe *sqe = get_sqe();
+  sqe->opcode = IORING_OP_SENDMSG;
+  sqe->fd = link.fd;
+  sqe->addr = reinterpret_cast<uint64_t>(&link.hdr);
+  sqe->len = 1;
+  sqe->msg_flags = MSG_NOSIGNAL;
+  sqe->user_data = encode(id, OpSend);
+  link.sending = true;
+}
+
+void UringBackend::handle_recv(uint64_t id, const io_uring_cqe &cqe)
+{
+  bool has_buffer = cqe.flags & IORING_CQE_F_BUFFER;
+  uint16_t bid = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+
+  auto it = links_.find(id);
+  if (it == links_.end())
+  {
+    if (has_buffer)
+      recycle(bid);
+    return;
+  }
+  Link &link = *it->second;
+  auto client = link.client; // Подключение может быть закрыто из обработчика
+  if (!(cqe.flags & IORING_CQE_F_MORE))
+    link.receiving = false;
+
+  if (cqe.res > 0 && has_buffer)
+  {
+    Metrics::add(Counter::BytesIn, static_cast<uint64_t>(cqe.res));
+    // После /quit данные выбрасываются, не заполняя буфер приема до отказа
+    if (!link.detached && !client->reading_stopped())
+    {
+      // Буфер выбирает ядро, поэтому в кольцо подключения попадает только копия
+      client->framer().append(buffers_ + static_cast<size_t>(bid) * kBufferSize, static_cast<size_t>(cqe.res));
+      recycle(bid);
+      on_data_(client);
+      client->framer().release();
+    }
+    else
+    {
+      recycle(bid);
+    }
+  }
+  else if (has_buffer)
+  {
+    recycle(bid);
+  }
+
+  if (link.detached)
+    return;
+
+  if (cqe.res == 0 && client->reading_stopped())
+  {
+    // Клиент закрыл свою сторону после /quit: подключение закроется после прощания
+    close_if_drained(link);
+    return;
+  }
+  if (cqe.res == 0 || (cqe.res < 0 && cqe.res != -ENOBUFS))
+  {
+    // EOF или ошибка чтения
+    on_close_(client);
+    return;
+  }
+  if (!link.receiving && !client->closing())
+  {
+    // Ядро завершило multishot (например, кончились буферы) — взводим заново
+    arm_recv(id, link);
+  }
+  close_if_drained(link);
+}
+
+void UringBackend::handle_send(uint64_t id, const io_uring_cqe &cqe)
+{
+  auto it = links_.find(id);
+  if (it == links_.end())
+    return;
+  Link &link = *it->second;
+  link.sending = false;
+
+  if (link.detached)
+    return;
+
+  if (cqe.res < 0)
+  {
+    Metrics::add(Counter::SendErrors);
+    on_close_(link.client);
+    return;
+  }
+
+  Metrics::add(Counter::BytesOut, static_cast<uint64_t>(cqe.res));
+  link.client->consume(static_cast<size_t>(cqe.res));
+  link.client->set_in_flight(0);
+  send_next(id, link);
+  close_if_drained(link);
+}
+
+void UringBackend::recycle(uint16_t bid)
+{
+  io_uring_buf &buf = buf_ring_[buf_tail_ & (kBufferCount - 1)];
+  buf.addr = reinterpret_cast<uint64_t>(buffers_ + static_cast<size_t>(bid) * kBufferSize);
+  buf.len = kBufferSize;
+  buf.bid = bid;
+  ++buf_tail_;
+  // Хвост кольца совмещен с полем resv первого элемента
+  __atomic_store_n(&buf_ring_[0].resv, buf_tail_, __ATOMIC_RELEASE);
+}
+
+void UringBackend::close_if_drained(Link &link)
+{
+  if (!link.detached && link.client->closing() && !link.sending && !link.client->has_pending_output())
+  {
+    on_close_(link.client);
+  }
+}
+
+void UringBackend::release_if_idle(uint64_t id)
+{
+  auto it = links_.find(id);
+  if (it != links_.end() && it->second->detached && !it->second->receiving && !it->second->sending)
+  {
+    links_.erase(it);
+  }
+}
@@ -0,0 +1,57 @@
+/**
+ * @file write_coalescer.cpp
+ * @brief Реализация методов WriteCoalescer
+ */
+
+#include "../include/net/reactor/write_coalescer.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+WriteCoalescer::WriteCoalescer(EventLoop &loop, WriteCoalescing options)
+    : loop_(loop), options_(options)
+{
+  timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timer_fd_ < 0)
+  {
+    throw std::runtime_error(std::string("timerfd_create failed: ") + strerror(errno));
+  }
+
+  // Само срабатывание ничего не делает: список разберет ближайший drain()
+  loop_.add(timer_fd_, EPOLLIN, [this](uint32_t)
+            {
+    uint64_t expirations;
+    while (read(timer_fd_, &expirations, sizeof(expirations)) > 0)
+    {
+    }
+    timer_armed_ = false; });
+}
+
+WriteCoalescer::~WriteCoalescer()
+{
+  loop_.remove(timer_fd_);
+  close(timer_fd_);
+}
+
+void WriteCoalescer::arm(std::chrono::steady_clock::time_point deadline, std::chrono::steady_clock::time_point now)
+{
+  if (timer_armed_ && armed_ <= deadline)
+    return;
+
+  auto delay = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - now).count();
+  itimerspec spec{};
+  // Нулевое значение снимает таймер, поэтому срок не меньше наносекунды
+  spec.it_value.tv_sec = static_cast<time_t>(delay / 1000000000);
+  spec.it_value.tv_nsec = static_cast<long>(delay % 1000000000);
+  if (delay <= 0)
+    spec.it_value.tv_nsec = 1;
+  if (timerfd_settime(timer_fd_, 0, &spec, nullptr) == 0)
+  {
+    armed_ = deadline;
+    timer_armed_ = true;
+  }
+}
@@ -0,0 +1,599 @@
+/**
+ * @file message_log.cpp
+ * @brief Реализация методов MessageLog
+ */
+
+#include "../include/storage/message_log.h"
+#include "../include/log/logger.h"
+#include "../include/metrics/metrics.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+  /// Заголовок записи: размер (u32), CRC32 (u32), seq (u64), время (u64), длина имени комнаты (u16)
+  constexpr size_t kHeader = 4 + 4 + 8 + 8 + 2;
+  constexpr size_t kCrcFrom = 8; ///< CRC считается от seq до конца записи
+
+  /// Таблицы CRC32 (IEEE 802.3, отраженный полином) для обработки по 8 байт (slicing-by-8)
+  const std::array<std::array<uint32_t, 256>, 8> kCrcTables = []
+  {
+    std::array<std::array<uint32_t, 256>, 8> tables{};
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; ++bit)
+        crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+      tables[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+      for (size_t k = 1; k < 8; ++k)
+        tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xFF];
+    }
+    return tables;
+  }();
+
+  uint32_t crc32(const char *data, size_t len) noexcept
+  {
+    const auto &t = kCrcTables;
+    uint32_t crc = 0xFFFFFFFFu;
+    for (; len >= 8; data += 8, len -= 8)
+    {
+      uint32_t lo;
+      uint32_t hi;
+      std::memcpy(&lo, data, 4);
+      std::memcpy(&hi, data + 4, 4);
+      lo ^= crc;
+      crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+            t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+    }
+    for (; len > 0; ++data, --len)
+      crc = t[0][(crc ^ static_cast<unsigned char>(*data)) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+  }
+
+  template <typename T>
+  T load(const char *at) noexcept
+  {
+    T value;
+    std::memcpy(&value, at, sizeof(value));
+    return value;
+  }
+
+  template <typename T>
+  void put(std::string &out, T value)
+  {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+
+  std::runtime_error io_error(const std::string &what, const std::string &path)
+  {
+    return std::runtime_error(what + " " + path + ": " + strerror(errno));
+  }
+
+  /// Имя файла сегмента: номер первого сообщения, дополненный нулями (лексикографический порядок = числовой)
+  std::string segment_name(uint64_t base, const char *suffix)
+  {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%020" PRIu64 "%s", base, suffix);
+    return name;
+  }
+
+  /// Дескриптор файла, закрываемый при выходе из области видимости
+  struct File
+  {
+    int fd = -1;
+    explicit File(int fd) : fd(fd) {}
+    ~File()
+    {
+      if (fd >= 0)
+        close(fd);
+    }
+    File(const File &) = delete;
+    File &operator=(const File &) = delete;
+  };
+
+  /// Отображение файла только для чтения
+  struct Mapping
+  {
+    const char *data = nullptr;
+    size_t len = 0;
+
+    Mapping(int fd, size_t len, const std::string &path) : len(len)
+    {
+      if (len == 0)
+        return;
+      void *addr = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+      if (addr == MAP_FAILED)
+        throw io_error("mmap", path);
+      data = static_cast<const char *>(addr);
+    }
+    ~Mapping()
+    {
+      if (data)
+        munmap(const_cast<char *>(data), len);
+    }
+    Mapping(const Mapping &) = delete;
+    Mapping &operator=(const Mapping &) = delete;
+  };
+
+  /// Записать буфер целиком начиная со смещения
+  bool write_at(int fd, const char *data, size_t len, size_t offset)
+  {
+    while (len > 0)
+    {
+      ssize_t n = pwrite(fd, data, len, static_cast<off_t>(offset));
+      if (n < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        return false;
+      }
+      data += n;
+      len -= static_cast<size_t>(n);
+      offset += static_cast<size_t>(n);
+    }
+    return true;
+  }
+
+  /// Зафиксировать запись каталога (новый файл сегмента переживет сбой)
+  void sync_dir(const std::string &dir)
+  {
+    File handle(open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (handle.fd >= 0)
+      fsync(handle.fd);
+  }
+}
+
+MessageLog::MessageLog(std::string dir, Options options)
+    : dir_(std::move(dir)), options_(options)
+{
+  options_.index_interval = std::max<size_t>(options_.index_interval, 1);
+  if (mkdir(dir_.c_str(), 0755) != 0 && errno != EEXIST)
+    throw io_error("mkdir", dir_);
+
+  recover();
+  writer_ = std::thread([this]
+                        { run(); });
+}
+
+MessageLog::~MessageLog()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  ready_.notify_one();
+  if (writer_.joinable())
+    writer_.join();
+  if (fd_ >= 0)
+    close(fd_);
+  if (index_fd_ >= 0)
+    close(index_fd_);
+}
+
+bool MessageLog::append(const MessageRef &room, const MessageRef &body)
+{
+  size_t size = kHeader + (room ? room->size() : 0) + body->size();
+  uint64_t now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                           std::chrono::system_clock::now().time_since_epoch())
+                                           .count());
+  bool wake;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_ || pending_bytes_ + size > options_.max_pending_bytes)
+    {
+      Metrics::add(Counter::StoreDropped);
+      return false;
+    }
+    // Поток записи ждет, только когда очередь пуста: будить его нужно лишь первым сообщением пачки
+    wake = pending_.empty();
+    pending_.push_back(Pending{next_seq_++, now, room, body, size});
+    pending_bytes_ += size;
+  }
+  Metrics::add(Counter::StoreAppends);
+  if (wake)
+    ready_.notify_one();
+  return true;
+}
+
+bool MessageLog::sync()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  uint64_t target = next_seq_;
+  committed_cv_.wait(lock, [&]
+                     { return committed_.load(std::memory_order_acquire) >= target || lost_; });
+  return committed_.load(std::memory_order_acquire) >= target;
+}
+
+uint64_t MessageLog::first_seq() const
+{
+  std::lock_guard<std::mutex> lock(segments_mutex_);
+  return segments_.front().base;
+}
+
+size_t MessageLog::read(uint64_t from, size_t max, const Visitor &visitor) const
+{
+  /// Участок сегмента для чтения
+  struct View
+  {
+    std::string path;
+    size_t size;
+    size_t offset;
+  };
+
+  std::vector<View> views;
+  {
+    std::lock_guard<std::mutex> lock(segments_mutex_);
+    auto it = std::upper_bound(segments_.begin(), segments_.end(), from, [](uint64_t seq, const Segment &segment)
+                               { return seq < segment.base; });
+    if (it != segments_.begin())
+      --it;
+    for (; it != segments_.end(); ++it)
+    {
+      // Ближайшая запись индекса не дальше from: просмотр не длиннее index_interval
+      auto entry = std::upper_bound(it->index.begin(), it->index.end(), from, [](uint64_t seq, const IndexEntry &e)
+                                    { return seq < e.seq; });
+      size_t offset = entry == it->index.begin() ? 0 : static_cast<size_t>((entry - 1)->offset);
+      views.push_back(View{it->path, it->size, offset});
+    }
+  }
+
+  size_t count = 0;
+  for (const View &view : views)
+  {
+    if (count >= max)
+      break;
+    if (view.size <= view.offset)
+      continue;
+    File file(open(view.path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (file.fd < 0)
+      throw io_error("open", view.path);
+    Mapping map(file.fd, view.size, view.path);
+
+    size_t offset = view.offset;
+    while (count < max && offset + kHeader <= map.len)
+    {
+      const char *at = map.data + offset;
+      uint32_t size = load<uint32_t>(at);
+      if (size < kHeader)
+        break;
+      Record record;
+      record.seq = load<uint64_t>(at + 8);
+      record.time_ns = load<uint64_t>(at + 16);
+      uint16_t room_len = load<uint16_t>(at + 24);
+      offset += size;
+      if (record.seq < from)
+        continue;
+      record.room = std::string_view(at + kHeader, room_len);
+      record.body = std::string_view(at + kHeader + room_len, size - kHeader - room_len);
+      visitor(record);
+      ++count;
+    }
+  }
+  return count;
+}
+
+void MessageLog::recover()
+{
+  std::vector<uint64_t> bases;
+  {
+    DIR *listing = opendir(dir_.c_str());
+    if (!listing)
+      throw io_error("opendir", dir_);
+    while (dirent *entry = readdir(listing))
+    {
+      std::string_view name = entry->d_name;
+      uint64_t base = 0;
+      if (name.size() == 24 && name.substr(20) == ".log" &&
+          std::all_of(name.begin(), name.begin() + 20, [](char ch)
+                      { return ch >= '0' && ch <= '9'; }))
+      {
+        base = std::strtoull(std::string(name.substr(0, 20)).c_str(), nullptr, 10);
+        bases.push_back(base);
+      }
+    }
+    closedir(listing);
+  }
+  std::sort(bases.begin(), bases.end());
+
+  if (bases.empty())
+  {
+    open_segment(0);
+    return;
+  }
+
+  for (size_t i = 0; i < bases.size(); ++i)
+  {
+    Segment segment;
+    segment.base = bases[i];
+    segment.path = dir_ + "/" + segment_name(segment.base, ".log");
+    std::string index_path = dir_ + "/" + segment_name(segment.base, ".idx");
+    bool last = i + 1 == bases.size();
+
+    File file(open(segment.path.c_str(), (last ? O_RDWR : O_RDONLY) | O_CLOEXEC));
+    struct stat info{};
+    if (file.fd < 0 || fstat(file.fd, &info) != 0)
+      throw io_error("open", segment.path);
+    size_t len = static_cast<size_t>(info.st_size);
+
+    if (!last)
+    {
+      // Закрытый сегмент: индекс с диска, а если его нет — просмотром
+      segment.size = len;
+      File index(open(index_path.c_str(), O_RDONLY | O_CLOEXEC));
+      struct stat index_info{};
+      if (index.fd >= 0 && fstat(index.fd, &index_info) == 0 && index_info.st_size > 0 &&
+          index_info.st_size % sizeof(IndexEntry) == 0)
+      {
+        segment.index.resize(static_cast<size_t>(index_info.st_size) / sizeof(IndexEntry));
+        if (pread(index.fd, segment.index.data(), static_cast<size_t>(index_info.st_size), 0) != index_info.st_size)
+          segment.index.clear();
+      }
+      if (segment.index.empty() && len > 0)
+      {
+        Mapping map(file.fd, len, segment.path);
+        scan(segment, map.data, len);
+      }
+      segments_.push_back(std::move(segment));
+      continue;
+    }
+
+    // Последний сегмент мог оборваться на середине пачки: проверяются все записи
+    {
+      Mapping map(file.fd, len, segment.path);
+      next_seq_ = scan(segment, map.data, len);
+    }
+    if (segment.size < len)
+    {
+      Log::write(LogLevel::Warn, "Message log: truncating %s from %zu to %zu bytes", segment.path.c_str(), len, segment.size);
+      if (ftruncate(file.fd, static_cast<off_t>(segment.size)) != 0)
+        throw io_error("ftruncate", segment.path);
+      fdatasync(file.fd);
+    }
+
+    File index(open(index_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+    if (index.fd < 0 || !write_at(index.fd, reinterpret_cast<const char *>(segment.index.data()), segment.index.size() * sizeof(IndexEntry), 0))
+      throw io_error("write", index_path);
+    segments_.push_back(std::move(segment));
+  }
+
+  open_active();
+  committed_.store(next_seq_, std::memory_order_release);
+}
+
+uint64_t MessageLog::scan(Segment &segment, const char *data, size_t len) const
+{
+  segment.index.clear();
+  size_t offset = 0;
+  size_t next_index = 0;
+  uint64_t expected = segment.base;
+  while (offset + kHeader <= len)
+  {
+    const char *at = data + offset;
+    uint32_t size = load<uint32_t>(at);
+    if (size < kHeader || size > len - offset)
+      break;
+    if (load<uint32_t>(at + 4) != crc32(at + kCrcFrom, size - kCrcFrom))
+      break;
+    // Номера только растут; пропуск номеров — не повреждение, записи после него зафиксированы
+    uint64_t seq = load<uint64_t>(at + 8);
+    if (seq < expected || kHeader + load<uint16_t>(at + 24) > size)
+      break;
+    if (offset >= next_index)
+    {
+      segment.index.push_back(IndexEntry{seq, offset});
+      next_index = offset + options_.index_interval;
+    }
+    offset += size;
+    expected = seq + 1;
+  }
+  segment.size = offset;
+  return expected;
+}
+
+void MessageLog::open_segment(uint64_t base)
+{
+  if (!segments_.empty() && segments_.back().base == base)
+  {
+    // Повтор пачки после ошибки: сегмент уже создан, в нем ничего не зафиксировано
+    open_active();
+    return;
+  }
+  Segment segment;
+  segment.base = base;
+  segment.path = dir_ + "/" + segment_name(base, ".log");
+  File file(open(segment.path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+  if (file.fd < 0)
+    throw io_error("create", segment.path);
+  sync_dir(dir_);
+  {
+    std::lock_guard<std::mutex> lock(segments_mutex_);
+    segments_.push_back(std::move(segment));
+  }
+  open_active();
+}
+
+void MessageLog::open_active()
+{
+  if (fd_ >= 0)
+    close(fd_);
+  if (index_fd_ >= 0)
+    close(index_fd_);
+
+  const Segment &active = segments_.back();
+  std::string index_path = dir_ + "/" + segment_name(active.base, ".idx");
+  fd_ = open(active.path.c_str(), O_WRONLY | O_CLOEXEC);
+  if (fd_ < 0)
+    throw io_error("open", active.path);
+  index_fd_ = open(index_path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (index_fd_ < 0)
+    throw io_error("open", index_path);
+
+  written_ = active.size;
+  next_index_ = active.index.empty() ? 0 : static_cast<size_t>(active.index.back().offset) + options_.index_interval;
+}
+
+void MessageLog::run()
+{
+  constexpr std::chrono::milliseconds kFirstRetry{100};
+  constexpr std::chrono::milliseconds kMaxRetry{5000};
+
+  std::vector<Pending> batch;
+  std::chrono::milliseconds retry{0};
+  for (;;)
+  {
+    bool last_attempt = false;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (batch.empty())
+      {
+        ready_.wait(lock, [&]
+                    { return !pending_.empty() || stopping_; });
+        if (pending_.empty())
+          return;
+      }
+      else
+      {
+        // Пачка не записана: пауза перед повтором (остановка ее прерывает)
+        ready_.wait_for(lock, retry, [&]
+                        { return stopping_; });
+        last_attempt = stopping_;
+      }
+      // Вся очередь — одна пачка: пока шел прошлый fdatasync (или пауза), она копилась
+      if (batch.empty())
+      {
+        batch.swap(pending_);
+      }
+      else
+      {
+        batch.insert(batch.end(), std::make_move_iterator(pending_.begin()), std::make_move_iterator(pending_.end()));
+        pending_.clear();
+      }
+    }
+
+    try
+    {
+      write_batch(batch);
+    }
+    catch (std::exception &e)
+    {
+      // Считается каждая неудачная попытка: потерю данных при остановке отмечает lost_
+      Metrics::add(Counter::StoreErrors);
+      Log::write(LogLevel::Error, "Message log: %s (%zu messages kept for retry)", e.what(), batch.size());
+      // Незафиксированная часть пачки пишется заново с того же места
+      buffer_.clear();
+      new_index_.clear();
+      const Segment &active = segments_.back();
+      next_index_ = active.index.empty() ? 0 : static_cast<size_t>(active.index.back().offset) + options_.index_interval;
+      if (!last_attempt)
+      {
+        retry = std::min(kMaxRetry, retry.count() == 0 ? kFirstRetry : retry * 2);
+        continue;
+      }
+
+      Log::write(LogLevel::Error, "Message log: stopped with %" PRIu64 " messages not written",
+                 batch.back().seq + 1 - committed_.load(std::memory_order_relaxed));
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        lost_ = true;
+      }
+      committed_cv_.notify_all();
+      return;
+    }
+
+    size_t bytes = 0;
+    for (const Pending &msg : batch)
+      bytes += msg.bytes;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_bytes_ -= bytes;
+    }
+    batch.clear();
+    retry = std::chrono::milliseconds(0);
+  }
+}
+
+void MessageLog::write_batch(const std::vector<Pending> &batch)
+{
+  // Начало пачки могло быть зафиксировано в прошлой попытке (до смены сегмента)
+  uint64_t committed = committed_.load(std::memory_order_relaxed);
+  for (const Pending &msg : batch)
+  {
+    if (msg.seq < committed)
+      continue;
+    size_t room_len = msg.room ? std::min<size_t>(msg.room->size(), UINT16_MAX) : 0;
+    size_t size = kHeader + room_len + msg.body->size();
+    if (written_ + buffer_.size() > 0 && written_ + buffer_.size() + size > options_.segment_bytes)
+    {
+      commit(msg.seq - 1);
+      open_segment(msg.seq);
+    }
+    size_t offset = written_ + buffer_.size();
+    if (offset >= next_index_)
+    {
+      new_index_.push_back(IndexEntry{msg.seq, offset});
+      next_index_ = offset + options_.index_interval;
+    }
+
+    size_t start = buffer_.size();
+    put<uint32_t>(buffer_, static_cast<uint32_t>(size));
+    put<uint32_t>(buffer_, 0);
+    put<uint64_t>(buffer_, msg.seq);
+    put<uint64_t>(buffer_, msg.time_ns);
+    put<uint16_t>(buffer_, static_cast<uint16_t>(room_len));
+    if (room_len > 0)
+      buffer_.append(msg.room->data(), room_len);
+    buffer_.append(msg.body->data(), msg.body->size());
+    uint32_t crc = crc32(buffer_.data() + start + kCrcFrom, size - kCrcFrom);
+    std::memcpy(&buffer_[start + 4], &crc, sizeof(crc));
+  }
+  commit(batch.back().seq);
+}
+
+void MessageLog::commit(uint64_t last)
+{
+  if (!buffer_.empty())
+  {
+    uint64_t started = Metrics::now_ns();
+    if (!write_at(fd_, buffer_.data(), buffer_.size(), written_) || fdatasync(fd_) != 0)
+      throw io_error("write", segments_.back().path);
+    Metrics::record(Latency::StoreCommit, Metrics::now_ns() - started);
+    Metrics::add(Counter::StoreCommits);
+    Metrics::add(Counter::StoreBytes, buffer_.size());
+
+    // Индекс не синхронизируется: после сбоя он перестраивается по сегменту
+    if (!new_index_.empty() &&
+        !write_at(index_fd_, reinterpret_cast<const char *>(new_index_.data()), new_index_.size() * sizeof(IndexEntry), 0))
+      Log::write(LogLevel::Warn, "Message log: index write failed: %s", strerror(errno));
+
+    written_ += buffer_.size();
+    {
+      std::lock_guard<std::mutex> lock(segments_mutex_);
+      Segment &active = segments_.back();
+      active.size = written_;
+      active.index.insert(active.index.end(), new_index_.begin(), new_index_.end());
+    }
+    buffer_.clear();
+    new_index_.clear();
+  }
+
+  committed_.store(last + 1, std::memory_order_release);
+  {
+    // Пустая критическая секция: sync() не пропустит уведомление между проверкой и ожиданием
+    std::lock_guard<std::mutex> lock(mutex_);
+  }
+  committed_cv_.notify_all();
+}